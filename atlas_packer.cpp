@@ -0,0 +1,94 @@
+#include "atlas_packer.h"
+
+// Private copy of stb_rectpack: imgui_draw.cpp compiles its own with STBRP_STATIC as well,
+// so both stay local to their translation unit
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imstb_rectpack.h"
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+struct AtlasPacker::Page {
+    stbrp_context context;
+    std::vector<stbrp_node> nodes;
+    int live = 0;
+};
+
+AtlasPacker::AtlasPacker(int page_size, int max_pages)
+    : page_size(page_size), max_pages(max_pages) {
+}
+
+AtlasPacker::~AtlasPacker() = default;
+
+// Function to try one page, the packer keeps its skyline across calls
+bool AtlasPacker::PackInto(int page, int width, int height, AtlasRegion& region) {
+    stbrp_rect rect = {};
+    rect.w = width;
+    rect.h = height;
+    Page& target = *pages[page];
+    if (!stbrp_pack_rects(&target.context, &rect, 1) || !rect.was_packed) {
+        return false;
+    }
+    target.live++;
+    region.page = page;
+    region.x = rect.x;
+    region.y = rect.y;
+    region.width = width;
+    region.height = height;
+    return true;
+}
+
+// Function to allocate a region, first fit over the open pages before opening another
+bool AtlasPacker::Allocate(int width, int height, AtlasRegion& region) {
+    width += 2;
+    height += 2;
+    if (width > page_size || height > page_size) {
+        return false;
+    }
+    for (int page = 0; page < static_cast<int>(pages.size()); ++page) {
+        if (PackInto(page, width, height, region)) {
+            return true;
+        }
+    }
+    if (static_cast<int>(pages.size()) >= max_pages) {
+        return false;
+    }
+    std::unique_ptr<Page> page(new Page());
+    page->nodes.resize(page_size);
+    stbrp_init_target(&page->context, page_size, page_size, page->nodes.data(), page_size);
+    pages.push_back(std::move(page));
+    return PackInto(static_cast<int>(pages.size()) - 1, width, height, region);
+}
+
+// Function to release a region, a page with nothing left in it is reset to empty
+void AtlasPacker::Free(const AtlasRegion& region) {
+    if (region.page < 0 || region.page >= static_cast<int>(pages.size())) {
+        return;
+    }
+    Page& page = *pages[region.page];
+    if (--page.live == 0) {
+        stbrp_init_target(&page.context, page_size, page_size, page.nodes.data(), page_size);
+        resets++;
+    }
+}
+
+// Function to forget every page, the caller releases the page textures
+void AtlasPacker::Clear() {
+    pages.clear();
+}
+
+AtlasPacker::Stats AtlasPacker::GetStats() const {
+    Stats stats;
+    stats.pages = static_cast<int>(pages.size());
+    stats.max_pages = max_pages;
+    stats.resets = resets;
+    for (const auto& page : pages) {
+        stats.live_regions += page->live;
+    }
+    return stats;
+}
@@ -0,0 +1,59 @@
+#ifndef ATLAS_PACKER_H
+#define ATLAS_PACKER_H
+
+#include <memory>
+#include <vector>
+
+// Where one image landed in the atlas. x/y/width/height include the 1-pixel border
+// that callers fill by extruding the image's edge pixels, so bilinear sampling at the
+// edge of one thumbnail never picks up its neighbour.
+struct AtlasRegion {
+    int page = -1;
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+};
+
+// Rectangle allocator for fixed-size atlas pages, packed with the skyline packer from
+// imstb_rectpack. stb_rectpack cannot free single rectangles, so each page counts its
+// live regions and starts over empty when the last one is freed; freed space in a page
+// that still has live regions is reused only once the page drains, which is why
+// ImageStore empties a whole page when Allocate fails. Nothing in here touches the GPU:
+// the caller creates a texture for every page index it is handed.
+class AtlasPacker {
+public:
+    struct Stats {
+        int pages = 0;
+        int max_pages = 0;
+        int live_regions = 0;
+        int resets = 0; // Pages that drained and were reused from empty
+    };
+
+    AtlasPacker(int page_size, int max_pages);
+    ~AtlasPacker();
+
+    AtlasPacker(const AtlasPacker&) = delete;
+    AtlasPacker& operator=(const AtlasPacker&) = delete;
+
+    // Finds room for an image of width x height plus its border, opening a new page if allowed.
+    // Returns false if no page has room, the caller then falls back to a standalone texture.
+    bool Allocate(int width, int height, AtlasRegion& region);
+    void Free(const AtlasRegion& region);
+    void Clear();
+
+    int PageSize() const { return page_size; }
+    Stats GetStats() const;
+
+private:
+    struct Page;
+
+    bool PackInto(int page, int width, int height, AtlasRegion& region);
+
+    int page_size;
+    int max_pages;
+    int resets = 0;
+    std::vector<std::unique_ptr<Page>> pages;
+};
+
+#endif // ATLAS_PACKER_H
@@ -0,0 +1,49 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+// Helpers shared by the benchmarks in bench/. Every benchmark checks its results before it
+// times anything and exits with status 1 on a mismatch, so ctest runs them as tests; they
+// are built by the CMake build in the repo root, one target per file.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Function to get the seconds elapsed since start
+inline double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Function to get the milliseconds elapsed since start
+inline double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return SecondsSince(start) * 1000.0;
+}
+
+// Function to fill a buffer with reproducible noise
+inline void FillRandom(std::vector<unsigned char>& buffer, unsigned seed) {
+    std::mt19937 rng(seed);
+    for (auto& byte : buffer) {
+        byte = static_cast<unsigned char>(rng());
+    }
+}
+
+// Function to compare a kernel's output with the scalar reference's, padding included, and
+// name the case that disagrees
+inline bool SameAsReference(const std::vector<unsigned char>& expected, const std::vector<unsigned char>& actual,
+    const char* kernel, int width, int height, size_t pad) {
+    if (expected != actual) {
+        printf("MISMATCH %-6s width=%d height=%d pad=%zu\n", kernel, width, height, pad);
+        return false;
+    }
+    return true;
+}
+
+// Function to print the verdict line and turn it into the exit status
+inline int ReportCorrectness(bool ok) {
+    printf("correctness: %s\n", ok ? "all checks passed" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+#endif // BENCH_UTIL_H
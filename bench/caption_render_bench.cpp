@@ -0,0 +1,140 @@
+// Local captions in caption_renderer.cpp: the SSE2 blend kernel against the scalar reference,
+// then a 600x600 template captioned cold and warm. Pass --save PATH to write the sample as a PPM.
+
+#include "bench_util.h"
+#include "caption_renderer.h"
+#include "pixel_convert.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Function to fill a mask with noise where a third of the bytes are clear, like glyph edges
+static void FillMask(std::vector<unsigned char>& buffer, unsigned seed) {
+    FillRandom(buffer, seed);
+    for (auto& byte : buffer) {
+        byte = byte % 3 == 0 ? 0 : byte;
+    }
+}
+
+// Function to compare the SSE2 kernel with the scalar reference, including the pitch padding
+static bool CheckKernel(int width, int height, size_t pad) {
+    const size_t pitch = static_cast<size_t>(width) * 4 + pad;
+    const size_t mask_pitch = static_cast<size_t>(width) + pad;
+    std::vector<unsigned char> outline(mask_pitch * height), fill(mask_pitch * height), pixels(pitch * height);
+    FillMask(outline, width * 7 + height);
+    FillMask(fill, width * 13 + height);
+    FillMask(pixels, width * 31 + height);
+    std::vector<unsigned char> expected = pixels;
+    BlendCaption_Scalar(expected.data(), pitch, outline.data(), fill.data(), mask_pitch, width, height);
+    BlendCaption_SSE2(pixels.data(), pitch, outline.data(), fill.data(), mask_pitch, width, height);
+    return SameAsReference(expected, pixels, "SSE2", width, height, pad);
+}
+
+// Function to make a template-like image: a colour gradient with some noise
+static DecodedImage MakeTemplate(int width, int height) {
+    DecodedImage image;
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(static_cast<size_t>(width) * height * 4);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            unsigned char* pixel = &image.pixels[(static_cast<size_t>(y) * width + x) * 4];
+            pixel[0] = static_cast<unsigned char>(x * 255 / width);
+            pixel[1] = static_cast<unsigned char>(y * 255 / height);
+            pixel[2] = static_cast<unsigned char>((x ^ y) & 0x7f);
+            pixel[3] = 255;
+        }
+    }
+    return image;
+}
+
+// Function to count near-white and near-black pixels inside a block of rows
+static void CountInk(const DecodedImage& image, int first_row, int last_row, int& white, int& black) {
+    white = black = 0;
+    for (int y = first_row; y < last_row; ++y) {
+        for (int x = 0; x < image.width; ++x) {
+            const unsigned char* pixel = &image.pixels[(static_cast<size_t>(y) * image.width + x) * 4];
+            white += pixel[0] > 240 && pixel[1] > 240 && pixel[2] > 240;
+            black += pixel[0] < 15 && pixel[1] < 15 && pixel[2] < 15;
+        }
+    }
+}
+
+// Function to write the RGB channels as a binary PPM
+static bool SavePPM(const DecodedImage& image, const char* path) {
+    std::ofstream file(path, std::ios::binary);
+    file << "P6\n" << image.width << " " << image.height << "\n255\n";
+    for (size_t pixel = 0; pixel < static_cast<size_t>(image.width) * image.height; ++pixel) {
+        file.write(reinterpret_cast<const char*>(&image.pixels[pixel * 4]), 3);
+    }
+    return static_cast<bool>(file);
+}
+
+int main(int argc, char** argv) {
+    bool ok = true;
+    const int widths[] = { 1, 3, 4, 5, 17, 600, 601 };
+    for (int width : widths) {
+        for (size_t pad : { 0, 12 }) {
+            ok &= CheckKernel(width, 9, pad);
+        }
+    }
+    printf("blend    kernels agree with scalar: %s (dispatch uses %s)\n", ok ? "yes" : "NO", CpuHasSSE2() ? "SSE2" : "Scalar");
+
+    const std::string font_path = FindCaptionFont();
+    CaptionRenderer renderer;
+    if (font_path.empty() || !renderer.LoadFont(font_path)) {
+        printf("no caption font found\n");
+        return ReportCorrectness(false);
+    }
+    printf("font     %s\n", font_path.c_str());
+
+    const DecodedImage source = MakeTemplate(600, 600);
+    const std::vector<std::string> text = { "One does not simply", "walk into Mordor without a caption long enough to wrap" };
+
+    DecodedImage cold = source;
+    auto start = std::chrono::steady_clock::now();
+    ok &= renderer.Render(cold, text);
+    const double cold_ms = MillisecondsSince(start);
+
+    const int rounds = 200;
+    std::vector<double> warm_ms;
+    DecodedImage warm;
+    for (int round = 0; round < rounds; ++round) {
+        warm = source;
+        start = std::chrono::steady_clock::now();
+        renderer.Render(warm, text);
+        warm_ms.push_back(MillisecondsSince(start));
+    }
+    std::sort(warm_ms.begin(), warm_ms.end());
+    const CaptionRenderer::Stats stats = renderer.GetStats();
+    printf("render   600x600 two boxes  cold %7.2f ms, warm p50 %.2f ms p99 %.2f ms (%zu glyphs cached, %llu hits)\n",
+        cold_ms, warm_ms[rounds / 2], warm_ms[rounds * 99 / 100], stats.glyphs, static_cast<unsigned long long>(stats.glyph_hits));
+    ok &= warm.pixels == cold.pixels;
+
+    // Ink where the boxes go, and none across the middle of the image
+    int white, black;
+    CountInk(cold, 0, 200, white, black);
+    ok &= white > 500 && black > 500;
+    CountInk(cold, 400, 600, white, black);
+    ok &= white > 500 && black > 500;
+    ok &= std::equal(cold.pixels.begin() + 280 * 600 * 4, cold.pixels.begin() + 320 * 600 * 4, source.pixels.begin() + 280 * 600 * 4);
+
+    // Odd cases must not crash or write outside the image
+    DecodedImage tiny = MakeTemplate(8, 8);
+    ok &= renderer.Render(tiny, { "far too much text for eight pixels" });
+    DecodedImage many = MakeTemplate(500, 400);
+    ok &= renderer.Render(many, { "one", "", "three", "four", "unicode \xC3\xA9t\xC3\xA9 \xFF bad byte" });
+    DecodedImage empty = source;
+    ok &= renderer.Render(empty, {}) && empty.pixels == source.pixels;
+
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--save") == 0) {
+            SavePPM(cold, argv[i + 1]);
+        }
+    }
+    return ReportCorrectness(ok);
+}
@@ -0,0 +1,213 @@
+// The headless core end to end: catalog parsing, snapshot, search and sort on a synthetic
+// catalog, then an ImageStore over a NullTextureSink fed by a local HTTP server, frame by frame.
+
+#include "bench_util.h"
+#include "http_pool.h"
+#include "image_store.h"
+#include "meme_catalog.h"
+#include "meme_search.h"
+#include "meme_sort.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Function to build a /get_memes style response with rows templates
+static nlohmann::json MakeCatalogResponse(int rows, const std::string& image_origin) {
+    nlohmann::json memes = nlohmann::json::array();
+    for (int i = 0; i < rows; ++i) {
+        memes.push_back({
+            { "id", std::to_string(100000 + i * 7) },
+            { "name", "Meme " + std::to_string(i) + (i % 3 ? " Reaction" : " Classic") },
+            { "url", image_origin + "/img/" + std::to_string(i) + ".ppm" },
+            { "width", 400 + i % 300 },
+            { "height", 300 + i % 200 },
+            { "box_count", 2 + i % 3 },
+        });
+    }
+    return { { "success", true }, { "data", { { "memes", memes } } } };
+}
+
+// Function to encode a binary PPM with a gradient that differs per image, stb_image decodes it
+static std::string MakePPM(int width, int height, int seed) {
+    std::string ppm = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    ppm.reserve(ppm.size() + static_cast<size_t>(width) * height * 3);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            ppm.push_back(static_cast<char>((x + seed) & 0xff));
+            ppm.push_back(static_cast<char>((y * 2 + seed) & 0xff));
+            ppm.push_back(static_cast<char>((x ^ y) & 0xff));
+        }
+    }
+    return ppm;
+}
+
+static bool BenchCatalog(int rows) {
+    bool ok = true;
+    const nlohmann::json response = MakeCatalogResponse(rows, "http://127.0.0.1");
+    const std::string text = response.dump();
+
+    auto start = std::chrono::steady_clock::now();
+    MemeCatalog catalog;
+    nlohmann::json parsed = nlohmann::json::parse(text);
+    ok &= BuildMemeCatalog(parsed, catalog) && static_cast<int>(catalog.Size()) == rows;
+    printf("catalog  %6d rows  parse + build   %8.2f ms (%.1f KB of JSON)\n", rows, SecondsSince(start) * 1e3, text.size() / 1024.0);
+
+    start = std::chrono::steady_clock::now();
+    MemeCatalog loaded;
+    ok &= SaveCatalogSnapshot(catalog, "core_bench_catalog.bin") && LoadCatalogSnapshot("core_bench_catalog.bin", loaded);
+    ok &= loaded == catalog;
+    std::remove("core_bench_catalog.bin");
+    printf("catalog  %6d rows  snapshot save + load %5.2f ms\n", rows, SecondsSince(start) * 1e3);
+
+    start = std::chrono::steady_clock::now();
+    MemeSearchIndex index;
+    index.Build(catalog);
+    MemeSortKeys keys;
+    keys.Build(catalog);
+    printf("catalog  %6d rows  index + sort keys %6.2f ms\n", rows, SecondsSince(start) * 1e3);
+
+    const char* queries[] = { "Meme 12", "Reaction", "Classic", "eme 9", "zzz" };
+    std::vector<uint32_t> found;
+    start = std::chrono::steady_clock::now();
+    const int query_rounds = 200;
+    for (int round = 0; round < query_rounds; ++round) {
+        for (const char* query : queries) {
+            index.Query(catalog, query, found);
+        }
+    }
+    printf("catalog  %6d rows  search          %8.2f us/query\n", rows, SecondsSince(start) * 1e6 / (query_rounds * 5));
+    index.Query(catalog, "Meme 12 ", found);
+    ok &= !found.empty() && strstr(catalog.Name(found[0]), "Meme 12 ") != nullptr;
+    index.Query(catalog, "zzz", found);
+    ok &= found.empty();
+
+    std::vector<uint32_t> order;
+    const MemeSortSpec specs[] = { { MemeSortColumn_Name, false }, { MemeSortColumn_Width, true } };
+    start = std::chrono::steady_clock::now();
+    SortMemeRows(catalog, keys, specs, 2, order);
+    printf("catalog  %6d rows  sort name, width %7.2f ms\n", rows, SecondsSince(start) * 1e3);
+    ok &= static_cast<int>(order.size()) == rows;
+    std::vector<bool> seen(rows, false);
+    for (uint32_t row : order) {
+        ok &= row < seen.size() && !seen[row];
+        seen[row] = true;
+    }
+    for (size_t i = 1; i < order.size(); ++i) {
+        const uint32_t a = order[i - 1];
+        const uint32_t b = order[i];
+        ok &= keys.name_ranks[a] < keys.name_ranks[b] || (keys.name_ranks[a] == keys.name_ranks[b] && catalog.widths[a] >= catalog.widths[b]);
+    }
+    return ok;
+}
+
+static bool BenchImages(int images, int full_images) {
+    httplib::Server server;
+    std::vector<std::string> bodies;
+    for (int i = 0; i < images; ++i) {
+        bodies.push_back(MakePPM(600 + i % 5 * 40, 450 + i % 3 * 30, i));
+    }
+    server.Get(R"(/img/(\d+)\.ppm)", [&](const httplib::Request& request, httplib::Response& response) {
+        const size_t image = std::stoul(request.matches[1]);
+        if (image >= bodies.size()) {
+            response.status = 404;
+            return;
+        }
+        response.set_content(bodies[image], "image/x-portable-pixmap");
+    });
+    const int port = server.bind_to_any_port("127.0.0.1");
+    std::thread server_thread([&] { server.listen_after_bind(); });
+    const std::string origin = "http://127.0.0.1:" + std::to_string(port);
+
+    NullTextureSink sink;
+    bool ok = true;
+    {
+        ImageStore store(sink, 256u * 1024u * 1024u, 32u * 1024u * 1024u, 1024, 8);
+        store.Start(4, 4);
+        UploadBudget budget;
+        double worst_frame_ms = 0.0;
+        int frames = 0;
+        int ready = 0;
+        int failed = 0;
+        const auto start = std::chrono::steady_clock::now();
+        while (SecondsSince(start) < 30.0) {
+            store.BeginFrame();
+            ready = 0;
+            failed = 0;
+            for (int i = 0; i < images; ++i) {
+                const std::string url = origin + "/img/" + std::to_string(i) + ".ppm";
+                StoredImage thumbnail = store.GetThumbnail(url, 100);
+                ready += thumbnail.state == ImageLoadState_Ready;
+                failed += thumbnail.state == ImageLoadState_Failed;
+                if (i < full_images) {
+                    ImageLoadState state;
+                    store.GetTexture(url, &state);
+                    ready += state == ImageLoadState_Ready;
+                    failed += state == ImageLoadState_Failed;
+                }
+            }
+            store.UploadDecoded(budget);
+            worst_frame_ms = std::max(worst_frame_ms, store.GetUploadStats().last_frame_ms);
+            frames++;
+            if (ready + failed == images + full_images && !store.HasPendingUploads()) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        const double seconds = SecondsSince(start);
+        printf("images   %3d thumbnails + %d full  %8.1f ms over %d frames, %.1f images/s, worst upload frame %.2f ms\n",
+            images, full_images, seconds * 1e3, frames, (images + full_images) / seconds, worst_frame_ms);
+        printf("images   atlas %d pages, %llu KB uploaded\n", store.AtlasStats().pages,
+            static_cast<unsigned long long>(sink.GetStats().bytes_written / 1024));
+        ok &= ready == images + full_images && failed == 0;
+    }
+    {
+        // Scroll a window of four thumbnails over every image through an atlas that holds
+        // about twelve: full pages must be emptied and reused rather than left behind
+        ImageStore store(sink, 256u * 1024u * 1024u, 32u * 1024u * 1024u, 256, 2);
+        store.Start(4, 4);
+        UploadBudget budget;
+        const int window = 4;
+        int first = 0;
+        int standalone = 0;
+        const auto start = std::chrono::steady_clock::now();
+        while (first + window <= images && SecondsSince(start) < 30.0) {
+            store.BeginFrame();
+            int ready = 0;
+            for (int i = first; i < first + window; ++i) {
+                const std::string url = origin + "/img/" + std::to_string(i) + ".ppm";
+                const StoredImage thumbnail = store.GetThumbnail(url, 100);
+                if (thumbnail.state == ImageLoadState_Ready) {
+                    ready++;
+                    standalone += thumbnail.uv1[0] == 1.0f && thumbnail.uv1[1] == 1.0f;
+                }
+            }
+            store.UploadDecoded(budget);
+            if (ready == window) {
+                first++;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        const AtlasPacker::Stats atlas = store.AtlasStats();
+        printf("scroll   %d thumbnails through %d atlas pages, %d pages reused, %d standalone thumbnail draws\n",
+            first + window - 1, atlas.pages, atlas.resets, standalone);
+        ok &= first + window > images && atlas.resets > 0 && standalone == 0;
+    }
+    const NullTextureSink::Stats stats = sink.GetStats();
+    ok &= stats.created == stats.released;
+
+    server.stop();
+    server_thread.join();
+    return ok;
+}
+
+int main() {
+    bool ok = true;
+    ok &= BenchCatalog(1000);
+    ok &= BenchCatalog(20000);
+    ok &= BenchImages(64, 16);
+    return ReportCorrectness(ok);
+}
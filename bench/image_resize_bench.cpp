@@ -0,0 +1,92 @@
+// Thumbnail downsampling in image_resize.cpp: the SSE2 halving kernel against the scalar
+// reference, the area filter on flat colours, then halving and the whole thumbnail path timed.
+
+#include "bench_util.h"
+#include "image_resize.h"
+#include "pixel_convert.h"
+#include <cstdio>
+#include <vector>
+
+// Function to halve the same padded image with both kernels
+static bool CheckHalve(int width, int height, size_t pad) {
+    const size_t src_pitch = static_cast<size_t>(width) * 4 + pad;
+    const size_t dst_pitch = static_cast<size_t>(HalvedSize(width)) * 4 + pad;
+    std::vector<unsigned char> src(src_pitch * height);
+    FillRandom(src, static_cast<unsigned>(width * 131 + height));
+
+    std::vector<unsigned char> expected(dst_pitch * HalvedSize(height), 0xCD);
+    std::vector<unsigned char> actual(dst_pitch * HalvedSize(height), 0xCD);
+    HalveRGBA_Scalar(expected.data(), dst_pitch, src.data(), src_pitch, width, height);
+    HalveRGBA_SSE2(actual.data(), dst_pitch, src.data(), src_pitch, width, height);
+    return SameAsReference(expected, actual, "halve", width, height, pad);
+}
+
+// Function to check that downsampling a flat image returns the same flat colour at the expected size
+static bool CheckFlat(int width, int height, int max_size, int expected_width, int expected_height) {
+    std::vector<unsigned char> src(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0; i < src.size(); i += 4) {
+        src[i] = 10; src[i + 1] = 128; src[i + 2] = 250; src[i + 3] = 255;
+    }
+    std::vector<unsigned char> out;
+    int out_width = 0, out_height = 0;
+    DownsampleRGBA(src.data(), width, height, max_size, out, out_width, out_height);
+    bool ok = out_width == expected_width && out_height == expected_height;
+    for (size_t i = 0; ok && i < out.size(); i += 4) {
+        ok = out[i] == 10 && out[i + 1] == 128 && out[i + 2] == 250 && out[i + 3] == 255;
+    }
+    if (!ok) {
+        printf("MISMATCH downsample %dx%d -> %d: got %dx%d\n", width, height, max_size, out_width, out_height);
+    }
+    return ok;
+}
+
+int main() {
+    bool ok = true;
+    const int widths[] = { 1, 2, 3, 7, 8, 9, 15, 16, 17, 33, 100, 257 };
+    for (int width : widths) {
+        for (int height : { 1, 2, 5 }) {
+            for (size_t pad : { static_cast<size_t>(0), static_cast<size_t>(12) }) {
+                ok &= CheckHalve(width, height, pad);
+            }
+        }
+    }
+    ok &= CheckFlat(1200, 900, 100, 100, 75);
+    ok &= CheckFlat(333, 1000, 100, 33, 100);
+    ok &= CheckFlat(150, 120, 100, 100, 80);
+    ok &= CheckFlat(64, 40, 100, 64, 40);
+    const int status = ReportCorrectness(ok);
+
+    const struct { int width, height, iterations; } sizes[] = {
+        { 500, 500, 400 },
+        { 1200, 1200, 60 },
+    };
+    for (const auto& size : sizes) {
+        std::vector<unsigned char> src(static_cast<size_t>(size.width) * size.height * 4);
+        std::vector<unsigned char> dst(static_cast<size_t>(HalvedSize(size.width)) * HalvedSize(size.height) * 4);
+        std::vector<unsigned char> thumbnail;
+        FillRandom(src, 7);
+        const struct { const char* name; HalveFn fn; bool supported; } kernels[] = {
+            { "Scalar", HalveRGBA_Scalar, true },
+            { "SSE2", HalveRGBA_SSE2, CpuHasSSE2() },
+        };
+        for (const auto& kernel : kernels) {
+            if (!kernel.supported) {
+                continue;
+            }
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < size.iterations; ++i) {
+                kernel.fn(dst.data(), static_cast<size_t>(HalvedSize(size.width)) * 4, src.data(), static_cast<size_t>(size.width) * 4, size.width, size.height);
+            }
+            const double seconds = SecondsSince(start);
+            printf("%4dx%-4d halve %-6s %8.1f Mpix/s\n", size.width, size.height, kernel.name, static_cast<double>(size.width) * size.height * size.iterations / seconds / 1e6);
+        }
+        auto start = std::chrono::steady_clock::now();
+        int out_width = 0, out_height = 0;
+        for (int i = 0; i < size.iterations; ++i) {
+            DownsampleRGBA(src.data(), size.width, size.height, 100, thumbnail, out_width, out_height);
+        }
+        const double seconds = SecondsSince(start);
+        printf("%4dx%-4d thumbnail -> %dx%d %8.3f ms\n", size.width, size.height, out_width, out_height, seconds * 1000.0 / size.iterations);
+    }
+    return status;
+}
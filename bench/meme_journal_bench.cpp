@@ -0,0 +1,228 @@
+// The generated memes history in meme_journal.cpp: the chunked list against a vector, then a
+// million journal appends and a reload, a damaged file, compaction and an unwritable file.
+
+#include "bench_util.h"
+#include "meme_journal.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Function to make the i-th sample meme, every field depends on i so a mix-up shows
+static GeneratedMeme SampleMeme(size_t i) {
+    GeneratedMeme meme;
+    meme.created = 1700000000 + static_cast<int64_t>(i);
+    meme.template_id = std::to_string(181913649 + i % 100);
+    meme.text = { "top text " + std::to_string(i), "bottom text" };
+    meme.url = "https://i.imgflip.com/" + std::to_string(i) + ".jpg";
+    return meme;
+}
+
+static bool SameMeme(const GeneratedMeme& a, const GeneratedMeme& b) {
+    return a.created == b.created && a.template_id == b.template_id && a.text == b.text && a.url == b.url;
+}
+
+// Function to open a journal on path and wait for its load, counting the records it hands over.
+// Every record must carry the next timestamp, and every 1000th is compared field by field.
+static MemeJournal::Stats LoadJournal(MemeJournal& journal, const std::string& path, const MemeJournalOptions& options, size_t& records, bool& ok) {
+    records = 0;
+    journal.Open(path, options,
+        [&](const GeneratedMeme& meme) {
+            ok &= meme.created == 1700000000 + static_cast<int64_t>(records);
+            if (records % 1000 == 0) {
+                ok &= SameMeme(meme, SampleMeme(records));
+            }
+            records++;
+        },
+        nullptr);
+    while (!journal.GetStats().loaded) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return journal.GetStats();
+}
+
+// Function to check the chunked list against a vector, including that old lists stay as they were
+static bool CheckList() {
+    bool ok = true;
+    std::shared_ptr<const GeneratedMemeList> list = std::make_shared<const GeneratedMemeList>();
+    std::vector<std::string> expected;
+    std::vector<std::pair<std::shared_ptr<const GeneratedMemeList>, size_t>> snapshots;
+    const size_t batches[] = { 1, 255, 1, 0, 300, 256, 1000, 3 };
+    for (size_t batch : batches) {
+        std::vector<std::string> urls;
+        for (size_t i = 0; i < batch; ++i) {
+            urls.push_back("u" + std::to_string(expected.size() + i));
+        }
+        expected.insert(expected.end(), urls.begin(), urls.end());
+        list = list->Append(urls);
+        snapshots.emplace_back(list, expected.size());
+    }
+    for (const auto& snapshot : snapshots) {
+        ok &= snapshot.first->Size() == snapshot.second;
+        for (size_t i = 0; i < snapshot.first->Size(); ++i) {
+            ok &= (*snapshot.first)[i] == expected[i];
+        }
+    }
+    return ok;
+}
+
+int main() {
+    bool ok = CheckList();
+    printf("list     chunked history matches a vector: %s\n", ok ? "yes" : "NO");
+
+    const fs::path directory = fs::temp_directory_path() / "meme_journal_bench";
+    std::error_code ec;
+    fs::remove_all(directory, ec);
+    fs::create_directories(directory);
+    const std::string path = (directory / "generated_memes.journal").string();
+
+    // A million appends into a fresh journal
+    const size_t count = 1000000;
+    MemeJournalOptions options;
+    std::vector<GeneratedMeme> memes;
+    memes.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        memes.push_back(SampleMeme(i));
+    }
+    {
+        MemeJournal journal;
+        size_t records = 0;
+        LoadJournal(journal, path, options, records, ok);
+        ok &= records == 0;
+
+        std::vector<double> append_us;
+        append_us.reserve(count);
+        const auto start = std::chrono::steady_clock::now();
+        for (const GeneratedMeme& meme : memes) {
+            const auto append_start = std::chrono::steady_clock::now();
+            journal.Append(meme);
+            append_us.push_back(MillisecondsSince(append_start) * 1000.0);
+        }
+        const double append_ms = MillisecondsSince(start);
+        ok &= journal.Flush();
+        const double synced_ms = MillisecondsSince(start);
+        journal.Close();
+        const MemeJournal::Stats stats = journal.GetStats();
+        std::sort(append_us.begin(), append_us.end());
+        printf("append   %zu memes  %7.1f ms (%.0f ns each, p50 %.2f us p99 %.2f us), on disk after %.1f ms, %llu fsyncs, %.1f MB\n",
+            count, append_ms, append_ms * 1e6 / count, append_us[count / 2], append_us[count * 99 / 100], synced_ms,
+            static_cast<unsigned long long>(stats.syncs), stats.bytes / 1048576.0);
+        ok &= stats.records == count && stats.appends == count && stats.syncs > 0 && stats.syncs < count / 100;
+        ok &= stats.failed_writes == 0 && stats.lost_records == 0;
+        ok &= stats.bytes == fs::file_size(path);
+    }
+
+    // Read it back
+    {
+        MemeJournal journal;
+        size_t records = 0;
+        const auto start = std::chrono::steady_clock::now();
+        const MemeJournal::Stats stats = LoadJournal(journal, path, options, records, ok);
+        const double load_ms = MillisecondsSince(start);
+        printf("load     %zu memes  %7.1f ms (scan %.1f ms)\n", records, load_ms, stats.load_ms);
+        ok &= records == count && stats.records == count && stats.damaged_bytes == 0 && stats.compactions == 0;
+    }
+
+    // Flip a byte in the middle and leave half a record at the end: one meme is lost, the tail is cut off
+    const uint64_t clean_size = fs::file_size(path);
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(static_cast<std::streamoff>(clean_size / 2));
+        const char flipped = static_cast<char>(0x5a);
+        file.write(&flipped, 1);
+        file.seekp(0, std::ios::end);
+        file.write("MGJ1\x40\x00\x00\x00torn", 12);
+    }
+    {
+        MemeJournal journal;
+        size_t records = 0;
+        size_t lost = 0;
+        journal.Open(path, options,
+            [&](const GeneratedMeme& meme) {
+                if (!SameMeme(meme, SampleMeme(records + lost))) {
+                    lost++; // The damaged record is skipped, the next one must line up again
+                }
+                ok &= SameMeme(meme, SampleMeme(records + lost));
+                records++;
+            },
+            nullptr);
+        journal.Close();
+        const MemeJournal::Stats stats = journal.GetStats();
+        printf("damage   %zu memes survive, %llu bytes skipped, file cut from %llu to %llu bytes\n",
+            records, static_cast<unsigned long long>(stats.damaged_bytes),
+            static_cast<unsigned long long>(clean_size + 12), static_cast<unsigned long long>(fs::file_size(path)));
+        ok &= records == count - 1 && lost == 1 && stats.damaged_bytes > 12 && fs::file_size(path) == clean_size;
+    }
+
+    // Half the records repeat an earlier URL: compaction at open keeps only the first of each
+    const std::string small_path = (directory / "compact.journal").string();
+    MemeJournalOptions compact_options;
+    compact_options.compact_min_bytes = 0;
+    {
+        MemeJournal journal;
+        journal.Open(small_path, compact_options, nullptr, nullptr);
+        for (size_t i = 0; i < 2000; ++i) {
+            journal.Append(memes[i % 1000]);
+        }
+        journal.Close();
+    }
+    {
+        MemeJournal journal;
+        size_t records = 0;
+        const MemeJournal::Stats stats = LoadJournal(journal, small_path, compact_options, records, ok);
+        journal.Close();
+        ok &= records == 1000 && stats.dead_records == 1000;
+        ok &= journal.GetStats().compactions == 1 && journal.GetStats().bytes == fs::file_size(small_path);
+    }
+    {
+        MemeJournal journal;
+        size_t records = 0;
+        const MemeJournal::Stats stats = LoadJournal(journal, small_path, compact_options, records, ok);
+        journal.Close();
+        printf("compact  2000 records with 1000 repeats -> %zu records, %llu bytes\n", records, static_cast<unsigned long long>(stats.bytes));
+        ok &= records == 1000 && stats.dead_records == 0 && stats.compactions == 0;
+    }
+
+    // The periodic check finds repeats appended after the load, whatever it leaves goes at the next open
+    {
+        MemeJournalOptions periodic_options = compact_options;
+        periodic_options.compact_check_records = 500;
+        MemeJournal journal;
+        size_t records = 0;
+        LoadJournal(journal, small_path, periodic_options, records, ok);
+        for (size_t i = 0; i < 1500; ++i) {
+            journal.Append(memes[i % 1000]);
+        }
+        journal.Close();
+        const uint64_t compactions = journal.GetStats().compactions;
+        MemeJournal reopened;
+        LoadJournal(reopened, small_path, periodic_options, records, ok);
+        reopened.Close();
+        printf("periodic %llu compactions while appending 1500 repeats, %zu records after reopening\n", static_cast<unsigned long long>(compactions), records);
+        ok &= compactions >= 1 && records == 1000;
+    }
+
+    // A journal that cannot be written loses its records, says so in its stats and fails Flush
+    {
+        MemeJournal journal;
+        journal.Open((directory / "missing" / "generated_memes.journal").string(), options, nullptr, nullptr);
+        for (size_t i = 0; i < 10; ++i) {
+            journal.Append(memes[i]);
+        }
+        const bool flushed = journal.Flush();
+        journal.Close();
+        const MemeJournal::Stats stats = journal.GetStats();
+        printf("failure  unwritable journal: flush %s, %llu records lost in %llu failed writes\n", flushed ? "succeeded" : "failed",
+            static_cast<unsigned long long>(stats.lost_records), static_cast<unsigned long long>(stats.failed_writes));
+        ok &= !flushed && stats.lost_records == 10 && stats.failed_writes >= 1 && stats.records == 0;
+    }
+
+    fs::remove_all(directory, ec);
+    return ReportCorrectness(ok);
+}
@@ -0,0 +1,455 @@
+#include "caption_renderer.h"
+#include "pixel_convert.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+// Own copy of stb_truetype, private to this file like the one inside imgui_draw.cpp
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+#define STBTT_STATIC
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "imstb_truetype.h"
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CAPTION_RENDERER_X86 1
+#include <emmintrin.h>
+#else
+#define CAPTION_RENDERER_X86 0
+#endif
+
+static const size_t caption_glyph_limit = 4096; // Cached glyphs before the cache starts over
+static const int caption_min_pixel_size = 10;
+
+struct CaptionRenderer::Font {
+    std::vector<unsigned char> data;
+    stbtt_fontinfo info;
+    int ascent = 0;
+    int descent = 0;
+};
+
+// One wrapped line of a box: codepoints [begin, end) and their width at the chosen size
+struct CaptionRenderer::LineLayout {
+    size_t begin;
+    size_t end;
+    float width;
+};
+
+// Function to divide by 255 with rounding, exact for every product of two bytes
+static inline unsigned Div255(unsigned x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+void BlendCaption_Scalar(unsigned char* rgba, size_t pitch, const unsigned char* outline, const unsigned char* fill, size_t mask_pitch, int width, int height) {
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const unsigned o = outline[x];
+            const unsigned f = fill[x];
+            if ((o | f) == 0) {
+                continue;
+            }
+            unsigned char* pixel = rgba + 4 * x;
+            for (int c = 0; c < 3; ++c) {
+                const unsigned dark = Div255(pixel[c] * (255 - o));
+                pixel[c] = static_cast<unsigned char>(Div255(dark * (255 - f) + 255 * f));
+            }
+            const unsigned alpha = Div255(pixel[3] * (255 - o) + 255 * o);
+            pixel[3] = static_cast<unsigned char>(Div255(alpha * (255 - f) + 255 * f));
+        }
+        rgba += pitch;
+        outline += mask_pitch;
+        fill += mask_pitch;
+    }
+}
+
+#if CAPTION_RENDERER_X86
+
+// Function to divide eight 16-bit products by 255 the same way Div255 does
+static inline __m128i Div255_SSE2(__m128i x) {
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// Function to blend two pixels held as 16-bit channels with their coverage spread over the four channels
+static inline __m128i BlendPixels_SSE2(__m128i pixels, __m128i outline, __m128i fill) {
+    const __m128i full = _mm_set1_epi16(255);
+    const __m128i outline_target = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255); // Black, but alpha goes up
+    pixels = Div255_SSE2(_mm_add_epi16(_mm_mullo_epi16(pixels, _mm_sub_epi16(full, outline)), _mm_mullo_epi16(outline_target, outline)));
+    return Div255_SSE2(_mm_add_epi16(_mm_mullo_epi16(pixels, _mm_sub_epi16(full, fill)), _mm_mullo_epi16(full, fill)));
+}
+
+// Four pixels per step: each coverage byte is repeated into its pixel's four channels,
+// then everything is widened to 16 bits so the products fit
+void BlendCaption_SSE2(unsigned char* rgba, size_t pitch, const unsigned char* outline, const unsigned char* fill, size_t mask_pitch, int width, int height) {
+    const __m128i zero = _mm_setzero_si128();
+    for (int y = 0; y < height; ++y) {
+        int x = 0;
+        for (; x + 4 <= width; x += 4) {
+            int outline4, fill4;
+            memcpy(&outline4, outline + x, 4);
+            memcpy(&fill4, fill + x, 4);
+            if ((outline4 | fill4) == 0) {
+                continue;
+            }
+            __m128i o = _mm_cvtsi32_si128(outline4);
+            o = _mm_unpacklo_epi16(_mm_unpacklo_epi8(o, o), _mm_unpacklo_epi8(o, o));
+            __m128i f = _mm_cvtsi32_si128(fill4);
+            f = _mm_unpacklo_epi16(_mm_unpacklo_epi8(f, f), _mm_unpacklo_epi8(f, f));
+            const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + 4 * x));
+            const __m128i low = BlendPixels_SSE2(_mm_unpacklo_epi8(pixels, zero), _mm_unpacklo_epi8(o, zero), _mm_unpacklo_epi8(f, zero));
+            const __m128i high = BlendPixels_SSE2(_mm_unpackhi_epi8(pixels, zero), _mm_unpackhi_epi8(o, zero), _mm_unpackhi_epi8(f, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + 4 * x), _mm_packus_epi16(low, high));
+        }
+        BlendCaption_Scalar(rgba + 4 * x, pitch, outline + x, fill + x, mask_pitch, width - x, 1);
+        rgba += pitch;
+        outline += mask_pitch;
+        fill += mask_pitch;
+    }
+}
+
+#else // !CAPTION_RENDERER_X86
+
+void BlendCaption_SSE2(unsigned char* rgba, size_t pitch, const unsigned char* outline, const unsigned char* fill, size_t mask_pitch, int width, int height) {
+    BlendCaption_Scalar(rgba, pitch, outline, fill, mask_pitch, width, height);
+}
+
+#endif // CAPTION_RENDERER_X86
+
+// Function to blend with the fastest kernel the CPU supports, picked once at first use
+void BlendCaption(unsigned char* rgba, size_t pitch, const unsigned char* outline, const unsigned char* fill, size_t mask_pitch, int width, int height) {
+    static const CaptionBlendFn kernel = CpuHasSSE2() ? BlendCaption_SSE2 : BlendCaption_Scalar;
+    kernel(rgba, pitch, outline, fill, mask_pitch, width, height);
+}
+
+// Function to get the outline width for a font size, about a sixteenth of the size
+static int OutlineRadius(int pixel_size) {
+    return std::max(1, (pixel_size + 8) / 16);
+}
+
+// Function to grow a coverage mask by a disc of the given radius: horizontal maxima of every
+// half width are built up one pixel at a time, then each row takes the widest one the disc
+// allows at that vertical distance
+static std::vector<unsigned char> DilateDisc(const std::vector<unsigned char>& mask, int width, int height, int radius) {
+    std::vector<std::vector<unsigned char>> spans(radius + 1);
+    spans[0] = mask;
+    for (int half = 1; half <= radius; ++half) {
+        const std::vector<unsigned char>& previous = spans[half - 1];
+        std::vector<unsigned char>& span = spans[half];
+        span.resize(previous.size());
+        for (int y = 0; y < height; ++y) {
+            const unsigned char* src = previous.data() + static_cast<size_t>(y) * width;
+            unsigned char* dst = span.data() + static_cast<size_t>(y) * width;
+            for (int x = 0; x < width; ++x) {
+                unsigned char value = src[x];
+                value = std::max(value, x > 0 ? src[x - 1] : value);
+                value = std::max(value, x + 1 < width ? src[x + 1] : value);
+                dst[x] = value;
+            }
+        }
+    }
+
+    std::vector<unsigned char> dilated(mask.size(), 0);
+    const float reach = radius + 0.5f;
+    for (int dy = -radius; dy <= radius; ++dy) {
+        const int half = std::min(radius, static_cast<int>(std::sqrt(reach * reach - dy * dy)));
+        const std::vector<unsigned char>& span = spans[half];
+        for (int y = std::max(0, -dy); y < std::min(height, height - dy); ++y) {
+            const unsigned char* src = span.data() + static_cast<size_t>(y + dy) * width;
+            unsigned char* dst = dilated.data() + static_cast<size_t>(y) * width;
+            for (int x = 0; x < width; ++x) {
+                dst[x] = std::max(dst[x], src[x]);
+            }
+        }
+    }
+    return dilated;
+}
+
+// Function to decode UTF-8 into upper case codepoints, invalid bytes become '?'
+static std::vector<int> DecodeCaption(const std::string& text) {
+    std::vector<int> codepoints;
+    codepoints.reserve(text.size());
+    for (size_t i = 0; i < text.size();) {
+        const unsigned char lead = static_cast<unsigned char>(text[i]);
+        int length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+        int codepoint = length == 1 ? lead : length == 2 ? lead & 0x1F : length == 3 ? lead & 0x0F : lead & 0x07;
+        for (int k = 1; k < length; ++k) {
+            const unsigned char next = i + k < text.size() ? static_cast<unsigned char>(text[i + k]) : 0;
+            if ((next & 0xC0) != 0x80) {
+                length = 0;
+                break;
+            }
+            codepoint = (codepoint << 6) | (next & 0x3F);
+        }
+        if (length == 0) {
+            codepoints.push_back('?');
+            i++;
+            continue;
+        }
+        codepoints.push_back(codepoint >= 'a' && codepoint <= 'z' ? codepoint - 'a' + 'A' : codepoint);
+        i += length;
+    }
+    return codepoints;
+}
+
+CaptionRenderer::CaptionRenderer() = default;
+CaptionRenderer::~CaptionRenderer() = default;
+
+// Function to load a TrueType font file, replacing any font loaded before
+bool CaptionRenderer::LoadFont(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return LoadFontFromMemory(std::move(data));
+}
+
+// Function to use font data already in memory, the renderer keeps it
+bool CaptionRenderer::LoadFontFromMemory(std::vector<unsigned char> data) {
+    auto loaded = std::make_unique<Font>();
+    loaded->data = std::move(data);
+    const int offset = loaded->data.empty() ? -1 : stbtt_GetFontOffsetForIndex(loaded->data.data(), 0);
+    if (offset < 0 || !stbtt_InitFont(&loaded->info, loaded->data.data(), offset)) {
+        return false;
+    }
+    int line_gap;
+    stbtt_GetFontVMetrics(&loaded->info, &loaded->ascent, &loaded->descent, &line_gap);
+
+    std::lock_guard<std::mutex> lock(glyph_mutex);
+    font = std::move(loaded);
+    glyphs.clear();
+    return true;
+}
+
+// Function to get a glyph's bitmaps, rasterizing and caching them on first use
+std::shared_ptr<const CaptionGlyph> CaptionRenderer::GetGlyph(int codepoint, int pixel_size) {
+    const uint64_t key = static_cast<uint64_t>(pixel_size) << 32 | static_cast<uint32_t>(codepoint);
+    {
+        std::lock_guard<std::mutex> lock(glyph_mutex);
+        auto found = glyphs.find(key);
+        if (found != glyphs.end()) {
+            stats.glyph_hits++;
+            return found->second;
+        }
+        stats.glyph_misses++;
+    }
+
+    PROFILE_SCOPE("Rasterize glyph");
+    auto glyph = std::make_shared<CaptionGlyph>();
+    const float scale = stbtt_ScaleForPixelHeight(&font->info, static_cast<float>(pixel_size));
+    int advance, left_bearing;
+    stbtt_GetCodepointHMetrics(&font->info, codepoint, &advance, &left_bearing);
+    glyph->advance = advance * scale;
+    int x0, y0, x1, y1;
+    stbtt_GetCodepointBitmapBox(&font->info, codepoint, scale, scale, &x0, &y0, &x1, &y1);
+    if (x1 > x0 && y1 > y0) {
+        const int radius = OutlineRadius(pixel_size);
+        glyph->width = x1 - x0 + 2 * radius;
+        glyph->height = y1 - y0 + 2 * radius;
+        glyph->x_offset = x0 - radius;
+        glyph->y_offset = y0 - radius;
+        glyph->fill.assign(static_cast<size_t>(glyph->width) * glyph->height, 0);
+        stbtt_MakeCodepointBitmap(&font->info, glyph->fill.data() + radius * glyph->width + radius, x1 - x0, y1 - y0, glyph->width, scale, scale, codepoint);
+        glyph->outline = DilateDisc(glyph->fill, glyph->width, glyph->height, radius);
+    }
+
+    std::lock_guard<std::mutex> lock(glyph_mutex);
+    if (glyphs.size() >= caption_glyph_limit) {
+        glyphs.clear(); // Glyphs still in use stay alive through their shared_ptr
+    }
+    return glyphs.emplace(key, std::move(glyph)).first->second;
+}
+
+// Function to measure codepoints [begin, end) at a size from the font metrics, nothing is rasterized
+float CaptionRenderer::MeasureText(const std::vector<int>& codepoints, size_t begin, size_t end, int pixel_size) {
+    const float scale = stbtt_ScaleForPixelHeight(&font->info, static_cast<float>(pixel_size));
+    int width = 0;
+    for (size_t i = begin; i < end; ++i) {
+        int advance, left_bearing;
+        stbtt_GetCodepointHMetrics(&font->info, codepoints[i], &advance, &left_bearing);
+        width += advance;
+        if (i + 1 < end) {
+            width += stbtt_GetCodepointKernAdvance(&font->info, codepoints[i], codepoints[i + 1]);
+        }
+    }
+    return width * scale;
+}
+
+// Function to wrap a box at word boundaries, shrinking the size from max_size until the lines fit
+// max_width by max_height. Returns the pixel size used; at the smallest size the text may still overflow.
+int CaptionRenderer::LayoutBox(const std::vector<int>& codepoints, int max_width, int max_height, int max_size, std::vector<LineLayout>& lines) {
+    int pixel_size = std::max(caption_min_pixel_size, max_size);
+    for (;;) {
+        lines.clear();
+        float widest = 0.0f;
+        size_t line_begin = 0;
+        while (line_begin < codepoints.size()) {
+            while (line_begin < codepoints.size() && codepoints[line_begin] == ' ') {
+                line_begin++;
+            }
+            if (line_begin == codepoints.size()) {
+                break;
+            }
+            // Take words while they fit, always at least one
+            size_t line_end = line_begin;
+            float line_width = 0.0f;
+            while (line_end < codepoints.size() && codepoints[line_end] != '\n') {
+                size_t word_end = line_end;
+                while (word_end < codepoints.size() && codepoints[word_end] == ' ') {
+                    word_end++;
+                }
+                if (word_end == codepoints.size() || codepoints[word_end] == '\n') {
+                    line_end = word_end; // Trailing spaces, not counted in the width
+                    break;
+                }
+                while (word_end < codepoints.size() && codepoints[word_end] != ' ' && codepoints[word_end] != '\n') {
+                    word_end++;
+                }
+                const float width = MeasureText(codepoints, line_begin, word_end, pixel_size);
+                if (line_end > line_begin && width > max_width) {
+                    break;
+                }
+                line_end = word_end;
+                line_width = width;
+            }
+            lines.push_back({ line_begin, line_end, line_width });
+            widest = std::max(widest, line_width);
+            line_begin = line_end < codepoints.size() && codepoints[line_end] == '\n' ? line_end + 1 : line_end;
+        }
+        const float scale = stbtt_ScaleForPixelHeight(&font->info, static_cast<float>(pixel_size));
+        const float height = lines.size() * (font->ascent - font->descent) * scale;
+        if ((widest <= max_width && height <= max_height) || pixel_size == caption_min_pixel_size) {
+            return pixel_size;
+        }
+        pixel_size = std::max(caption_min_pixel_size, std::min(pixel_size - 1, pixel_size * 9 / 10));
+    }
+}
+
+// Function to draw text onto the top level of image, any mip chain is dropped
+bool CaptionRenderer::Render(DecodedImage& image, const std::vector<std::string>& text) {
+    PROFILE_SCOPE("Render caption");
+    if (!font || image.width <= 0 || image.height <= 0 || image.pixels.size() < static_cast<size_t>(image.width) * image.height * 4) {
+        return false;
+    }
+    const int width = image.width;
+    const int height = image.height;
+    image.pixels.resize(static_cast<size_t>(width) * height * 4);
+    image.mips.clear();
+
+    // Boxes and where they go: up to two take the top and bottom thirds, more share the height evenly
+    const int boxes = static_cast<int>(text.size());
+    const int margin = std::max(2, std::min(width, height) / 40);
+    const int max_width = width - 2 * margin;
+    const int band_height = boxes <= 2 ? (height - 2 * margin) / 3 : (height - 2 * margin) / std::max(boxes, 1);
+    const int max_size = std::min(band_height, std::max(caption_min_pixel_size, std::min(width, height) / 7));
+
+    std::vector<unsigned char> outline_mask(static_cast<size_t>(width) * height, 0);
+    std::vector<unsigned char> fill_mask(outline_mask.size(), 0);
+    std::vector<std::pair<int, int>> row_ranges; // Mask rows each box touched
+    std::vector<LineLayout> lines;
+    for (int box = 0; box < boxes; ++box) {
+        const std::vector<int> codepoints = DecodeCaption(text[box]);
+        if (codepoints.empty()) {
+            continue;
+        }
+        const int pixel_size = LayoutBox(codepoints, max_width, band_height, max_size, lines);
+        if (lines.empty()) {
+            continue;
+        }
+        const float scale = stbtt_ScaleForPixelHeight(&font->info, static_cast<float>(pixel_size));
+        const float line_height = (font->ascent - font->descent) * scale;
+        const float block_height = lines.size() * line_height;
+        const bool bottom = boxes > 1 && box == boxes - 1;
+        float top;
+        if (box == 0) {
+            top = static_cast<float>(margin);
+        }
+        else if (bottom) {
+            top = height - margin - block_height;
+        }
+        else {
+            top = margin + band_height * box + (band_height - block_height) * 0.5f;
+        }
+
+        int first_row = height;
+        int last_row = 0;
+        for (size_t line = 0; line < lines.size(); ++line) {
+            const int baseline = static_cast<int>(std::lround(top + line * line_height + font->ascent * scale));
+            float pen = (width - lines[line].width) * 0.5f;
+            for (size_t i = lines[line].begin; i < lines[line].end; ++i) {
+                const std::shared_ptr<const CaptionGlyph> glyph = GetGlyph(codepoints[i], pixel_size);
+                const int gx = static_cast<int>(std::lround(pen)) + glyph->x_offset;
+                const int gy = baseline + glyph->y_offset;
+                const int x_begin = std::max(0, -gx);
+                const int x_end = std::min(glyph->width, width - gx);
+                for (int y = std::max(0, -gy); y < std::min(glyph->height, height - gy); ++y) {
+                    const size_t src = static_cast<size_t>(y) * glyph->width;
+                    const size_t dst = static_cast<size_t>(gy + y) * width + gx;
+                    for (int x = x_begin; x < x_end; ++x) {
+                        outline_mask[dst + x] = std::max(outline_mask[dst + x], glyph->outline[src + x]);
+                        fill_mask[dst + x] = std::max(fill_mask[dst + x], glyph->fill[src + x]);
+                    }
+                    first_row = std::min(first_row, gy + y);
+                    last_row = std::max(last_row, gy + y + 1);
+                }
+                pen += glyph->advance;
+                if (i + 1 < lines[line].end) {
+                    pen += stbtt_GetCodepointKernAdvance(&font->info, codepoints[i], codepoints[i + 1]) * scale;
+                }
+            }
+        }
+        if (first_row < last_row) {
+            row_ranges.push_back({ first_row, last_row });
+        }
+    }
+
+    // Blend each band of rows once, merging boxes whose rows overlap
+    std::sort(row_ranges.begin(), row_ranges.end());
+    for (size_t i = 0; i < row_ranges.size();) {
+        int first_row = row_ranges[i].first;
+        int last_row = row_ranges[i].second;
+        for (++i; i < row_ranges.size() && row_ranges[i].first <= last_row; ++i) {
+            last_row = std::max(last_row, row_ranges[i].second);
+        }
+        const size_t mask_offset = static_cast<size_t>(first_row) * width;
+        BlendCaption(image.pixels.data() + mask_offset * 4, static_cast<size_t>(width) * 4, outline_mask.data() + mask_offset,
+            fill_mask.data() + mask_offset, width, width, last_row - first_row);
+    }
+    return true;
+}
+
+CaptionRenderer::Stats CaptionRenderer::GetStats() {
+    std::lock_guard<std::mutex> lock(glyph_mutex);
+    Stats snapshot = stats;
+    snapshot.glyphs = glyphs.size();
+    return snapshot;
+}
+
+// Function to find a font for captions: MEME_CAPTION_FONT, then Impact, then the bundled ImGui fonts
+std::string FindCaptionFont() {
+    std::vector<std::string> candidates;
+    if (const char* path = std::getenv("MEME_CAPTION_FONT")) {
+        candidates.push_back(path);
+    }
+    candidates.push_back("C:\\Windows\\Fonts\\impact.ttf");
+    candidates.push_back("/usr/share/fonts/truetype/msttcorefonts/Impact.ttf");
+    candidates.push_back("imgui/misc/fonts/Roboto-Medium.ttf");
+#ifdef MEME_FONT_DIR
+    candidates.push_back(MEME_FONT_DIR "/Roboto-Medium.ttf");
+#endif
+    for (const std::string& candidate : candidates) {
+        if (std::ifstream(candidate, std::ios::binary).is_open()) {
+            return candidate;
+        }
+    }
+    return "";
+}
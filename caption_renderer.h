@@ -0,0 +1,81 @@
+#ifndef CAPTION_RENDERER_H
+#define CAPTION_RENDERER_H
+
+#include "image_pipeline.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Row blenders that draw caption text over RGBA8 pixels: every pixel is first pulled towards
+// black by its outline coverage, then towards white by its fill coverage, alpha goes towards
+// opaque with both. Masks hold one coverage byte per pixel. Both kernels round the same way,
+// so they produce identical bytes.
+typedef void (*CaptionBlendFn)(unsigned char* rgba, size_t pitch, const unsigned char* outline, const unsigned char* fill, size_t mask_pitch, int width, int height);
+
+void BlendCaption_Scalar(unsigned char* rgba, size_t pitch, const unsigned char* outline, const unsigned char* fill, size_t mask_pitch, int width, int height);
+void BlendCaption_SSE2(unsigned char* rgba, size_t pitch, const unsigned char* outline, const unsigned char* fill, size_t mask_pitch, int width, int height);
+
+// Function to blend with the fastest kernel the CPU supports
+void BlendCaption(unsigned char* rgba, size_t pitch, const unsigned char* outline, const unsigned char* fill, size_t mask_pitch, int width, int height);
+
+// One rasterized glyph at one pixel size. fill and outline share the same box, which is
+// padded by the outline radius on every side; offsets are from the pen position on the baseline.
+struct CaptionGlyph {
+    int width = 0;
+    int height = 0;
+    int x_offset = 0;
+    int y_offset = 0;
+    float advance = 0.0f;
+    std::vector<unsigned char> fill;
+    std::vector<unsigned char> outline;
+};
+
+// Local stand-in for /caption_image: lays the caption boxes out over a decoded template the
+// classic way, upper case white text with a black outline, the first box at the top, the
+// last at the bottom and any others spread in between, each shrunk until it fits.
+// Glyphs are rasterized with stb_truetype once per size and kept, so repeated captions only
+// pay for layout and blending. Render can be called from several threads at once.
+class CaptionRenderer {
+public:
+    struct Stats {
+        uint64_t glyph_hits = 0;
+        uint64_t glyph_misses = 0;
+        size_t glyphs = 0;
+    };
+
+    CaptionRenderer();
+    ~CaptionRenderer();
+    CaptionRenderer(const CaptionRenderer&) = delete;
+    CaptionRenderer& operator=(const CaptionRenderer&) = delete;
+
+    bool LoadFont(const std::string& path);
+    bool LoadFontFromMemory(std::vector<unsigned char> data);
+    bool HasFont() const { return font != nullptr; }
+
+    // Function to draw text onto the top level of image, any mip chain is dropped
+    bool Render(DecodedImage& image, const std::vector<std::string>& text);
+    Stats GetStats();
+
+private:
+    struct Font;
+    struct LineLayout;
+
+    std::shared_ptr<const CaptionGlyph> GetGlyph(int codepoint, int pixel_size);
+    float MeasureText(const std::vector<int>& codepoints, size_t begin, size_t end, int pixel_size);
+    int LayoutBox(const std::vector<int>& codepoints, int max_width, int max_height, int max_size, std::vector<LineLayout>& lines);
+
+    std::unique_ptr<Font> font;
+    std::mutex glyph_mutex; // Guards glyphs and stats
+    std::unordered_map<uint64_t, std::shared_ptr<const CaptionGlyph>> glyphs;
+    Stats stats;
+};
+
+// Function to find a font for captions: MEME_CAPTION_FONT, then Impact, then the bundled ImGui fonts.
+// Returns an empty string if none of them exists.
+std::string FindCaptionFont();
+
+#endif // CAPTION_RENDERER_H
@@ -0,0 +1,110 @@
+#include "catalog_store.h"
+#include "http_pool.h"
+#include "profiler.h"
+#include "wake_signal.h"
+#include <iostream>
+#include <mutex>
+
+static std::mutex catalog_mutex;
+static std::shared_ptr<const LoadedCatalog> current_catalog = std::make_shared<LoadedCatalog>();
+static CatalogFetchStatus fetch_status;
+static const size_t catalog_first_batch_rows = 256; // Rows published before the rest of a large first fetch
+
+// Function to record the fetch state
+static void SetFetchStatus(CatalogFetchState state, const std::string& error = std::string()) {
+    {
+        std::lock_guard<std::mutex> lock(catalog_mutex);
+        fetch_status.state = state;
+        fetch_status.error = error;
+    }
+    WakeRenderLoop();
+}
+
+// Function to get the state of the last fetch
+CatalogFetchStatus GetCatalogFetchStatus() {
+    std::lock_guard<std::mutex> lock(catalog_mutex);
+    return fetch_status;
+}
+
+// Function to get the current catalog
+std::shared_ptr<const LoadedCatalog> GetLoadedCatalog() {
+    std::lock_guard<std::mutex> lock(catalog_mutex);
+    return current_catalog;
+}
+
+// Function to build the derived data and swap the catalog in for every reader.
+// The expensive part runs before the lock, the swap itself is a pointer exchange.
+void PublishCatalog(MemeCatalog catalog) {
+    PROFILE_SCOPE("Publish catalog");
+    auto loaded = std::make_shared<LoadedCatalog>();
+    loaded->catalog = std::move(catalog);
+    loaded->search_index.Build(loaded->catalog);
+    loaded->sort_keys.Build(loaded->catalog);
+
+    {
+        std::lock_guard<std::mutex> lock(catalog_mutex);
+        loaded->generation = current_catalog->generation + 1;
+        current_catalog = std::move(loaded);
+    }
+    WakeRenderLoop();
+}
+
+// Function to publish the snapshot at path
+bool LoadCatalogFromSnapshot(const std::string& path) {
+    PROFILE_SCOPE("Load catalog snapshot");
+    MemeCatalog catalog;
+    if (!LoadCatalogSnapshot(path, catalog) || catalog.Empty()) {
+        return false;
+    }
+    PublishCatalog(std::move(catalog));
+    return true;
+}
+
+// Function to copy the first rows of a catalog
+static MemeCatalog CatalogPrefix(const MemeCatalog& catalog, size_t rows) {
+    MemeCatalog prefix;
+    prefix.Reserve(rows, 0);
+    for (size_t row = 0; row < rows; ++row) {
+        prefix.Add(catalog.Id(row), catalog.Name(row), catalog.Url(row), catalog.widths[row], catalog.heights[row], catalog.box_counts[row]);
+    }
+    return prefix;
+}
+
+// Function to fetch /get_memes and swap the result in if it changed
+bool RefreshCatalog(const std::string& snapshot_path) {
+    PROFILE_SCOPE("Refresh catalog");
+    SetFetchStatus(CatalogFetchState_Loading);
+
+    auto res = GetHttpClientPool().Get(GetApiOrigin(), "/get_memes");
+    if (!res || res->status != 200) {
+        std::string error = res ? "HTTP status " + std::to_string(res->status) : "Request failed: " + httplib::to_string(res.error());
+        std::cerr << "Failed to fetch meme data: " << error << std::endl;
+        SetFetchStatus(CatalogFetchState_Failed, error);
+        return false;
+    }
+
+    nlohmann::json response = nlohmann::json::parse(res->body, nullptr, false);
+    MemeCatalog catalog;
+    if (response.is_discarded() || !BuildMemeCatalog(response, catalog)) {
+        std::cerr << "Failed to parse meme data" << std::endl;
+        SetFetchStatus(CatalogFetchState_Failed, "Malformed response");
+        return false;
+    }
+
+    std::shared_ptr<const LoadedCatalog> shown = GetLoadedCatalog();
+    if (catalog == shown->catalog) {
+        SetFetchStatus(CatalogFetchState_Ready);
+        return true; // Snapshot was already current, keep the views the UI has built
+    }
+    if (shown->catalog.Empty() && catalog.Size() > catalog_first_batch_rows) {
+        PublishCatalog(CatalogPrefix(catalog, catalog_first_batch_rows));
+    }
+    shown.reset();
+
+    if (!SaveCatalogSnapshot(catalog, snapshot_path)) {
+        std::cerr << "Failed to save meme catalog snapshot: " << snapshot_path << std::endl;
+    }
+    PublishCatalog(std::move(catalog));
+    SetFetchStatus(CatalogFetchState_Ready);
+    return true;
+}
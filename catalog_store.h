@@ -0,0 +1,45 @@
+#ifndef CATALOG_STORE_H
+#define CATALOG_STORE_H
+
+#include "meme_catalog.h"
+#include "meme_search.h"
+#include "meme_sort.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// A catalog together with everything derived from it. Published as one immutable unit,
+// so a reader holding the pointer never sees the index and the rows disagree.
+struct LoadedCatalog {
+    MemeCatalog catalog;
+    MemeSearchIndex search_index;
+    MemeSortKeys sort_keys;
+    uint64_t generation = 0; // Bumped on every publish, readers compare it to drop cached views
+};
+
+// Progress of the background catalog fetch, polled by the UI every frame
+enum CatalogFetchState {
+    CatalogFetchState_Idle,
+    CatalogFetchState_Loading,
+    CatalogFetchState_Ready,
+    CatalogFetchState_Failed,
+};
+
+struct CatalogFetchStatus {
+    CatalogFetchState state = CatalogFetchState_Idle;
+    std::string error; // Set when state is CatalogFetchState_Failed
+};
+
+// Function to get the current catalog, never null (empty until the first publish)
+std::shared_ptr<const LoadedCatalog> GetLoadedCatalog();
+// Function to build the derived data and swap the catalog in for every reader
+void PublishCatalog(MemeCatalog catalog);
+// Function to publish the snapshot at path, returns false if there is no usable one
+bool LoadCatalogFromSnapshot(const std::string& path);
+// Function to fetch /get_memes, swap the result in if it differs from the current catalog and rewrite the snapshot.
+// When nothing is shown yet the first rows are published ahead of the rest, so the table fills in early.
+bool RefreshCatalog(const std::string& snapshot_path);
+// Function to get the state of the last RefreshCatalog call
+CatalogFetchStatus GetCatalogFetchStatus();
+
+#endif // CATALOG_STORE_H
@@ -0,0 +1,37 @@
+#include "d3d9_texture_sink.h"
+#include "pixel_convert.h"
+
+void* D3D9TextureSink::CreateTexture(int width, int height, int levels) {
+    if (!device || width <= 0 || height <= 0) {
+        return nullptr;
+    }
+    LPDIRECT3DTEXTURE9 texture = nullptr;
+    if (FAILED(device->CreateTexture(width, height, static_cast<UINT>(levels), 0, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &texture, nullptr))) {
+        return nullptr;
+    }
+    return texture;
+}
+
+// Function to lock just the written rows and convert them into the rect's pitch
+bool D3D9TextureSink::WriteRegion(void* texture, int level, int x, int y, int width, int height, const unsigned char* rgba, size_t pitch) {
+    LPDIRECT3DTEXTURE9 target = static_cast<LPDIRECT3DTEXTURE9>(texture);
+    RECT area = { x, y, x + width, y + height };
+    D3DLOCKED_RECT rect;
+    if (FAILED(target->LockRect(static_cast<UINT>(level), &rect, &area, 0))) {
+        return false;
+    }
+    const size_t row_bytes = static_cast<size_t>(width) * 4;
+    if (rect.Pitch < 0 || static_cast<size_t>(rect.Pitch) < row_bytes) {
+        target->UnlockRect(static_cast<UINT>(level));
+        return false;
+    }
+    ConvertRGBAToBGRA(static_cast<unsigned char*>(rect.pBits), rect.Pitch, rgba, pitch, width, height);
+    target->UnlockRect(static_cast<UINT>(level));
+    return true;
+}
+
+void D3D9TextureSink::ReleaseTexture(void* texture) {
+    if (texture) {
+        static_cast<LPDIRECT3DTEXTURE9>(texture)->Release();
+    }
+}
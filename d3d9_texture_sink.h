@@ -0,0 +1,22 @@
+#ifndef D3D9_TEXTURE_SINK_H
+#define D3D9_TEXTURE_SINK_H
+
+#include "texture_sink.h"
+#include <d3d9.h>
+
+// TextureSink over managed D3D9 textures in D3DFMT_A8R8G8B8. Pixels are converted from
+// RGBA to BGRA while they are copied into the locked rect. Holds a reference to the
+// device pointer, so the sink can be created before the device is.
+class D3D9TextureSink : public TextureSink {
+public:
+    explicit D3D9TextureSink(LPDIRECT3DDEVICE9& device) : device(device) {}
+
+    void* CreateTexture(int width, int height, int levels) override;
+    bool WriteRegion(void* texture, int level, int x, int y, int width, int height, const unsigned char* rgba, size_t pitch) override;
+    void ReleaseTexture(void* texture) override;
+
+private:
+    LPDIRECT3DDEVICE9& device;
+};
+
+#endif // D3D9_TEXTURE_SINK_H
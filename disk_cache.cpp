@@ -0,0 +1,229 @@
+#include "disk_cache.h"
+#include "json.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Entry file layout: magic, header size, body size, JSON header, body
+static const char disk_cache_magic[4] = { 'M', 'D', 'C', '1' };
+static const size_t disk_cache_prefix_size = 4 + 4 + 8;
+
+// Function to hash a URL into the cache key used for its file name (64-bit FNV-1a)
+std::string DiskCacheKey(const std::string& url) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : url) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    static const char hex[] = "0123456789abcdef";
+    std::string key(16, '0');
+    for (int i = 15; i >= 0; --i) {
+        key[i] = hex[hash & 0xf];
+        hash >>= 4;
+    }
+    return key;
+}
+
+DiskCache::DiskCache(const std::string& directory, uint64_t max_bytes)
+    : directory(directory) {
+    stats.max_bytes = max_bytes;
+}
+
+std::string DiskCache::PathFor(const std::string& key) const {
+    return (fs::path(directory) / (key + ".bin")).string();
+}
+
+// Function to scan the cache directory once, oldest files become the first eviction candidates
+void DiskCache::LoadIndexLocked() {
+    if (index_loaded) {
+        return;
+    }
+    index_loaded = true;
+
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+
+    struct Found {
+        std::string key;
+        uint64_t bytes;
+        fs::file_time_type modified;
+    };
+    std::vector<Found> found;
+    for (fs::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+        const fs::path& path = it->path();
+        if (path.filename().string().find(".tmp") != std::string::npos) {
+            fs::remove(path, ec); // Left over from an interrupted write
+            continue;
+        }
+        if (path.extension() != ".bin") {
+            continue;
+        }
+        std::error_code size_ec, time_ec;
+        uint64_t bytes = fs::file_size(path, size_ec);
+        fs::file_time_type modified = fs::last_write_time(path, time_ec);
+        if (!size_ec && !time_ec) {
+            found.push_back({ path.stem().string(), bytes, modified });
+        }
+    }
+
+    std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) { return a.modified < b.modified; });
+    for (const Found& entry : found) {
+        index[entry.key] = { entry.bytes, ++access_clock };
+        stats.bytes += entry.bytes;
+    }
+    stats.entries = index.size();
+    EvictLocked();
+}
+
+// Function to map the entry for url
+bool DiskCache::Lookup(const std::string& url, MappedFile& file, size_t& body_offset, DiskCacheValidators& validators) {
+    const std::string key = DiskCacheKey(url);
+    std::lock_guard<std::mutex> lock(mutex);
+    LoadIndexLocked();
+
+    auto it = index.find(key);
+    if (it == index.end() || !file.Open(PathFor(key))) {
+        stats.misses++;
+        return false;
+    }
+
+    // Validate the prefix and header before trusting the body
+    const unsigned char* data = file.Data();
+    uint32_t header_size = 0;
+    uint64_t body_size = 0;
+    bool valid = file.Size() >= disk_cache_prefix_size && memcmp(data, disk_cache_magic, 4) == 0;
+    if (valid) {
+        memcpy(&header_size, data + 4, sizeof(header_size));
+        memcpy(&body_size, data + 8, sizeof(body_size));
+        valid = file.Size() == disk_cache_prefix_size + header_size + body_size;
+    }
+    nlohmann::json header;
+    if (valid) {
+        header = nlohmann::json::parse(data + disk_cache_prefix_size, data + disk_cache_prefix_size + header_size, nullptr, false);
+        valid = header.is_object() && header.value("url", std::string()) == url;
+    }
+    if (!valid) {
+        file.Close();
+        RemoveLocked(key);
+        stats.misses++;
+        return false;
+    }
+
+    validators.etag = header.value("etag", std::string());
+    validators.last_modified = header.value("last_modified", std::string());
+    validators.stored_at = header.value("stored_at", static_cast<int64_t>(0));
+    body_offset = disk_cache_prefix_size + header_size;
+    it->second.last_access = ++access_clock;
+    stats.hits++;
+    return true;
+}
+
+// Function to write an entry through a temporary file and rename it into place
+bool DiskCache::Store(const std::string& url, const char* body, size_t body_size, const DiskCacheValidators& validators) {
+    const std::string key = DiskCacheKey(url);
+    nlohmann::json header = {
+        { "url", url },
+        { "etag", validators.etag },
+        { "last_modified", validators.last_modified },
+        { "stored_at", validators.stored_at },
+    };
+    const std::string header_text = header.dump();
+    const uint32_t header_size = static_cast<uint32_t>(header_text.size());
+    const uint64_t body_size64 = body_size;
+
+    std::string temp_path;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        LoadIndexLocked();
+        temp_path = PathFor(key) + ".tmp" + std::to_string(++temp_counter);
+    }
+
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        out.write(disk_cache_magic, 4);
+        out.write(reinterpret_cast<const char*>(&header_size), sizeof(header_size));
+        out.write(reinterpret_cast<const char*>(&body_size64), sizeof(body_size64));
+        out.write(header_text.data(), header_text.size());
+        out.write(body, static_cast<std::streamsize>(body_size));
+        out.close();
+        if (!out) {
+            std::error_code ec;
+            fs::remove(temp_path, ec);
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::error_code ec;
+    fs::rename(temp_path, PathFor(key), ec);
+    if (ec) {
+        fs::remove(temp_path, ec);
+        return false;
+    }
+
+    const uint64_t bytes = disk_cache_prefix_size + header_size + body_size64;
+    auto it = index.find(key);
+    if (it != index.end()) {
+        stats.bytes -= it->second.bytes;
+    }
+    index[key] = { bytes, ++access_clock };
+    stats.bytes += bytes;
+    stats.entries = index.size();
+    EvictLocked();
+    return true;
+}
+
+// Function to delete one entry
+void DiskCache::RemoveLocked(const std::string& key) {
+    auto it = index.find(key);
+    if (it == index.end()) {
+        return;
+    }
+    std::error_code ec;
+    fs::remove(PathFor(key), ec);
+    stats.bytes -= it->second.bytes;
+    index.erase(it);
+    stats.entries = index.size();
+}
+
+// Function to delete least recently used entries down to 90% of the cap, so eviction runs in batches
+void DiskCache::EvictLocked() {
+    if (stats.bytes <= stats.max_bytes) {
+        return;
+    }
+    std::vector<std::pair<uint64_t, std::string>> by_age;
+    by_age.reserve(index.size());
+    for (const auto& entry : index) {
+        by_age.emplace_back(entry.second.last_access, entry.first);
+    }
+    std::sort(by_age.begin(), by_age.end());
+
+    const uint64_t target = stats.max_bytes / 10 * 9;
+    for (const auto& entry : by_age) {
+        if (stats.bytes <= target) {
+            break;
+        }
+        RemoveLocked(entry.second);
+        stats.evictions++;
+    }
+}
+
+// Function to change the size cap
+void DiskCache::SetMaxBytes(uint64_t max_bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.max_bytes = max_bytes;
+    if (index_loaded) {
+        EvictLocked();
+    }
+}
+
+// Function to snapshot the counters
+DiskCache::Stats DiskCache::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
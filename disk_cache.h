@@ -0,0 +1,67 @@
+#ifndef DISK_CACHE_H
+#define DISK_CACHE_H
+
+#include "mapped_file.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// HTTP validators saved with a cached response
+struct DiskCacheValidators {
+    std::string etag;
+    std::string last_modified;
+    int64_t stored_at = 0; // Unix seconds when the body was last fetched or revalidated
+};
+
+// Content-addressed on-disk cache of raw HTTP response bodies.
+// Each URL hashes to one file holding a small header (URL, validators, body size)
+// followed by the body bytes. Files are written to a temporary name and renamed into
+// place, so a crash never leaves a torn entry behind, and reads are memory-mapped so
+// the body can go straight to the decoder without a copy.
+class DiskCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t bytes = 0;
+        uint64_t max_bytes = 0;
+        size_t entries = 0;
+    };
+
+    DiskCache(const std::string& directory, uint64_t max_bytes);
+
+    DiskCache(const DiskCache&) = delete;
+    DiskCache& operator=(const DiskCache&) = delete;
+
+    // Maps the entry for url; on success body_offset is where the response body starts in file
+    bool Lookup(const std::string& url, MappedFile& file, size_t& body_offset, DiskCacheValidators& validators);
+    bool Store(const std::string& url, const char* body, size_t body_size, const DiskCacheValidators& validators);
+    void SetMaxBytes(uint64_t max_bytes);
+    Stats GetStats();
+
+private:
+    struct IndexEntry {
+        uint64_t bytes;
+        uint64_t last_access;
+    };
+
+    std::string PathFor(const std::string& key) const;
+    void LoadIndexLocked();
+    void EvictLocked();
+    void RemoveLocked(const std::string& key);
+
+    std::string directory;
+    std::mutex mutex;
+    std::unordered_map<std::string, IndexEntry> index;
+    uint64_t access_clock = 0;
+    uint64_t temp_counter = 0;
+    bool index_loaded = false;
+    Stats stats;
+};
+
+// Function to hash a URL into the cache key used for its file name
+std::string DiskCacheKey(const std::string& url);
+
+#endif // DISK_CACHE_H
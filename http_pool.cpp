@@ -0,0 +1,293 @@
+#include "http_pool.h"
+#include "net_telemetry.h"
+#include <chrono>
+#include <cstdlib>
+
+// Phase marks of the timed request running on this thread, in ms since it started, -1 until reached.
+// httplib creates the socket, connects and handshakes on the calling thread, so the client's
+// socket and TLS callbacks land here.
+struct ActiveRequest {
+    bool active = false;
+    std::chrono::steady_clock::time_point start;
+    double socket_ms = -1.0;
+    double tls_start_ms = -1.0;
+    double tls_done_ms = -1.0;
+    double first_byte_ms = -1.0;
+};
+static thread_local ActiveRequest active_request;
+
+// Function to get the time since the active request started
+static double ActiveRequestElapsedMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - active_request.start).count();
+}
+
+// Function to record a phase mark once, later calls (a TLS 1.3 session ticket, the next body chunk) keep the first
+static void MarkActiveRequest(double ActiveRequest::*mark) {
+    if (active_request.active && active_request.*mark < 0.0) {
+        active_request.*mark = ActiveRequestElapsedMs();
+    }
+}
+
+// OpenSSL info callback marking the start and end of the handshake
+static void TlsInfoCallback(const SSL*, int where, int) {
+    if (where & SSL_CB_HANDSHAKE_START) {
+        MarkActiveRequest(&ActiveRequest::tls_start_ms);
+    }
+    if (where & SSL_CB_HANDSHAKE_DONE) {
+        MarkActiveRequest(&ActiveRequest::tls_done_ms);
+    }
+}
+
+HttpClientPool::Lease::Lease(Lease&& other) noexcept
+    : pool(other.pool), host(other.host), client(std::move(other.client)) {
+    other.pool = nullptr;
+    other.host = nullptr;
+}
+
+HttpClientPool::Lease& HttpClientPool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        Release();
+        pool = other.pool;
+        host = other.host;
+        client = std::move(other.client);
+        other.pool = nullptr;
+        other.host = nullptr;
+    }
+    return *this;
+}
+
+HttpClientPool::Lease::~Lease() {
+    Release();
+}
+
+// Function to hand the client back so the next request reuses its open connection
+void HttpClientPool::Lease::Release() {
+    if (pool && client) {
+        pool->Return(host, std::move(client));
+    }
+    pool = nullptr;
+    host = nullptr;
+}
+
+HttpClientPool::HttpClientPool(int max_per_host)
+    : max_per_host(max_per_host > 0 ? max_per_host : 1) {
+}
+
+// Function to create a keep-alive client that counts the connections it opens and marks
+// the socket and handshake phases of timed requests
+std::unique_ptr<httplib::Client> HttpClientPool::CreateClient(HostPool& host) {
+    auto client = std::make_unique<httplib::Client>(host.origin);
+    client->set_keep_alive(true);
+    client->set_connection_timeout(5);
+    client->set_read_timeout(15);
+    std::atomic<uint64_t>* connects = &host.connects;
+    client->set_socket_options([connects](socket_t) {
+        connects->fetch_add(1, std::memory_order_relaxed);
+        MarkActiveRequest(&ActiveRequest::socket_ms);
+    });
+    if (SSL_CTX* ssl_context = client->ssl_context()) {
+        SSL_CTX_set_info_callback(ssl_context, TlsInfoCallback);
+    }
+    return client;
+}
+
+// Function to lease a client for an origin, waits while every slot of that origin is busy
+HttpClientPool::Lease HttpClientPool::Acquire(const std::string& origin) {
+    Lease lease;
+    std::unique_lock<std::mutex> lock(mutex);
+    auto& slot = hosts[origin];
+    if (!slot) {
+        slot = std::make_unique<HostPool>();
+        slot->origin = origin;
+    }
+    HostPool* host = slot.get();
+
+    slot_cv.wait(lock, [&] { return !host->idle.empty() || host->open_clients < max_per_host; });
+    if (!host->idle.empty()) {
+        lease.client = std::move(host->idle.back());
+        host->idle.pop_back();
+    }
+    else {
+        host->open_clients++;
+        lock.unlock();
+        lease.client = CreateClient(*host);
+        lock.lock();
+    }
+    host->requests++;
+    lease.pool = this;
+    lease.host = host;
+    return lease;
+}
+
+// Function to send a request through a leased client and record its timing.
+// The socket callback only fires for a new connection, so its absence means the request reused one.
+// Plain http has no hook between connect and the request being written, there the connect time is part of TTFB.
+httplib::Result HttpClientPool::SendTimed(const std::string& origin, const std::string& path, const char* method, bool idempotent, const SendFn& send) {
+    RequestTiming timing;
+    timing.origin = origin;
+    timing.path = path;
+    timing.method = method;
+    httplib::Progress progress = [](uint64_t, uint64_t) {
+        MarkActiveRequest(&ActiveRequest::first_byte_ms);
+        return true;
+    };
+
+    httplib::Result res;
+    double total_ms = 0.0; // Final attempt only, the phase marks are relative to its start
+    for (int attempt = 0;; ++attempt) {
+        {
+            Lease client = Acquire(origin);
+            active_request = ActiveRequest();
+            active_request.active = true;
+            active_request.start = std::chrono::steady_clock::now();
+            res = send(*client, progress);
+            total_ms = ActiveRequestElapsedMs();
+            active_request.active = false;
+        }
+        const bool retry = !res && attempt == 0 && (idempotent || res.error() == httplib::Error::Connection);
+        if (!retry) {
+            break;
+        }
+        timing.retries++;
+        timing.retry_ms += total_ms;
+    }
+
+    // Phases of the final attempt, each measured from the end of the one before it
+    const ActiveRequest& marks = active_request;
+    double phase_start_ms = 0.0;
+    timing.reused = res && marks.socket_ms < 0.0; // A failed lookup never reaches the socket either
+    if (!timing.reused) {
+        timing.dns_ms = marks.socket_ms;
+        phase_start_ms = marks.socket_ms;
+        if (marks.tls_start_ms >= 0.0) {
+            timing.connect_ms = marks.tls_start_ms - marks.socket_ms;
+            phase_start_ms = marks.tls_start_ms;
+        }
+        if (marks.tls_start_ms >= 0.0 && marks.tls_done_ms >= 0.0) {
+            timing.tls_ms = marks.tls_done_ms - marks.tls_start_ms;
+            phase_start_ms = marks.tls_done_ms;
+        }
+    }
+    if (res) {
+        const double first_byte_ms = marks.first_byte_ms >= 0.0 ? marks.first_byte_ms : total_ms; // No body
+        timing.ttfb_ms = first_byte_ms - phase_start_ms;
+        timing.transfer_ms = total_ms - first_byte_ms;
+        timing.bytes = res->body.size();
+        timing.status = res->status;
+    }
+    else {
+        timing.error = httplib::to_string(res.error());
+    }
+    timing.total_ms = timing.retry_ms + total_ms;
+    RecordRequestTiming(timing);
+    return res;
+}
+
+// Function to GET a path on an origin
+httplib::Result HttpClientPool::Get(const std::string& origin, const std::string& path, const httplib::Headers& headers) {
+    return SendTimed(origin, path, "GET", true, [&](httplib::Client& client, const httplib::Progress& progress) {
+        return client.Get(path, headers, progress);
+    });
+}
+
+// Function to POST form parameters to a path on an origin
+httplib::Result HttpClientPool::Post(const std::string& origin, const std::string& path, const httplib::Params& params) {
+    return SendTimed(origin, path, "POST", false, [&](httplib::Client& client, const httplib::Progress& progress) {
+        return client.Post(path, httplib::Headers(), params, progress);
+    });
+}
+
+// Function to take a client back, closing it if the limit was lowered meanwhile
+void HttpClientPool::Return(HostPool* host, std::unique_ptr<httplib::Client> client) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (host->open_clients > max_per_host) {
+            host->open_clients--;
+        }
+        else {
+            host->idle.push_back(std::move(client));
+        }
+    }
+    slot_cv.notify_all();
+}
+
+// Function to change how many connections each origin may keep open
+void HttpClientPool::SetMaxConnectionsPerHost(int limit) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        max_per_host = limit > 0 ? limit : 1;
+        for (auto& entry : hosts) {
+            HostPool& host = *entry.second;
+            while (host.open_clients > max_per_host && !host.idle.empty()) {
+                host.idle.pop_back();
+                host.open_clients--;
+            }
+        }
+    }
+    slot_cv.notify_all();
+}
+
+int HttpClientPool::GetMaxConnectionsPerHost() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return max_per_host;
+}
+
+// Function to snapshot per-origin counters
+std::vector<HttpClientPool::HostStats> HttpClientPool::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<HostStats> stats;
+    for (const auto& entry : hosts) {
+        const HostPool& host = *entry.second;
+        stats.push_back({ host.origin, host.open_clients, static_cast<int>(host.idle.size()),
+                          host.connects.load(std::memory_order_relaxed), host.requests });
+    }
+    return stats;
+}
+
+// Function to get the process-wide pool
+HttpClientPool& GetHttpClientPool() {
+    static HttpClientPool pool;
+    return pool;
+}
+
+static std::mutex api_origin_mutex;
+static std::string api_origin;
+
+// Function to get the Imgflip API origin
+std::string GetApiOrigin() {
+    std::lock_guard<std::mutex> lock(api_origin_mutex);
+    if (api_origin.empty()) {
+        const char* override_origin = std::getenv("MEME_API_ORIGIN");
+        api_origin = override_origin && *override_origin ? override_origin : "https://api.imgflip.com";
+    }
+    return api_origin;
+}
+
+// Function to point every API call at another server, trailing slashes are dropped
+void SetApiOrigin(const std::string& origin) {
+    std::lock_guard<std::mutex> lock(api_origin_mutex);
+    api_origin = origin;
+    while (!api_origin.empty() && api_origin.back() == '/') {
+        api_origin.pop_back();
+    }
+}
+
+// Function to split an http(s) URL into its origin and path
+bool SplitUrl(const std::string& url, std::string& origin, std::string& path) {
+    size_t scheme_end = url.find("://");
+    if (scheme_end == std::string::npos) {
+        return false;
+    }
+    std::string scheme = url.substr(0, scheme_end);
+    if (scheme != "https" && scheme != "http") {
+        return false;
+    }
+    size_t host_start = scheme_end + 3;
+    size_t pos = url.find('/', host_start);
+    if (pos == host_start) {
+        return false;
+    }
+    origin = url.substr(0, pos);
+    path = pos == std::string::npos ? "/" : url.substr(pos);
+    return true;
+}
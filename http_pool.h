@@ -0,0 +1,99 @@
+#ifndef HTTP_POOL_H
+#define HTTP_POOL_H
+
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include "httplib.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Shared pool of keep-alive HTTP(S) clients, keyed by origin ("https://api.imgflip.com").
+// Each origin holds at most max_per_host clients; a client is only ever used by the
+// thread that leased it, so the pool is safe to share between workers.
+class HttpClientPool {
+    struct HostPool;
+
+public:
+    // RAII handle on one pooled client, returned to the pool on destruction
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        ~Lease();
+
+        httplib::Client* operator->() const { return client.get(); }
+        httplib::Client& operator*() const { return *client; }
+        explicit operator bool() const { return client != nullptr; }
+
+    private:
+        friend class HttpClientPool;
+        void Release();
+
+        HttpClientPool* pool = nullptr;
+        HostPool* host = nullptr;
+        std::unique_ptr<httplib::Client> client;
+    };
+
+    struct HostStats {
+        std::string origin;
+        int open_clients;
+        int idle_clients;
+        uint64_t connects;  // New TCP (and TLS) connections, one handshake each
+        uint64_t requests;  // Leases handed out
+    };
+
+    explicit HttpClientPool(int max_per_host = 4);
+
+    HttpClientPool(const HttpClientPool&) = delete;
+    HttpClientPool& operator=(const HttpClientPool&) = delete;
+
+    Lease Acquire(const std::string& origin);
+    // Functions to run one request on a pooled client and record its phase timings in the
+    // network telemetry. A request that gets no response is retried once, a POST only when the
+    // connection itself failed so the server cannot have seen it.
+    httplib::Result Get(const std::string& origin, const std::string& path, const httplib::Headers& headers = {});
+    httplib::Result Post(const std::string& origin, const std::string& path, const httplib::Params& params);
+    void SetMaxConnectionsPerHost(int max_per_host);
+    int GetMaxConnectionsPerHost();
+    std::vector<HostStats> GetStats();
+
+private:
+    struct HostPool {
+        std::string origin;
+        std::vector<std::unique_ptr<httplib::Client>> idle;
+        int open_clients = 0;
+        std::atomic<uint64_t> connects{ 0 };
+        uint64_t requests = 0;
+    };
+
+    typedef std::function<httplib::Result(httplib::Client& client, const httplib::Progress& progress)> SendFn;
+
+    std::unique_ptr<httplib::Client> CreateClient(HostPool& host);
+    httplib::Result SendTimed(const std::string& origin, const std::string& path, const char* method, bool idempotent, const SendFn& send);
+    void Return(HostPool* host, std::unique_ptr<httplib::Client> client);
+
+    std::mutex mutex;
+    std::condition_variable slot_cv;
+    std::unordered_map<std::string, std::unique_ptr<HostPool>> hosts;
+    int max_per_host;
+};
+
+// Function to get the process-wide pool
+HttpClientPool& GetHttpClientPool();
+
+// Functions to get and change the Imgflip API origin. It starts as https://api.imgflip.com, or as the
+// MEME_API_ORIGIN environment variable when that is set, e.g. to point at tools/mock_imgflip_server.
+std::string GetApiOrigin();
+void SetApiOrigin(const std::string& origin);
+
+// Function to split an http(s) URL into its origin and path, returns false if it is not one
+bool SplitUrl(const std::string& url, std::string& origin, std::string& path);
+
+#endif // HTTP_POOL_H
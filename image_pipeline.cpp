@@ -0,0 +1,341 @@
+#include "image_pipeline.h"
+#include "http_pool.h"
+#include "image_resize.h"
+#include "profiler.h"
+#include "wake_signal.h"
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+// Include stb_image implementation
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+// Function to start the worker threads of both stages
+ImagePipeline::ImagePipeline(int network_workers, int decode_workers) {
+    for (int i = 0; i < network_workers; ++i) {
+        workers.emplace_back(&ImagePipeline::NetworkWorker, this);
+    }
+    for (int i = 0; i < decode_workers; ++i) {
+        workers.emplace_back(&ImagePipeline::DecodeWorker, this);
+    }
+}
+
+ImagePipeline::~ImagePipeline() {
+    Shutdown();
+}
+
+// Function to stop the workers, queued requests are dropped
+void ImagePipeline::Shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    fetch_cv.notify_all();
+    decode_cv.notify_all();
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers.clear();
+}
+
+// Function to queue an image for loading, returns immediately
+void ImagePipeline::Request(const ImageRequest& request) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fetch_queue.push_back(request);
+    }
+    fetch_cv.notify_one();
+}
+
+// Function to take one finished image, returns false when none is ready
+bool ImagePipeline::PopDecoded(DecodedImage& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ready_queue.empty()) {
+        return false;
+    }
+    out = std::move(ready_queue.front());
+    ready_queue.pop_front();
+    return true;
+}
+
+// Network stage: download bodies and hand them to the decoders, cached thumbnails skip decoding entirely
+void ImagePipeline::NetworkWorker() {
+    PROFILE_THREAD("image network");
+    for (;;) {
+        DownloadedImage downloaded;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            fetch_cv.wait(lock, [this] { return stopping || !fetch_queue.empty(); });
+            if (stopping) {
+                return;
+            }
+            downloaded.request = std::move(fetch_queue.front());
+            fetch_queue.pop_front();
+        }
+
+        DecodedImage thumbnail;
+        if (downloaded.request.max_size > 0 && LoadCachedThumbnail(downloaded.request, thumbnail)) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ready_queue.push_back(std::move(thumbnail));
+            }
+            WakeRenderLoop();
+            continue;
+        }
+
+        downloaded.failed = !FetchImageBytes(downloaded.request.url, downloaded.bytes);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            decode_queue.push_back(std::move(downloaded));
+        }
+        decode_cv.notify_one();
+    }
+}
+
+// Function to pull every other queued request for url out of both queues, they will share one decode
+void ImagePipeline::TakeRequestsForUrlLocked(const std::string& url, std::vector<ImageRequest>& requests) {
+    for (auto it = fetch_queue.begin(); it != fetch_queue.end();) {
+        if (it->url == url) {
+            requests.push_back(std::move(*it));
+            it = fetch_queue.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    for (auto it = decode_queue.begin(); it != decode_queue.end();) {
+        if (it->request.url == url) {
+            requests.push_back(std::move(it->request));
+            it = decode_queue.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+// Decode stage: turn downloaded bytes into RGBA8 pixels, then cut every size that was asked for out of
+// one decode: full images get a mip chain, thumbnails are shrunk from it and cached
+void ImagePipeline::DecodeWorker() {
+    PROFILE_THREAD("image decode");
+    for (;;) {
+        DownloadedImage downloaded;
+        std::vector<ImageRequest> requests;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            decode_cv.wait(lock, [this] { return stopping || !decode_queue.empty(); });
+            if (stopping) {
+                return;
+            }
+            downloaded = std::move(decode_queue.front());
+            decode_queue.pop_front();
+            requests.push_back(downloaded.request);
+            TakeRequestsForUrlLocked(downloaded.request.url, requests);
+        }
+
+        // Thumbnails first, so the full image can take the decoded pixels without a copy
+        std::stable_partition(requests.begin(), requests.end(), [](const ImageRequest& request) { return request.max_size > 0; });
+        const bool wants_full = requests.back().max_size == 0;
+
+        DecodedImage source;
+        const bool decoded = !downloaded.failed && DecodeImage(downloaded.bytes.Data(), downloaded.bytes.Size(), source);
+        if (decoded && wants_full) {
+            BuildMipChain(source);
+        }
+
+        std::vector<DecodedImage> results(requests.size());
+        for (size_t i = 0; i < requests.size(); ++i) {
+            DecodedImage& image = results[i];
+            if (decoded && requests[i].max_size > 0) {
+                MakeThumbnail(source, requests[i].max_size, image);
+            }
+            else if (decoded) {
+                image = i + 1 == requests.size() ? std::move(source) : source;
+            }
+            image.key = std::move(requests[i].key);
+            image.url = std::move(requests[i].url);
+            image.thumbnail = requests[i].max_size > 0;
+            image.failed = !decoded;
+            if (decoded && image.thumbnail) {
+                StoreThumbnail(image);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (DecodedImage& image : results) {
+                ready_queue.push_back(std::move(image));
+            }
+        }
+        WakeRenderLoop();
+    }
+}
+
+// Function to get the cache key of an image at a size
+std::string ImageCacheKey(const std::string& url, int max_size) {
+    return max_size > 0 ? "thumb" + std::to_string(max_size) + ":" + url : url;
+}
+
+// Function to get the shared on-disk cache of downloaded images and decoded thumbnails
+DiskCache& GetImageDiskCache() {
+    static DiskCache cache("image_cache", 512ull * 1024 * 1024);
+    return cache;
+}
+
+// Cached images younger than this are used without asking the server
+static const int64_t image_cache_fresh_seconds = 7 * 24 * 60 * 60;
+
+// Function to append the mip chain of a decoded image, each level a 2x2 box filter of the one above
+void BuildMipChain(DecodedImage& image) {
+    PROFILE_SCOPE("Build mip chain");
+    image.mips.clear();
+    int width = image.width;
+    int height = image.height;
+    size_t offset = 0;
+    for (;;) {
+        image.mips.push_back({ width, height, offset });
+        offset += static_cast<size_t>(width) * height * 4;
+        if (width == 1 && height == 1) {
+            break;
+        }
+        width = HalvedSize(width);
+        height = HalvedSize(height);
+    }
+    image.pixels.resize(offset);
+    for (size_t level = 1; level < image.mips.size(); ++level) {
+        const MipLevel& above = image.mips[level - 1];
+        const MipLevel& current = image.mips[level];
+        HalveRGBA(image.pixels.data() + current.offset, static_cast<size_t>(current.width) * 4,
+            image.pixels.data() + above.offset, static_cast<size_t>(above.width) * 4, above.width, above.height);
+    }
+}
+
+// Function to shrink a decoded image to fit within max_size x max_size
+void MakeThumbnail(const DecodedImage& source, int max_size, DecodedImage& out) {
+    PROFILE_SCOPE("Make thumbnail");
+    MipLevel start = { source.width, source.height, 0 };
+    for (const MipLevel& level : source.mips) {
+        if (level.width < max_size && level.height < max_size) {
+            break;
+        }
+        start = level;
+    }
+    DownsampleRGBA(source.pixels.data() + start.offset, start.width, start.height, max_size, out.pixels, out.width, out.height);
+    out.mips.clear();
+}
+
+// Thumbnail entries hold the raw RGBA8 pixels after two uint32 dimensions, so a hit needs no decode at all
+static const size_t thumbnail_prefix_size = 8;
+
+// Function to load a thumbnail decoded on an earlier run, returns false if it is missing or stale
+bool LoadCachedThumbnail(const ImageRequest& request, DecodedImage& out) {
+    PROFILE_SCOPE("Load cached thumbnail");
+    MappedFile file;
+    size_t offset = 0;
+    DiskCacheValidators validators;
+    if (!GetImageDiskCache().Lookup(request.key, file, offset, validators) ||
+        static_cast<int64_t>(std::time(nullptr)) - validators.stored_at >= image_cache_fresh_seconds ||
+        file.Size() - offset < thumbnail_prefix_size) {
+        return false;
+    }
+    uint32_t width, height;
+    memcpy(&width, file.Data() + offset, 4);
+    memcpy(&height, file.Data() + offset + 4, 4);
+    const unsigned char* pixels = file.Data() + offset + thumbnail_prefix_size;
+    if (width == 0 || height == 0 || width > static_cast<uint32_t>(request.max_size) || height > static_cast<uint32_t>(request.max_size) ||
+        file.Size() - offset - thumbnail_prefix_size != static_cast<size_t>(width) * height * 4) {
+        return false;
+    }
+    out.key = request.key;
+    out.url = request.url;
+    out.width = static_cast<int>(width);
+    out.height = static_cast<int>(height);
+    out.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+    out.thumbnail = true;
+    out.failed = false;
+    return true;
+}
+
+// Function to save a thumbnail under its own key, next to the encoded original
+void StoreThumbnail(const DecodedImage& image) {
+    PROFILE_SCOPE("Store thumbnail");
+    std::string body(thumbnail_prefix_size + image.pixels.size(), '\0');
+    const uint32_t width = static_cast<uint32_t>(image.width);
+    const uint32_t height = static_cast<uint32_t>(image.height);
+    memcpy(&body[0], &width, 4);
+    memcpy(&body[4], &height, 4);
+    memcpy(&body[thumbnail_prefix_size], image.pixels.data(), image.pixels.size());
+    DiskCacheValidators validators;
+    validators.stored_at = static_cast<int64_t>(std::time(nullptr));
+    GetImageDiskCache().Store(image.key, body.data(), body.size(), validators);
+}
+
+// Function to get the encoded bytes of an image, from the disk cache when possible.
+// Stale entries are revalidated with If-None-Match / If-Modified-Since and still used if the server is unreachable.
+// file:// URLs, such as locally rendered memes, are mapped straight from their path and never cached.
+bool FetchImageBytes(const std::string& url, ImageBytes& out) {
+    PROFILE_SCOPE("Fetch image");
+    if (url.compare(0, 7, "file://") == 0) {
+        return out.mapped.Open(url.substr(7));
+    }
+    DiskCache& cache = GetImageDiskCache();
+    DiskCacheValidators validators;
+    const int64_t now = static_cast<int64_t>(std::time(nullptr));
+    bool cached = cache.Lookup(url, out.mapped, out.mapped_offset, validators);
+    if (cached && now - validators.stored_at < image_cache_fresh_seconds) {
+        return true;
+    }
+
+    std::string origin, path;
+    if (!SplitUrl(url, origin, path)) {
+        return cached;
+    }
+    httplib::Headers headers;
+    if (cached && !validators.etag.empty()) {
+        headers.emplace("If-None-Match", validators.etag);
+    }
+    if (cached && !validators.last_modified.empty()) {
+        headers.emplace("If-Modified-Since", validators.last_modified);
+    }
+
+    auto res = GetHttpClientPool().Get(origin, path, headers);
+    if (!res || (res->status != 200 && res->status != 304)) {
+        return cached;
+    }
+
+    if (res->status == 304 && cached) {
+        // Still current: rewrite the entry with a fresh timestamp, the body moves into memory
+        // first because the mapped file is about to be replaced
+        out.body.assign(reinterpret_cast<const char*>(out.Data()), out.Size());
+        out.mapped.Close();
+    }
+    else {
+        out.mapped.Close();
+        out.body = std::move(res->body);
+        validators.etag = res->get_header_value("ETag");
+        validators.last_modified = res->get_header_value("Last-Modified");
+    }
+    validators.stored_at = now;
+    cache.Store(url, out.body.data(), out.body.size(), validators);
+    return true;
+}
+
+// Function to decode an encoded image into RGBA8 pixels
+bool DecodeImage(const unsigned char* data, size_t size, DecodedImage& out) {
+    PROFILE_SCOPE("Decode image");
+    int image_width, image_height, channels;
+    unsigned char* image_data = stbi_load_from_memory(data, static_cast<int>(size), &image_width, &image_height, &channels, STBI_rgb_alpha);
+    if (!image_data) {
+        return false;
+    }
+    out.width = image_width;
+    out.height = image_height;
+    out.mips.clear();
+    out.pixels.assign(image_data, image_data + static_cast<size_t>(image_width) * image_height * 4);
+    stbi_image_free(image_data);
+    return true;
+}
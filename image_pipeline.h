@@ -0,0 +1,113 @@
+#ifndef IMAGE_PIPELINE_H
+#define IMAGE_PIPELINE_H
+
+#include "disk_cache.h"
+#include "mapped_file.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum ImageLoadState {
+    ImageLoadState_Loading,
+    ImageLoadState_Ready,
+    ImageLoadState_Failed,
+};
+
+// One image to load. Thumbnails (max_size > 0) are shrunk right after decoding and are
+// cached on disk and in the texture cache under their own key, apart from the full image.
+struct ImageRequest {
+    std::string key; // ImageCacheKey(url, max_size)
+    std::string url;
+    int max_size = 0; // Longest side in pixels, 0 for the full image
+};
+
+// One level of a mip chain, stored at offset bytes into DecodedImage::pixels
+struct MipLevel {
+    int width;
+    int height;
+    size_t offset;
+};
+
+// RGBA8 pixels produced by the decode stage, waiting to be uploaded by the render thread.
+// Full images carry their whole mip chain back to back in pixels, level 0 first.
+struct DecodedImage {
+    std::string key;
+    std::string url;
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+    std::vector<MipLevel> mips; // Empty for a single level
+    bool thumbnail = false; // Requested with max_size > 0
+    bool failed = false;
+};
+
+// Encoded image bytes, either downloaded into memory or mapped straight from the disk cache
+struct ImageBytes {
+    std::string body;
+    MappedFile mapped;
+    size_t mapped_offset = 0;
+
+    const unsigned char* Data() const {
+        return mapped.IsOpen() ? mapped.Data() + mapped_offset : reinterpret_cast<const unsigned char*>(body.data());
+    }
+    size_t Size() const { return mapped.IsOpen() ? mapped.Size() - mapped_offset : body.size(); }
+};
+
+// Staged image loader: network workers download, decode workers run stb_image,
+// and the render thread drains the finished images with PopDecoded() at its own pace.
+// Nothing in here touches the GPU, so no stage can stall the UI thread. A decode serves
+// every queued request for the same URL, so a thumbnail and the full image share it.
+class ImagePipeline {
+public:
+    ImagePipeline(int network_workers, int decode_workers);
+    ~ImagePipeline();
+
+    ImagePipeline(const ImagePipeline&) = delete;
+    ImagePipeline& operator=(const ImagePipeline&) = delete;
+
+    void Request(const ImageRequest& request);
+    bool PopDecoded(DecodedImage& out);
+    void Shutdown();
+
+private:
+    struct DownloadedImage {
+        ImageRequest request;
+        ImageBytes bytes;
+        bool failed = false;
+    };
+
+    void NetworkWorker();
+    void DecodeWorker();
+    void TakeRequestsForUrlLocked(const std::string& url, std::vector<ImageRequest>& requests);
+
+    std::mutex mutex;
+    std::condition_variable fetch_cv;
+    std::condition_variable decode_cv;
+    std::deque<ImageRequest> fetch_queue;
+    std::deque<DownloadedImage> decode_queue;
+    std::deque<DecodedImage> ready_queue;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+};
+
+// Function to get the cache key of an image at a size, the URL itself for the full image
+std::string ImageCacheKey(const std::string& url, int max_size);
+// Function to get the shared on-disk cache of downloaded images and decoded thumbnails
+DiskCache& GetImageDiskCache();
+// Function to get the encoded bytes of an image, from the disk cache when possible, returns false if neither has it
+bool FetchImageBytes(const std::string& url, ImageBytes& out);
+// Function to decode an encoded image into RGBA8 pixels
+bool DecodeImage(const unsigned char* data, size_t size, DecodedImage& out);
+// Function to append the mip chain of a decoded image, down to 1x1, to its pixels
+void BuildMipChain(DecodedImage& image);
+// Function to shrink a decoded image to fit within max_size x max_size, keeping its aspect ratio.
+// Starts from the smallest mip level that still covers the target when source has a chain.
+void MakeThumbnail(const DecodedImage& source, int max_size, DecodedImage& out);
+// Functions to keep decoded thumbnails in the disk cache under their request key
+bool LoadCachedThumbnail(const ImageRequest& request, DecodedImage& out);
+void StoreThumbnail(const DecodedImage& image);
+
+#endif // IMAGE_PIPELINE_H
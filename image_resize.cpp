@@ -0,0 +1,197 @@
+#include "image_resize.h"
+#include "pixel_convert.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define IMAGE_RESIZE_X86 1
+#include <emmintrin.h>
+#else
+#define IMAGE_RESIZE_X86 0
+#endif
+
+// Function to average dst pixels [begin, end) of one output row from two source rows
+static inline void HalveRowScalar(unsigned char* dst, const unsigned char* row0, const unsigned char* row1, int src_width, int begin, int end) {
+    for (int x = begin; x < end; ++x) {
+        const int x0 = 2 * x;
+        const int x1 = std::min(x0 + 1, src_width - 1);
+        for (int c = 0; c < 4; ++c) {
+            unsigned sum = row0[4 * x0 + c] + row0[4 * x1 + c] + row1[4 * x0 + c] + row1[4 * x1 + c];
+            dst[4 * x + c] = static_cast<unsigned char>((sum + 2) >> 2);
+        }
+    }
+}
+
+void HalveRGBA_Scalar(unsigned char* dst, size_t dst_pitch, const unsigned char* src, size_t src_pitch, int src_width, int src_height) {
+    const int dst_width = HalvedSize(src_width);
+    const int dst_height = HalvedSize(src_height);
+    for (int y = 0; y < dst_height; ++y) {
+        const unsigned char* row0 = src + 2 * y * src_pitch;
+        const unsigned char* row1 = src_height > 1 ? row0 + src_pitch : row0;
+        HalveRowScalar(dst, row0, row1, src_width, 0, dst_width);
+        dst += dst_pitch;
+    }
+}
+
+#if IMAGE_RESIZE_X86
+
+// Function to sum 4 source pixels from each row into 2 output pixels as 16-bit lanes, rounded and shifted
+static inline __m128i HalveChunkSSE2(const unsigned char* row0, const unsigned char* row1) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1));
+    __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)); // Pixels 0 and 1
+    __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)); // Pixels 2 and 3
+    lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+    hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+    __m128i sum = _mm_unpacklo_epi64(lo, hi);
+    return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+}
+
+// Vertical pairs are added in 16-bit lanes, then each horizontal pair is folded with a byte shift
+void HalveRGBA_SSE2(unsigned char* dst, size_t dst_pitch, const unsigned char* src, size_t src_pitch, int src_width, int src_height) {
+    const int dst_width = HalvedSize(src_width);
+    const int dst_height = HalvedSize(src_height);
+    // Whole chunks never read past the last full source pair, the odd column is left to the scalar tail
+    const int pairs = src_width / 2;
+    for (int y = 0; y < dst_height; ++y) {
+        const unsigned char* row0 = src + 2 * y * src_pitch;
+        const unsigned char* row1 = src_height > 1 ? row0 + src_pitch : row0;
+        int x = 0;
+        for (; x + 4 <= pairs; x += 4) {
+            __m128i first = HalveChunkSSE2(row0 + 8 * x, row1 + 8 * x);
+            __m128i second = HalveChunkSSE2(row0 + 8 * x + 16, row1 + 8 * x + 16);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * x), _mm_packus_epi16(first, second));
+        }
+        HalveRowScalar(dst, row0, row1, src_width, x, dst_width);
+        dst += dst_pitch;
+    }
+}
+
+#else // !IMAGE_RESIZE_X86
+
+void HalveRGBA_SSE2(unsigned char* dst, size_t dst_pitch, const unsigned char* src, size_t src_pitch, int src_width, int src_height) {
+    HalveRGBA_Scalar(dst, dst_pitch, src, src_pitch, src_width, src_height);
+}
+
+#endif // IMAGE_RESIZE_X86
+
+void HalveRGBA(unsigned char* dst, size_t dst_pitch, const unsigned char* src, size_t src_pitch, int src_width, int src_height) {
+    static const HalveFn kernel = CpuHasSSE2() ? HalveRGBA_SSE2 : HalveRGBA_Scalar;
+    kernel(dst, dst_pitch, src, src_pitch, src_width, src_height);
+}
+
+// Source pixels covered by one output column or row. Weights are in 1/dst_size source pixels,
+// so the weights of one output always add up to src_size.
+struct AreaSpan {
+    int first;
+    int last;
+    unsigned first_weight;
+    unsigned last_weight;
+};
+
+// Function to get the weight of source pixel index inside span, pixels between the ends are fully covered
+static inline unsigned SpanWeight(const AreaSpan& span, int index, int dst_size) {
+    if (index == span.first) {
+        return span.first_weight;
+    }
+    return index == span.last ? span.last_weight : static_cast<unsigned>(dst_size);
+}
+
+// Function to compute the span of every output column or row
+static std::vector<AreaSpan> BuildAreaSpans(int src_size, int dst_size) {
+    std::vector<AreaSpan> spans(dst_size);
+    for (int i = 0; i < dst_size; ++i) {
+        const unsigned begin = static_cast<unsigned>(i) * src_size; // In 1/dst_size source pixels
+        const unsigned end = begin + src_size;
+        AreaSpan& span = spans[i];
+        span.first = static_cast<int>(begin / dst_size);
+        span.last = static_cast<int>((end - 1) / dst_size);
+        if (span.first == span.last) {
+            span.first_weight = src_size;
+            span.last_weight = 0;
+        }
+        else {
+            span.first_weight = (span.first + 1) * dst_size - begin;
+            span.last_weight = end - span.last * dst_size;
+        }
+    }
+    return spans;
+}
+
+void ResizeRGBAArea(unsigned char* dst, int dst_width, int dst_height, const unsigned char* src, size_t src_pitch, int src_width, int src_height) {
+    const std::vector<AreaSpan> columns = BuildAreaSpans(src_width, dst_width);
+    const std::vector<AreaSpan> rows = BuildAreaSpans(src_height, dst_height);
+    const double scale = 1.0 / (static_cast<double>(src_width) * src_height);
+
+    // Horizontal pass into one row of weighted sums, then accumulate rows with their vertical weights
+    std::vector<unsigned> row_sums(static_cast<size_t>(dst_width) * 4);
+    std::vector<double> accum(static_cast<size_t>(dst_width) * 4);
+    for (int y = 0; y < dst_height; ++y) {
+        const AreaSpan& vertical = rows[y];
+        std::fill(accum.begin(), accum.end(), 0.0);
+        for (int sy = vertical.first; sy <= vertical.last; ++sy) {
+            const unsigned row_weight = SpanWeight(vertical, sy, dst_height);
+            const unsigned char* line = src + sy * src_pitch;
+            for (int x = 0; x < dst_width; ++x) {
+                const AreaSpan& horizontal = columns[x];
+                for (int c = 0; c < 4; ++c) {
+                    unsigned sum = 0;
+                    for (int sx = horizontal.first; sx <= horizontal.last; ++sx) {
+                        sum += line[4 * sx + c] * SpanWeight(horizontal, sx, dst_width);
+                    }
+                    row_sums[4 * x + c] = sum;
+                }
+            }
+            for (size_t i = 0; i < accum.size(); ++i) {
+                accum[i] += static_cast<double>(row_sums[i]) * row_weight;
+            }
+        }
+        unsigned char* out = dst + static_cast<size_t>(y) * dst_width * 4;
+        for (size_t i = 0; i < accum.size(); ++i) {
+            out[i] = static_cast<unsigned char>(std::min(255.0, accum[i] * scale + 0.5));
+        }
+    }
+}
+
+void DownsampleRGBA(const unsigned char* src, int src_width, int src_height, int max_size,
+    std::vector<unsigned char>& out, int& out_width, int& out_height) {
+    int target_width = src_width;
+    int target_height = src_height;
+    if (src_width > max_size || src_height > max_size) {
+        if (src_width >= src_height) {
+            target_width = max_size;
+            target_height = std::max(1, static_cast<int>((static_cast<long long>(src_height) * max_size + src_width / 2) / src_width));
+        }
+        else {
+            target_height = max_size;
+            target_width = std::max(1, static_cast<int>((static_cast<long long>(src_width) * max_size + src_height / 2) / src_height));
+        }
+    }
+
+    // Halve between two scratch buffers while the next level still covers the target
+    std::vector<unsigned char> levels[2];
+    const unsigned char* current = src;
+    int width = src_width;
+    int height = src_height;
+    int flip = 0;
+    while (width / 2 >= target_width && height / 2 >= target_height && width > 1 && height > 1) {
+        std::vector<unsigned char>& next = levels[flip];
+        next.resize(static_cast<size_t>(HalvedSize(width)) * HalvedSize(height) * 4);
+        HalveRGBA(next.data(), static_cast<size_t>(HalvedSize(width)) * 4, current, static_cast<size_t>(width) * 4, width, height);
+        current = next.data();
+        width = HalvedSize(width);
+        height = HalvedSize(height);
+        flip ^= 1;
+    }
+
+    out.resize(static_cast<size_t>(target_width) * target_height * 4);
+    if (width == target_width && height == target_height) {
+        memcpy(out.data(), current, out.size());
+    }
+    else {
+        ResizeRGBAArea(out.data(), target_width, target_height, current, static_cast<size_t>(width) * 4, width, height);
+    }
+    out_width = target_width;
+    out_height = target_height;
+}
@@ -0,0 +1,32 @@
+#ifndef IMAGE_RESIZE_H
+#define IMAGE_RESIZE_H
+
+#include <cstddef>
+#include <vector>
+
+// 2x2 box filter kernels on RGBA8 rows: each destination pixel is the rounded mean of
+// the four source pixels under it. The destination is HalvedSize() of the source in
+// each direction: a trailing odd row or column is dropped, and a dimension that is
+// already 1 pixel stays 1 by reading the same row or column twice.
+typedef void (*HalveFn)(unsigned char* dst, size_t dst_pitch, const unsigned char* src, size_t src_pitch, int src_width, int src_height);
+
+void HalveRGBA_Scalar(unsigned char* dst, size_t dst_pitch, const unsigned char* src, size_t src_pitch, int src_width, int src_height);
+void HalveRGBA_SSE2(unsigned char* dst, size_t dst_pitch, const unsigned char* src, size_t src_pitch, int src_width, int src_height);
+
+// Function to get one dimension after halving, never below 1
+inline int HalvedSize(int size) { return size > 1 ? size / 2 : 1; }
+
+// Function to halve with the fastest kernel the CPU supports
+void HalveRGBA(unsigned char* dst, size_t dst_pitch, const unsigned char* src, size_t src_pitch, int src_width, int src_height);
+
+// Function to resample to any smaller size with an exact area (box) filter, scalar.
+// Used for the last, non power-of-two step after HalveRGBA has done the bulk of the work.
+void ResizeRGBAArea(unsigned char* dst, int dst_width, int dst_height, const unsigned char* src, size_t src_pitch, int src_width, int src_height);
+
+// Function to shrink an image to fit within max_size x max_size, keeping its aspect ratio.
+// Halves with the SIMD kernel while that stays above the target, then finishes with the area filter.
+// Images that already fit are copied unchanged.
+void DownsampleRGBA(const unsigned char* src, int src_width, int src_height, int max_size,
+    std::vector<unsigned char>& out, int& out_width, int& out_height);
+
+#endif // IMAGE_RESIZE_H
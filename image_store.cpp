@@ -0,0 +1,328 @@
+#include "image_store.h"
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+ImageStore::ImageStore(TextureSink& sink, size_t texture_budget, size_t thumbnail_budget, int atlas_page_size, int atlas_max_pages)
+    : sink(sink),
+      thumbnail_atlas(atlas_page_size, atlas_max_pages),
+      texture_cache(texture_budget, [this](void* texture) { this->sink.ReleaseTexture(texture); }),
+      thumbnail_cache(thumbnail_budget, [this](void* image) {
+          AtlasImage* atlas_image = static_cast<AtlasImage*>(image);
+          if (atlas_image->region.page >= 0) {
+              thumbnail_atlas.Free(atlas_image->region);
+          }
+          else {
+              this->sink.ReleaseTexture(atlas_image->texture);
+          }
+          delete atlas_image;
+      }) {
+}
+
+ImageStore::~ImageStore() {
+    Stop();
+}
+
+// Function to start the background loaders and create the placeholder texture
+void ImageStore::Start(int network_workers, int decode_workers) {
+    if (pipeline) {
+        return;
+    }
+    pipeline = std::make_unique<ImagePipeline>(network_workers, decode_workers);
+
+    unsigned char grey[4] = { 200, 200, 200, 255 };
+    placeholder_texture = sink.CreateTexture(1, 1, 1);
+    if (placeholder_texture && !sink.WriteRegion(placeholder_texture, 0, 0, 0, 1, 1, grey, 4)) {
+        sink.ReleaseTexture(placeholder_texture);
+        placeholder_texture = nullptr;
+    }
+}
+
+// Function to stop the background loaders and release every texture
+void ImageStore::Stop() {
+    pipeline.reset();
+
+    for (UploadJob& job : upload_queue) {
+        if (job.texture) {
+            sink.ReleaseTexture(job.texture);
+        }
+    }
+    upload_queue.clear();
+    texture_cache.Clear();
+    thumbnail_cache.Clear();
+    for (void* page : atlas_pages) {
+        sink.ReleaseTexture(page);
+    }
+    atlas_pages.clear();
+    thumbnail_atlas.Clear();
+    if (placeholder_texture) {
+        sink.ReleaseTexture(placeholder_texture);
+        placeholder_texture = nullptr;
+    }
+}
+
+// Function to start a new frame for the texture caches, textures touched from here on are pinned
+void ImageStore::BeginFrame() {
+    texture_cache.BeginFrame(++frame);
+    thumbnail_cache.BeginFrame(frame);
+}
+
+// Function to change how much texture memory the full image cache may hold
+void ImageStore::SetTextureBudget(size_t budget_bytes) {
+    texture_cache.SetBudget(budget_bytes);
+}
+
+// Function to copy a thumbnail into its atlas region, extruding the edge pixels into the 1-pixel border
+bool ImageStore::WriteAtlasRegion(void* page, const AtlasRegion& region, const DecodedImage& image) {
+    const int width = image.width;
+    const int height = image.height;
+    std::vector<unsigned char> padded(static_cast<size_t>(region.width) * region.height * 4);
+    const size_t src_row = static_cast<size_t>(width) * 4;
+    const size_t padded_row = static_cast<size_t>(region.width) * 4;
+    for (int y = 0; y < region.height; ++y) {
+        const unsigned char* src = image.pixels.data() + std::min(std::max(y - 1, 0), height - 1) * src_row;
+        unsigned char* dst = padded.data() + y * padded_row;
+        memcpy(dst, src, 4);
+        memcpy(dst + 4, src, src_row);
+        memcpy(dst + 4 + src_row, src + src_row - 4, 4);
+    }
+    return sink.WriteRegion(page, 0, region.x, region.y, region.width, region.height, padded.data(), padded_row);
+}
+
+// Function to empty the atlas page that is cheapest to give up, so the packer resets it.
+// A page only resets once every region in it is freed, so this evicts all thumbnails on the
+// page with the fewest of them, skipping pages that have one on screen.
+// Returns false if every page has a pinned thumbnail.
+bool ImageStore::ReclaimAtlasPage() {
+    struct PageUse {
+        int thumbnails = 0;
+        bool pinned = false;
+    };
+    std::vector<PageUse> pages(atlas_pages.size());
+    thumbnail_cache.ForEach([&](const TextureCacheEntry& entry) {
+        const AtlasImage* atlas_image = static_cast<const AtlasImage*>(entry.texture);
+        if (!atlas_image || atlas_image->region.page < 0 || atlas_image->region.page >= static_cast<int>(pages.size())) {
+            return;
+        }
+        PageUse& use = pages[atlas_image->region.page];
+        use.thumbnails++;
+        use.pinned |= thumbnail_cache.IsPinned(entry);
+    });
+
+    int victim = -1;
+    for (int page = 0; page < static_cast<int>(pages.size()); ++page) {
+        if (!pages[page].pinned && pages[page].thumbnails > 0 && (victim < 0 || pages[page].thumbnails < pages[victim].thumbnails)) {
+            victim = page;
+        }
+    }
+    if (victim < 0) {
+        return false;
+    }
+    thumbnail_cache.EvictIf([victim](const TextureCacheEntry& entry) {
+        return static_cast<const AtlasImage*>(entry.texture)->region.page == victim;
+    });
+    return true;
+}
+
+// Function to place a decoded thumbnail in the atlas, opening a page texture if the packer asks for one.
+// When every page is full the least used page is emptied for it, and only if all of them
+// are on screen does the thumbnail fall back to a standalone texture.
+ImageStore::AtlasImage* ImageStore::UploadThumbnail(const DecodedImage& image) {
+    AtlasImage* atlas_image = new AtlasImage();
+    AtlasRegion& region = atlas_image->region;
+    bool allocated = thumbnail_atlas.Allocate(image.width, image.height, region);
+    if (!allocated && ReclaimAtlasPage()) {
+        allocated = thumbnail_atlas.Allocate(image.width, image.height, region);
+    }
+    if (allocated) {
+        if (region.page == static_cast<int>(atlas_pages.size())) {
+            const int page_size = thumbnail_atlas.PageSize();
+            if (void* page = sink.CreateTexture(page_size, page_size, 1)) {
+                atlas_pages.push_back(page);
+            }
+        }
+        if (region.page < static_cast<int>(atlas_pages.size()) && WriteAtlasRegion(atlas_pages[region.page], region, image)) {
+            const float texel = 1.0f / thumbnail_atlas.PageSize();
+            atlas_image->texture = atlas_pages[region.page];
+            atlas_image->uv0[0] = (region.x + 1) * texel;
+            atlas_image->uv0[1] = (region.y + 1) * texel;
+            atlas_image->uv1[0] = (region.x + 1 + image.width) * texel;
+            atlas_image->uv1[1] = (region.y + 1 + image.height) * texel;
+            return atlas_image;
+        }
+        thumbnail_atlas.Free(region);
+        region = AtlasRegion();
+    }
+
+    atlas_image->texture = CreateTextureFromImage(sink, image);
+    if (!atlas_image->texture) {
+        delete atlas_image;
+        return nullptr;
+    }
+    return atlas_image;
+}
+
+// Function to finish a job: hand the texture to its cache, or mark the entry failed
+void ImageStore::CompleteUpload(UploadJob& job, bool ok) {
+    if (job.image.thumbnail) {
+        AtlasImage* atlas_image = ok ? UploadThumbnail(job.image) : nullptr;
+        if (atlas_image) {
+            thumbnail_cache.SetReady(job.image.key, atlas_image, job.image.pixels.size());
+        }
+        else {
+            thumbnail_cache.SetFailed(job.image.key);
+        }
+        return;
+    }
+    if (ok) {
+        texture_cache.SetReady(job.image.key, job.texture, job.image.pixels.size());
+    }
+    else {
+        if (job.texture) {
+            sink.ReleaseTexture(job.texture);
+        }
+        texture_cache.SetFailed(job.image.key);
+    }
+    job.texture = nullptr;
+}
+
+// Function to move one job forward by at most byte_allowance bytes (but always at least one row).
+// Returns the bytes written; job.done is set once it has been handed to its cache.
+size_t ImageStore::RunUploadBand(UploadJob& job, size_t byte_allowance) {
+    const DecodedImage& image = job.image;
+    if (image.failed) {
+        CompleteUpload(job, false);
+        job.done = true;
+        return 0;
+    }
+    if (image.thumbnail) {
+        // Thumbnails are small enough to always go in one piece
+        CompleteUpload(job, true);
+        job.done = true;
+        return image.pixels.size();
+    }
+
+    if (!job.texture) {
+        const int levels = image.mips.empty() ? 1 : static_cast<int>(image.mips.size());
+        job.texture = sink.CreateTexture(image.width, image.height, levels);
+        if (!job.texture) {
+            CompleteUpload(job, false);
+            job.done = true;
+            return 0;
+        }
+    }
+
+    const MipLevel mip = image.mips.empty() ? MipLevel{ image.width, image.height, 0 } : image.mips[job.level];
+    const size_t row_bytes = static_cast<size_t>(mip.width) * 4;
+    const int rows = static_cast<int>(std::min<size_t>(std::max<size_t>(byte_allowance / row_bytes, 1), static_cast<size_t>(mip.height - job.next_row)));
+    const unsigned char* band = image.pixels.data() + mip.offset + job.next_row * row_bytes;
+    if (!sink.WriteRegion(job.texture, static_cast<int>(job.level), 0, job.next_row, mip.width, rows, band, row_bytes)) {
+        CompleteUpload(job, false);
+        job.done = true;
+        return 0;
+    }
+    job.next_row += rows;
+    if (job.next_row == mip.height) {
+        job.next_row = 0;
+        job.level++;
+        if (job.level >= std::max<size_t>(image.mips.size(), 1)) {
+            CompleteUpload(job, true);
+            job.done = true;
+        }
+    }
+    return rows * row_bytes;
+}
+
+// Function to upload decoded images within a per-frame budget, called once per frame.
+// Everything that finished decoding joins the queue, which is ranked by how recently each image was asked
+// for, so rows on screen go before ones that scrolled away. Large images go up in row bands across frames.
+void ImageStore::UploadDecoded(const UploadBudget& budget) {
+    PROFILE_SCOPE("Texture uploads");
+    if (!pipeline) {
+        return;
+    }
+    DecodedImage image;
+    while (pipeline->PopDecoded(image)) {
+        UploadJob job;
+        job.image = std::move(image);
+        upload_queue.push_back(std::move(job));
+    }
+
+    // Drop jobs nobody is waiting for any more and rank the rest, most recently wanted first
+    for (UploadJob& job : upload_queue) {
+        const TextureCacheEntry* entry = (job.image.thumbnail ? thumbnail_cache : texture_cache).Lookup(job.image.key);
+        job.wanted_frame = entry ? entry->last_used_frame : 0;
+        if (!entry && job.texture) {
+            sink.ReleaseTexture(job.texture);
+            job.texture = nullptr;
+        }
+        job.done = entry == nullptr;
+    }
+    upload_queue.erase(std::remove_if(upload_queue.begin(), upload_queue.end(), [](const UploadJob& job) { return job.done; }), upload_queue.end());
+    std::stable_sort(upload_queue.begin(), upload_queue.end(), [](const UploadJob& a, const UploadJob& b) { return a.wanted_frame > b.wanted_frame; });
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto deadline = start + std::chrono::microseconds(budget.microseconds);
+    size_t bytes = 0;
+    for (UploadJob& job : upload_queue) {
+        while (!job.done && bytes < budget.bytes && std::chrono::steady_clock::now() < deadline) {
+            bytes += RunUploadBand(job, budget.bytes - bytes);
+        }
+        if (bytes >= budget.bytes || std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+    }
+    upload_queue.erase(std::remove_if(upload_queue.begin(), upload_queue.end(), [](const UploadJob& job) { return job.done; }), upload_queue.end());
+
+    upload_stats.pending = upload_queue.size();
+    upload_stats.last_frame_bytes = bytes;
+    upload_stats.last_frame_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    upload_stats.max_frame_ms = std::max(upload_stats.max_frame_ms, upload_stats.last_frame_ms);
+}
+
+// Function to look up the cache entry for a request, queueing it for loading if necessary
+TextureCacheEntry* ImageStore::AcquireEntry(TextureCache& cache, const ImageRequest& request) {
+    TextureCacheEntry* entry;
+    if (cache.Acquire(request.key, entry)) {
+        if (pipeline) {
+            pipeline->Request(request);
+        }
+        else {
+            cache.SetFailed(request.key);
+        }
+    }
+    return entry;
+}
+
+// Function to get a full image's texture, queueing it for loading if necessary
+void* ImageStore::GetTexture(const std::string& url, ImageLoadState* state) {
+    TextureCacheEntry* entry = AcquireEntry(texture_cache, { url, url, 0 });
+    if (state) {
+        *state = entry->state;
+    }
+    return entry->state == ImageLoadState_Ready ? entry->texture : placeholder_texture;
+}
+
+// Function to get a reduced-size preview, cached apart from the full image and drawn from an atlas page.
+// While the full image is loaded anyway its mip chain serves as the preview, nothing else gets decoded.
+StoredImage ImageStore::GetThumbnail(const std::string& url, int max_size) {
+    StoredImage image;
+    TextureCacheEntry* full = texture_cache.Peek(url);
+    if (full && full->state == ImageLoadState_Ready) {
+        image.texture = full->texture;
+        image.state = ImageLoadState_Ready;
+        return image;
+    }
+
+    TextureCacheEntry* entry = AcquireEntry(thumbnail_cache, { ImageCacheKey(url, max_size), url, max_size });
+    image.state = entry->state;
+    image.texture = placeholder_texture;
+    if (entry->state == ImageLoadState_Ready) {
+        const AtlasImage* atlas_image = static_cast<const AtlasImage*>(entry->texture);
+        image.texture = atlas_image->texture;
+        memcpy(image.uv0, atlas_image->uv0, sizeof(image.uv0));
+        memcpy(image.uv1, atlas_image->uv1, sizeof(image.uv1));
+    }
+    return image;
+}
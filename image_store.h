@@ -0,0 +1,104 @@
+#ifndef IMAGE_STORE_H
+#define IMAGE_STORE_H
+
+#include "atlas_packer.h"
+#include "image_pipeline.h"
+#include "texture_cache.h"
+#include "texture_sink.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// How much texture upload work the render thread may do in one frame
+struct UploadBudget {
+    int microseconds = 2000;
+    size_t bytes = 4u * 1024u * 1024u;
+};
+
+struct UploadStats {
+    size_t pending = 0;
+    size_t last_frame_bytes = 0;
+    double last_frame_ms = 0.0;
+    double max_frame_ms = 0.0;
+};
+
+// A texture and the part of it that holds one image, thumbnails share atlas pages
+struct StoredImage {
+    void* texture = nullptr;
+    float uv0[2] = { 0.0f, 0.0f };
+    float uv1[2] = { 1.0f, 1.0f };
+    ImageLoadState state = ImageLoadState_Loading;
+};
+
+// Everything between an image URL and a texture handle: the background pipeline, the full
+// image and thumbnail caches, the thumbnail atlas and the budgeted upload queue. Textures
+// are made through a TextureSink, so the store runs the same with D3D9 or with no GPU.
+// Not thread-safe: one thread (the render thread) calls everything, the pipeline's own
+// workers stay behind PopDecoded.
+class ImageStore {
+public:
+    ImageStore(TextureSink& sink, size_t texture_budget, size_t thumbnail_budget, int atlas_page_size, int atlas_max_pages);
+    ~ImageStore();
+
+    ImageStore(const ImageStore&) = delete;
+    ImageStore& operator=(const ImageStore&) = delete;
+
+    void Start(int network_workers, int decode_workers);
+    // Stops the workers and releases every texture, the store can be started again afterwards
+    void Stop();
+
+    void BeginFrame();
+    void UploadDecoded(const UploadBudget& budget);
+    bool HasPendingUploads() const { return !upload_queue.empty(); }
+    void SetTextureBudget(size_t budget_bytes);
+
+    // Never block: the placeholder texture stands in until an image is ready
+    void* GetTexture(const std::string& url, ImageLoadState* state = nullptr);
+    StoredImage GetThumbnail(const std::string& url, int max_size);
+
+    const TextureCache::Stats& TextureStats() const { return texture_cache.GetStats(); }
+    const TextureCache::Stats& ThumbnailStats() const { return thumbnail_cache.GetStats(); }
+    AtlasPacker::Stats AtlasStats() const { return thumbnail_atlas.GetStats(); }
+    const UploadStats& GetUploadStats() const { return upload_stats; }
+
+private:
+    // A thumbnail's place in an atlas page, or its own texture when the atlas had no room (region.page < 0)
+    struct AtlasImage {
+        void* texture = nullptr;
+        AtlasRegion region;
+        float uv0[2] = { 0.0f, 0.0f };
+        float uv1[2] = { 1.0f, 1.0f };
+    };
+
+    // A decoded image on its way to the GPU, uploaded a band of rows at a time
+    struct UploadJob {
+        DecodedImage image;
+        void* texture = nullptr; // Created by the first band of a full image
+        size_t level = 0; // Mip level being written
+        int next_row = 0; // First row of that level not yet written
+        uint64_t wanted_frame = 0; // Last frame the image was asked for, higher goes first
+        bool done = false;
+    };
+
+    TextureCacheEntry* AcquireEntry(TextureCache& cache, const ImageRequest& request);
+    bool WriteAtlasRegion(void* page, const AtlasRegion& region, const DecodedImage& image);
+    bool ReclaimAtlasPage();
+    AtlasImage* UploadThumbnail(const DecodedImage& image);
+    void CompleteUpload(UploadJob& job, bool ok);
+    size_t RunUploadBand(UploadJob& job, size_t byte_allowance);
+
+    TextureSink& sink;
+    AtlasPacker thumbnail_atlas;
+    std::vector<void*> atlas_pages; // One texture per thumbnail_atlas page
+    TextureCache texture_cache;
+    TextureCache thumbnail_cache;
+    std::unique_ptr<ImagePipeline> pipeline;
+    void* placeholder_texture = nullptr; // Shown while an image is still loading
+    uint64_t frame = 0; // Frame counter used to pin on-screen textures
+    std::vector<UploadJob> upload_queue;
+    UploadStats upload_stats;
+};
+
+#endif // IMAGE_STORE_H
@@ -1,11 +1,34 @@
 #include "utils.h"
 static char search_query[200] = ""; // Buffer to hold the search query
 bool show_generated_memes = false; // Flag to toggle display of generated memes
+static std::vector<uint32_t> meme_order; // Sorted row order over the loaded catalog
+static MemeSearchResults search_results; // Rows matching search_query, refreshed when the query changes
+static uint64_t shown_catalog_generation = 0; // Catalog generation the views above were built for
+static bool show_profiler = false; // Flag to toggle the frame profiler overlay
+static bool render_on_demand = true; // Sleep until input or a background wakeup instead of redrawing every vsync
+static UploadBudget upload_budget; // Per-frame ceiling for texture uploads, tunable in the Texture Cache panel
+static std::vector<uint32_t> visible_rows; // meme_order filtered by search_results, what the table actually lists
+static uint64_t followed_submission = 0; // Ticket of the last Generate Meme click, shown fullscreen once it is done
 
 // Main entry point for the application
-int main(int, char**) {
-    // Fetch meme data from the API
-    FetchMemeData();
+int main(int argc, char** argv) {
+    PROFILE_THREAD("render");
+
+    // --api-origin http://127.0.0.1:8080 talks to a local server such as tools/mock_imgflip_server,
+    // --render-local captions memes on this machine instead of calling /caption_image
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--api-origin") == 0 && i + 1 < argc) {
+            SetApiOrigin(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--render-local") == 0) {
+            SetLocalMemeRendering(true);
+        }
+    }
+
+    // Load the catalog in the background, the table shows a loading state until rows arrive
+    StartMemeDataFetch();
+    // Read the generated memes history the same way, the panel shows what is there so far
+    StartGeneratedMemesLoad();
 
     // Register window class
     WNDCLASSEXW wc = { sizeof(wc), CS_CLASSDC, WndProc, 0L, 0L, GetModuleHandle(nullptr), nullptr, nullptr, nullptr, nullptr, L"ImGui Example", nullptr };
@@ -40,21 +63,40 @@ int main(int, char**) {
     // Customize ImGui style
     CustomizeImGuiStyle();
 
-    // Load meme textures
-    LoadMemeTextures();
+    // Start the background image loaders
+    StartImagePipeline();
 
     // Set clear color for the window background
     ImVec4 clear_color = ImVec4(0.89f, 0.95f, 1.00f, 1.00f);
 
+    // Background stages signal this event when they have something new to show
+    HANDLE wake_event = ::CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    SetWakeHandler([wake_event] { ::SetEvent(wake_event); });
+
     // Main loop
+    const int settle_frames = 3; // Frames drawn after the last change, so ImGui can finish hover and layout updates
+    int frames_to_render = settle_frames;
     bool done = false;
     while (!done) {
+        // With nothing left to draw, sleep until input arrives or a background stage wakes us.
+        // Animated content only needs a redraw every so often, so it wakes on a timeout instead.
+        if (render_on_demand && frames_to_render <= 0 && !HasPendingUploads()) {
+            const bool animating = IsCatalogLoadingAnimated() || io.WantTextInput;
+            DWORD wait = ::MsgWaitForMultipleObjectsEx(1, &wake_event, animating ? 100 : INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+            frames_to_render = wait == WAIT_TIMEOUT ? 1 : settle_frames;
+        }
+        PROFILE_FRAME();
+
         MSG msg;
-        while (::PeekMessage(&msg, nullptr, 0U, 0U, PM_REMOVE)) {
-            ::TranslateMessage(&msg);
-            ::DispatchMessage(&msg);
-            if (msg.message == WM_QUIT)
-                done = true;
+        {
+            PROFILE_SCOPE("Message pump");
+            while (::PeekMessage(&msg, nullptr, 0U, 0U, PM_REMOVE)) {
+                ::TranslateMessage(&msg);
+                ::DispatchMessage(&msg);
+                if (msg.message == WM_QUIT)
+                    done = true;
+                frames_to_render = settle_frames;
+            }
         }
         if (done)
             break;
@@ -79,14 +121,32 @@ int main(int, char**) {
             ResetDevice();
         }
 
+        // Upload images that finished decoding in the background, within the frame's budget
+        BeginTextureFrame();
+        UploadDecodedTextures(upload_budget);
+
         // Start the Dear ImGui frame
         ImGui_ImplDX9_NewFrame();
         ImGui_ImplWin32_NewFrame();
         ImGui::NewFrame();
+        EnableMipmapFiltering();
+
+        // Open the meme the user generated last as soon as it is ready, unless they moved on to another window
+        if (followed_submission) {
+            for (const MemeSubmission& submission : GetMemeSubmissions()) {
+                if (submission.ticket == followed_submission && submission.state >= MemeSubmissionState_Done) {
+                    if (submission.state == MemeSubmissionState_Done && fullscreen_image_url.empty() && create_meme_url.empty()) {
+                        fullscreen_image_url = submission.url;
+                    }
+                    followed_submission = 0;
+                }
+            }
+        }
 
         // Main UI section
         if (fullscreen_image_url.empty() && create_meme_url.empty()) {
-            ImGui::Begin("Meme Data Table", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+            ImGui::SetNextWindowSize(ImVec2(783, 643), ImGuiCond_FirstUseEver);
+            ImGui::Begin("Meme Data Table");
             ImGui::Text("Search for a meme:");
             ImGui::InputText("##Search", search_query, IM_ARRAYSIZE(search_query)); // Search bar for filtering memes
             ImGui::Spacing();
@@ -94,77 +154,142 @@ int main(int, char**) {
             if (ImGui::Button("Show Generated Memes")) {
                 show_generated_memes = !show_generated_memes;
             }
+            ImGui::SameLine();
+            ImGui::Checkbox("Redraw only on changes", &render_on_demand);
+            ImGui::SameLine();
+            ImGui::Checkbox("Profiler", &show_profiler);
+            std::string picked_meme = ShowMemeSubmissions();
+            if (!picked_meme.empty()) {
+                fullscreen_image_url = picked_meme;
+            }
+            if (ImGui::CollapsingHeader("Batch")) {
+                ShowMemeBatch();
+            }
+            if (ImGui::CollapsingHeader("Connections")) {
+                ShowHttpPoolStats();
+            }
+            if (ImGui::CollapsingHeader("Network")) {
+                ShowNetTelemetry();
+            }
+            if (ImGui::CollapsingHeader("Texture Cache")) {
+                ShowTextureCacheStats();
+                int uploadKilobytes = static_cast<int>(upload_budget.bytes / 1024);
+                ImGui::SliderInt("Upload time budget (us)", &upload_budget.microseconds, 250, 16000);
+                if (ImGui::SliderInt("Upload byte budget (KB)", &uploadKilobytes, 64, 32768))
+                    upload_budget.bytes = static_cast<size_t>(uploadKilobytes) * 1024;
+            }
+
+            // Take this frame's catalog, a background refresh may publish a new one at any time
+            std::shared_ptr<const LoadedCatalog> loaded = GetLoadedCatalog();
+            const MemeCatalog& catalog = loaded->catalog;
+            if (loaded->generation != shown_catalog_generation) {
+                shown_catalog_generation = loaded->generation;
+                meme_order.clear();
+                search_results.Invalidate();
+            }
+            const bool hasRows = ShowCatalogFetchStatus(catalog.Empty());
 
-            // Display meme data table
-            if (ImGui::BeginTable("MemeTable", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable | ImGuiTableFlags_Sortable | ImGuiTableFlags_SortMulti)) {
-                ImGui::TableSetupColumn("ID", ImGuiTableColumnFlags_WidthStretch | ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending);
-                ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_WidthStretch);
-                ImGui::TableSetupColumn("Image", ImGuiTableColumnFlags_WidthStretch);
-                ImGui::TableSetupColumn("Width", ImGuiTableColumnFlags_WidthStretch);
-                ImGui::TableSetupColumn("Height", ImGuiTableColumnFlags_WidthStretch);
-                ImGui::TableSetupColumn("Text Areas", ImGuiTableColumnFlags_WidthStretch);
+            // Display meme data table, scrolling inside the window with the header frozen on top
+            const ImGuiTableFlags tableFlags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable | ImGuiTableFlags_Sortable | ImGuiTableFlags_SortMulti | ImGuiTableFlags_ScrollY;
+            if (hasRows && ImGui::BeginTable("MemeTable", 7, tableFlags, ImVec2(0.0f, 0.0f))) {
+                ImGui::TableSetupScrollFreeze(0, 1);
+                ImGui::TableSetupColumn("ID", ImGuiTableColumnFlags_WidthStretch | ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending, 0.0f, MemeSortColumn_Id);
+                ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_WidthStretch, 0.0f, MemeSortColumn_Name);
+                ImGui::TableSetupColumn("Image", ImGuiTableColumnFlags_WidthStretch | ImGuiTableColumnFlags_NoSort, 0.0f, MemeSortColumn_Image);
+                ImGui::TableSetupColumn("Actions", ImGuiTableColumnFlags_WidthStretch | ImGuiTableColumnFlags_NoSort, 0.0f, MemeSortColumn_Actions);
+                ImGui::TableSetupColumn("Width", ImGuiTableColumnFlags_WidthStretch, 0.0f, MemeSortColumn_Width);
+                ImGui::TableSetupColumn("Height", ImGuiTableColumnFlags_WidthStretch, 0.0f, MemeSortColumn_Height);
+                ImGui::TableSetupColumn("Text Areas", ImGuiTableColumnFlags_WidthStretch, 0.0f, MemeSortColumn_BoxCount);
                 ImGui::TableHeadersRow();
 
                 // Handle sorting
+                bool rowsDirty = false;
                 ImGuiTableSortSpecs* sortSpecs = ImGui::TableGetSortSpecs();
-                if (sortSpecs && sortSpecs->SpecsDirty) {
-                    std::vector<nlohmann::json> memes = meme_data["data"]["memes"].get<std::vector<nlohmann::json>>();
-                    qsort(&memes[0], memes.size(), sizeof(nlohmann::json), CompareMemes);
-                    meme_data["data"]["memes"] = memes;
-                    sortSpecs->SpecsDirty = false;
+                if ((sortSpecs && sortSpecs->SpecsDirty) || meme_order.size() != catalog.Size()) {
+                    SortMemeOrder(catalog, loaded->sort_keys, meme_order, sortSpecs);
+                    if (sortSpecs)
+                        sortSpecs->SpecsDirty = false;
+                    rowsDirty = true;
                 }
 
-                bool meme_found = false;
+                // Rebuild the filtered, sorted row list only when the sort or the query changed
+                {
+                    PROFILE_SCOPE("Search");
+                    if (UpdateSearchResults(loaded->search_index, catalog, search_query, search_results))
+                        rowsDirty = true;
+                }
+                if (rowsDirty) {
+                    visible_rows.clear();
+                    for (uint32_t row : meme_order) {
+                        if (search_results.matches[row])
+                            visible_rows.push_back(row);
+                    }
+                }
 
-                // Display meme rows
-                for (const auto& meme : meme_data["data"]["memes"]) {
-                    std::string name = meme["name"].get<std::string>();
-                    if (strstr(name.c_str(), search_query) != nullptr) {
-                        meme_found = true;
-                        ImGui::TableNextRow();
-                        ImGui::TableNextColumn(); ImGui::Text("%s", meme["id"].get<std::string>().c_str());
-                        ImGui::TableNextColumn(); ImGui::Text("%s", name.c_str());
+                // Every row gets the height of a thumbnail row so the clipper can step over them uniformly.
+                // The minimum row height includes the cell padding around the thumbnail.
+                const float thumbnailSize = 100.0f;
+                const float rowHeight = thumbnailSize + ImGui::GetStyle().CellPadding.y * 2.0f;
+
+                // Display only the meme rows inside the scroll region
+                PROFILE_SCOPE("Table rows");
+                ImGuiListClipper clipper;
+                clipper.Begin(static_cast<int>(visible_rows.size()), rowHeight);
+                while (clipper.Step()) {
+                    for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                        uint32_t row = visible_rows[i];
+                        const char* url = catalog.Url(row);
+                        ImGui::PushID(static_cast<int>(row));
+                        ImGui::TableNextRow(ImGuiTableRowFlags_None, rowHeight);
+                        ImGui::TableNextColumn(); ImGui::Text("%s", catalog.Id(row));
+                        ImGui::TableNextColumn(); ImGui::Text("%s", catalog.Name(row));
+                        // The Image column holds nothing but thumbnails, so its draw channel is a run of
+                        // images from the same atlas page that ImGui merges into one command; the buttons
+                        // and text, drawn from the font texture, sit in the Actions column next to it
+                        const bool viewed = viewed_images.find(url) != viewed_images.end();
+                        MemeImage thumbnail;
+                        if (viewed) {
+                            thumbnail = GetMemeThumbnail(url, static_cast<int>(thumbnailSize));
+                        }
                         ImGui::TableNextColumn();
-                        {
-                            std::string url = meme["url"].get<std::string>();
-                            std::string id = meme["id"].get<std::string>(); // Extract template ID
-                            if (viewed_images.find(url) == viewed_images.end()) { // Check if meme is not already viewed
-                                if (ImGui::Button(("See Image##" + meme["id"].get<std::string>()).c_str())) {
-                                    seen_images.insert(url);
-                                    viewed_images.insert(url);
-                                }
+                        if (viewed && thumbnail.state != ImageLoadState_Failed) {
+                            ImGui::Image((void*)thumbnail.texture, ImVec2(thumbnailSize, thumbnailSize), thumbnail.uv0, thumbnail.uv1);
+                            if (ImGui::IsItemClicked() && thumbnail.state == ImageLoadState_Ready) {
+                                fullscreen_image_url = url; // Show image in full screen on click
                             }
-                            else { // If meme has been viewed
-                                LPDIRECT3DTEXTURE9 texture = GetMemeTexture(url);
-                                if (texture) {
-                                    if (ImGui::ImageButton((void*)texture, ImVec2(100, 100))) {
-                                        fullscreen_image_url = url; // Show image in full screen on click
-                                    }
-                                    if (ImGui::Button(("Create Meme##" + meme["id"].get<std::string>()).c_str())) {
-                                        create_meme_url = id; // Set template ID for meme creation
-                                        text_boxes.clear();
-                                        int box_count = meme["box_count"].get<int>();
-                                        text_boxes.resize(box_count);
-                                    }
-                                    if (ImGui::Button(("Close Image##" + meme["id"].get<std::string>()).c_str())) {
-                                        viewed_images.erase(url);
-                                    }
-                                }
-                                else {
-                                    ImGui::Text("Failed to load");
-                                }
+                        }
+                        ImGui::TableNextColumn();
+                        if (!viewed) { // Check if meme is not already viewed
+                            if (ImGui::Button("See Image")) {
+                                seen_images.insert(url);
+                                viewed_images.insert(url);
                             }
                         }
-                        ImGui::TableNextColumn(); ImGui::Text("%d", meme["width"].get<int>());
-                        ImGui::TableNextColumn(); ImGui::Text("%d", meme["height"].get<int>());
-                        ImGui::TableNextColumn(); ImGui::Text("%d", meme["box_count"].get<int>());
+                        else { // If meme has been viewed
+                            if (thumbnail.state == ImageLoadState_Failed) {
+                                ImGui::Text("Failed to load");
+                            }
+                            else if (ImGui::Button("Create Meme")) {
+                                create_meme_url = catalog.Id(row); // Set template ID for meme creation
+                                text_boxes.clear();
+                                text_boxes.resize(catalog.box_counts[row]);
+                            }
+                            if (ImGui::Button("Close Image")) {
+                                viewed_images.erase(url);
+                            }
+                        }
+                        ImGui::TableNextColumn(); ImGui::Text("%d", catalog.widths[row]);
+                        ImGui::TableNextColumn(); ImGui::Text("%d", catalog.heights[row]);
+                        ImGui::TableNextColumn(); ImGui::Text("%d", catalog.box_counts[row]);
+                        ImGui::PopID();
                     }
                 }
 
-                if (!meme_found) {
+                if (visible_rows.empty()) {
                     ImGui::TableNextRow();
                     ImGui::TableNextColumn(); ImGui::Text("No meme found with the name: %s", search_query);
-                    ImGui::TableNextColumn(); ImGui::TableNextColumn(); ImGui::TableNextColumn(); ImGui::TableNextColumn(); ImGui::TableNextColumn();
+                    for (int column = 1; column < 7; ++column)
+                        ImGui::TableNextColumn();
                 }
 
                 ImGui::EndTable();
@@ -177,16 +302,39 @@ int main(int, char**) {
             if (show_generated_memes) {
                 ImGui::SameLine();
                 ImGui::Begin("Generated Memes", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
-                ImGui::Text("List of all generated memes:");
-                for (const auto& url : generated_memes) {
-                    ImGui::Text("%s", url.c_str());
-                    LPDIRECT3DTEXTURE9 texture = GetMemeTexture(url);
-                    if (texture) {
-                        if (ImGui::ImageButton((void*)texture, ImVec2(150, 150))) {
-                            fullscreen_image_url = url; // Set the URL to display the meme in fullscreen
+                std::shared_ptr<const GeneratedMemeList> generated_memes = GetGeneratedMemes();
+                ImGui::Text("List of all generated memes (%zu)%s", generated_memes->Size(), GeneratedMemesLoading() ? ", loading history..." : ":");
+                const MemeJournal::Stats journal = GetGeneratedMemeJournalStats();
+                ImGui::TextDisabled("Journal: %zu records, %.1f MB, read in %.0f ms, %llu compactions", journal.records, journal.bytes / (1024.0 * 1024.0),
+                    journal.load_ms, static_cast<unsigned long long>(journal.compactions));
+                if (journal.failed_writes) {
+                    ImGui::TextColored(ImVec4(0.8f, 0.1f, 0.1f, 1.0f), "Journal: %llu memes could not be saved (%llu failed writes)",
+                        static_cast<unsigned long long>(journal.lost_records), static_cast<unsigned long long>(journal.failed_writes));
+                }
+
+                // The history can be long, so only the rows in view are drawn; every row is a URL over a thumbnail
+                const float rowHeight = ImGui::GetTextLineHeightWithSpacing() + 150.0f + ImGui::GetStyle().FramePadding.y * 2.0f + ImGui::GetStyle().ItemSpacing.y;
+                ImGui::BeginChild("GeneratedMemesList", ImVec2(480, 600));
+                ImGuiListClipper clipper;
+                clipper.Begin(static_cast<int>(generated_memes->Size()), rowHeight);
+                while (clipper.Step()) {
+                    for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                        const std::string& url = (*generated_memes)[i];
+                        ImGui::PushID(i);
+                        ImGui::Text("%s", url.c_str());
+                        MemeImage thumbnail = GetMemeThumbnail(url, 150);
+                        if (thumbnail.state != ImageLoadState_Failed) {
+                            if (ImGui::ImageButton((void*)thumbnail.texture, ImVec2(150, 150), thumbnail.uv0, thumbnail.uv1) && thumbnail.state == ImageLoadState_Ready) {
+                                fullscreen_image_url = url; // Set the URL to display the meme in fullscreen
+                            }
+                        }
+                        else {
+                            ImGui::Dummy(ImVec2(150, 150 + ImGui::GetStyle().FramePadding.y * 2.0f));
                         }
+                        ImGui::PopID();
                     }
                 }
+                ImGui::EndChild();
                 if (ImGui::Button("Close")) {
                     show_generated_memes = false;
                 }
@@ -201,14 +349,17 @@ int main(int, char**) {
                 text_boxes[i].resize(200); // Ensure text_boxes[i] has enough space
                 ImGui::InputText(("Text " + std::to_string(i + 1)).c_str(), &text_boxes[i][0], text_boxes[i].capacity());
             }
+            bool render_locally = GetLocalMemeRendering();
+            if (ImGui::Checkbox("Render locally", &render_locally)) {
+                SetLocalMemeRendering(render_locally);
+            }
             if (ImGui::Button("Generate Meme")) {
-                std::string meme_url = CreateMeme(create_meme_url, text_boxes);
-                if (!meme_url.empty()) {
-                    fullscreen_image_url = meme_url;
-                }
-                else {
-                    std::cerr << "Failed to create meme" << std::endl;
+                // Queue it and return to the table right away, the request runs in the background
+                std::vector<std::string> text;
+                for (const std::string& box : text_boxes) {
+                    text.push_back(box.c_str()); // Up to the terminator, the rest of the edit buffer is padding
                 }
+                followed_submission = SubmitMeme(create_meme_url, text);
                 create_meme_url.clear();
             }
             ImGui::SameLine();
@@ -220,12 +371,30 @@ int main(int, char**) {
 
         // Display fullscreen image
         if (!fullscreen_image_url.empty()) {
-            LPDIRECT3DTEXTURE9 texture = GetMemeTexture(fullscreen_image_url);
-            if (texture) {
+            ImageLoadState state;
+            LPDIRECT3DTEXTURE9 texture = GetMemeTexture(fullscreen_image_url, &state);
+            if (state == ImageLoadState_Failed) {
+                std::cerr << "Failed to load image: " << fullscreen_image_url << std::endl;
+                fullscreen_image_url = "";
+            }
+            else {
                 ImGui::SetNextWindowPos(ImVec2(0, 0), ImGuiCond_Always);
                 ImGui::SetNextWindowSize(io.DisplaySize, ImGuiCond_Always);
                 ImGui::Begin("Fullscreen Image", nullptr, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse);
-                ImGui::Image((void*)texture, io.DisplaySize);
+                if (state == ImageLoadState_Ready) {
+                    // Fit the image to the display without stretching it, centred on the spare axis
+                    D3DSURFACE_DESC desc;
+                    texture->GetLevelDesc(0, &desc);
+                    const float scaleX = io.DisplaySize.x / desc.Width;
+                    const float scaleY = io.DisplaySize.y / desc.Height;
+                    const float scale = scaleX < scaleY ? scaleX : scaleY;
+                    const ImVec2 size(desc.Width * scale, desc.Height * scale);
+                    ImGui::SetCursorPos(ImVec2((io.DisplaySize.x - size.x) * 0.5f, (io.DisplaySize.y - size.y) * 0.5f));
+                    ImGui::Image((void*)texture, size);
+                }
+                else {
+                    ImGui::Text("Loading...");
+                }
                 if (ImGui::IsMouseClicked(0)) {
                     fullscreen_image_url = "";
                 }
@@ -233,6 +402,14 @@ int main(int, char**) {
             }
         }
 
+        // Profiler overlay, F9 saves the last ten seconds as a Chrome trace
+        if (show_profiler) {
+            ShowProfilerOverlay(&show_profiler);
+        }
+        if (ImGui::IsKeyPressed(ImGuiKey_F9, false)) {
+            SaveProfilerTrace();
+        }
+
         // Render ImGui frame
         ImGui::EndFrame();
         g_pd3dDevice->SetRenderState(D3DRS_ZENABLE, FALSE);
@@ -241,22 +418,41 @@ int main(int, char**) {
         D3DCOLOR clear_col_dx = D3DCOLOR_RGBA((int)(clear_color.x * clear_color.w * 255.0f), (int)(clear_color.y * clear_color.w * 255.0f), (int)(clear_color.z * clear_color.w * 255.0f), (int)(clear_color.w * 255.0f));
         g_pd3dDevice->Clear(0, nullptr, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, clear_col_dx, 1.0f, 0);
         if (g_pd3dDevice->BeginScene() >= 0) {
-            ImGui::Render();
-            ImGui_ImplDX9_RenderDrawData(ImGui::GetDrawData());
+            {
+                PROFILE_SCOPE("ImGui::Render");
+                ImGui::Render();
+            }
+            RecordDrawCalls(ImGui::GetDrawData());
+            {
+                PROFILE_SCOPE("RenderDrawData");
+                ImGui_ImplDX9_RenderDrawData(ImGui::GetDrawData());
+            }
             g_pd3dDevice->EndScene();
         }
-        HRESULT result = g_pd3dDevice->Present(nullptr, nullptr, nullptr, nullptr);
+        HRESULT result;
+        {
+            PROFILE_SCOPE("Present");
+            result = g_pd3dDevice->Present(nullptr, nullptr, nullptr, nullptr);
+        }
         if (result == D3DERR_DEVICELOST)
             g_DeviceLost = true;
+        frames_to_render--;
     }
 
     // Cleanup
+    SetWakeHandler(nullptr);
+    ::CloseHandle(wake_event);
+    StopImagePipeline();
+    StopMemeSubmissions();
+    StopMemeBatch();
+    StopGeneratedMemes(); // After the submissions, so their memes reach the journal
     ImGui_ImplDX9_Shutdown();
     ImGui_ImplWin32_Shutdown();
     ImGui::DestroyContext();
 
     CleanupDeviceD3D();
     ::DestroyWindow(hwnd);
+    StopMemeDataFetch();
     ::UnregisterClassW(wc.lpszClassName, wc.hInstance);
 
     return 0;
@@ -0,0 +1,117 @@
+#include "mapped_file.h"
+#include <filesystem>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    MoveFrom(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        Close();
+        MoveFrom(other);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+// Function to take over another mapping, leaving it closed
+void MappedFile::MoveFrom(MappedFile& other) {
+    data = other.data;
+    size = other.size;
+    other.data = nullptr;
+    other.size = 0;
+#ifdef _WIN32
+    file_handle = other.file_handle;
+    mapping_handle = other.mapping_handle;
+    other.file_handle = nullptr;
+    other.mapping_handle = nullptr;
+#endif
+}
+
+// Function to map a file, returns false if it is missing, empty or cannot be mapped
+bool MappedFile::Open(const std::string& path) {
+    Close();
+#ifdef _WIN32
+    std::wstring wide_path = std::filesystem::path(path).wstring();
+    HANDLE file = ::CreateFileW(wide_path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    if (!::GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        ::CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        ::CloseHandle(file);
+        return false;
+    }
+    void* view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        ::CloseHandle(mapping);
+        ::CloseHandle(file);
+        return false;
+    }
+    file_handle = file;
+    mapping_handle = mapping;
+    data = static_cast<const unsigned char*>(view);
+    size = static_cast<size_t>(file_size.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* view = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping keeps the file alive
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    data = static_cast<const unsigned char*>(view);
+    size = static_cast<size_t>(st.st_size);
+#endif
+    return true;
+}
+
+// Function to unmap the file
+void MappedFile::Close() {
+#ifdef _WIN32
+    if (data) {
+        ::UnmapViewOfFile(data);
+    }
+    if (mapping_handle) {
+        ::CloseHandle(mapping_handle);
+    }
+    if (file_handle) {
+        ::CloseHandle(file_handle);
+    }
+    file_handle = nullptr;
+    mapping_handle = nullptr;
+#else
+    if (data) {
+        ::munmap(const_cast<unsigned char*>(data), size);
+    }
+#endif
+    data = nullptr;
+    size = 0;
+}
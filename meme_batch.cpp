@@ -0,0 +1,329 @@
+#include "meme_batch.h"
+#include "http_pool.h"
+#include "json.hpp"
+#include "meme_service.h"
+#include "profiler.h"
+#include "wake_signal.h"
+#include <algorithm>
+#include <cmath>
+#include <exception>
+
+static const int batch_max_concurrency = 64;
+static const size_t batch_queue_per_worker = 4; // Records read ahead of the workers
+
+TokenBucket::TokenBucket(double rate_per_second, int burst)
+    : rate(rate_per_second), capacity(std::max(burst, 1)), tokens(capacity), last_refill(std::chrono::steady_clock::now()) {
+}
+
+// Function to take one token, waiting for the refill; false if cancel became true first
+bool TokenBucket::Acquire(const std::atomic<bool>& cancel) {
+    if (rate <= 0.0) {
+        return !cancel;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!cancel) {
+        const auto now = std::chrono::steady_clock::now();
+        tokens = std::min(capacity, tokens + std::chrono::duration<double>(now - last_refill).count() * rate);
+        last_refill = now;
+        if (tokens >= 1.0) {
+            tokens -= 1.0;
+            return true;
+        }
+        cv.wait_for(lock, std::chrono::duration<double>((1.0 - tokens) / rate));
+    }
+    return false;
+}
+
+// Function to wake every waiter so it notices a cancel
+void TokenBucket::Interrupt() {
+    std::lock_guard<std::mutex> lock(mutex);
+    cv.notify_all();
+}
+
+MemeBatch::~MemeBatch() {
+    Cancel();
+    Wait();
+}
+
+// Function to open the files and start the threads; false with GetReport().error set if it could not
+bool MemeBatch::Start(const MemeBatchOptions& batch_options) {
+    if (running) {
+        return false;
+    }
+    Wait();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    options = batch_options;
+    options.concurrency = std::min(std::max(options.concurrency, 1), batch_max_concurrency);
+    options.max_attempts = std::max(options.max_attempts, 1);
+    progress = MemeBatchProgress();
+    latencies_ms.clear();
+    queue.clear();
+    error.clear();
+    cancel = false;
+    start_time = end_time = std::chrono::steady_clock::now();
+
+    input.close();
+    input.clear();
+    input.open(options.input_path, std::ios::binary);
+    if (!input.is_open()) {
+        error = "Cannot open " + options.input_path;
+        return false;
+    }
+    output.close();
+    output.clear();
+    output.open(options.output_path, std::ios::binary | std::ios::trunc);
+    if (!output.is_open()) {
+        input.close();
+        error = "Cannot create " + options.output_path;
+        return false;
+    }
+
+    // Every worker may hold a connection to the API at once, a smaller pool would cap the concurrency
+    HttpClientPool& pool = GetHttpClientPool();
+    if (pool.GetMaxConnectionsPerHost() < options.concurrency) {
+        pool.SetMaxConnectionsPerHost(options.concurrency);
+    }
+
+    bucket = std::make_unique<TokenBucket>(options.rate_per_second, options.burst);
+    running = true;
+    progress.running = true;
+    active_workers = options.concurrency;
+    reader = std::thread(&MemeBatch::ReadInput, this);
+    for (int i = 0; i < options.concurrency; ++i) {
+        workers.emplace_back(&MemeBatch::RunWorker, this);
+    }
+    return true;
+}
+
+// Function to stop early: nothing new is sent, requests in flight still write their result
+void MemeBatch::Cancel() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        cancel = true;
+        progress.cancelled = true;
+    }
+    queue_cv.notify_all();
+    if (bucket) {
+        bucket->Interrupt();
+    }
+}
+
+// Function to wait for the batch to finish and join its threads
+void MemeBatch::Wait() {
+    if (reader.joinable()) {
+        reader.join();
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+// Function to stream the input into the queue, holding back while the workers are behind
+void MemeBatch::ReadInput() {
+    PROFILE_THREAD("batch reader");
+    const size_t queue_limit = options.concurrency * batch_queue_per_worker;
+    std::string line;
+    uint64_t line_number = 0;
+    while (!cancel && std::getline(input, line)) {
+        line_number++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        queue_cv.wait(lock, [&] { return cancel || queue.size() < queue_limit; });
+        if (cancel) {
+            break;
+        }
+        queue.push_back({ line_number, std::move(line) });
+        progress.read++;
+        lock.unlock();
+        queue_cv.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        progress.input_finished = true;
+        if (input.bad()) {
+            error = "Error reading " + options.input_path;
+        }
+    }
+    input.close();
+    queue_cv.notify_all();
+}
+
+// Function to run queued records until the input is drained or the batch is cancelled
+void MemeBatch::RunWorker() {
+    PROFILE_THREAD("batch worker");
+    while (true) {
+        Record record;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queue_cv.wait(lock, [this] { return cancel || !queue.empty() || progress.input_finished; });
+            if (cancel || queue.empty()) {
+                break;
+            }
+            record = std::move(queue.front());
+            queue.pop_front();
+        }
+        queue_cv.notify_all(); // Room for the reader
+        ProcessRecord(record);
+    }
+    FinishWorker();
+}
+
+// Function to create one record's meme, retrying transient failures with exponential backoff,
+// and write its result line
+void MemeBatch::ProcessRecord(const Record& record) {
+    std::string template_id;
+    std::vector<std::string> text;
+    std::string url, failure;
+    bool ok = false;
+    int attempts = 0;
+    bool cached = false;
+    bool measured = false; // A request was made, the latency goes into the percentiles
+    double latency_ms = 0.0;
+    std::chrono::steady_clock::time_point first_attempt;
+
+    nlohmann::json json = nlohmann::json::parse(record.text, nullptr, false);
+    if (json.is_object() && json.contains("template_id") && (json["template_id"].is_string() || json["template_id"].is_number_integer())) {
+        template_id = json["template_id"].is_string() ? json["template_id"].get<std::string>() : json["template_id"].dump();
+        if (json.contains("boxes") && json["boxes"].is_array()) {
+            for (const auto& box : json["boxes"]) {
+                text.push_back(box.is_string() ? box.get<std::string>() : box.is_object() ? box.value("text", std::string()) : std::string());
+            }
+        }
+    }
+    if (template_id.empty()) {
+        failure = json.is_discarded() ? "Malformed record" : "Record has no template_id";
+    }
+    else {
+        // Memes made before skip the rate limit, only real requests take a token
+        const auto start = std::chrono::steady_clock::now();
+        cached = FindCachedMeme(template_id, text, url);
+        ok = cached;
+        while (!ok && attempts < options.max_attempts) {
+            if (!bucket->Acquire(cancel)) {
+                break;
+            }
+            if (attempts == 0) {
+                first_attempt = std::chrono::steady_clock::now();
+            }
+            attempts++;
+            bool transient = false;
+            url.clear();
+            {
+                PROFILE_SCOPE("Batch meme");
+                // A throw fails this record for good rather than ending the worker with the rest of the batch
+                try {
+                    ok = CaptionMeme(template_id, text, url, failure, &transient, &cached);
+                }
+                catch (const std::exception& e) {
+                    ok = false;
+                    transient = false;
+                    url.clear();
+                    failure = std::string("Unexpected error: ") + e.what();
+                }
+            }
+            if (ok || !transient || attempts == options.max_attempts) {
+                break;
+            }
+            const auto backoff = std::chrono::milliseconds(static_cast<int64_t>(options.retry_delay_ms * std::pow(2.0, attempts - 1)));
+            std::unique_lock<std::mutex> lock(mutex);
+            if (queue_cv.wait_for(lock, backoff, [this] { return cancel.load(); })) {
+                break;
+            }
+        }
+        if (!cached && attempts == 0) {
+            return; // Cancelled before anything was sent, nothing to report
+        }
+        latency_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - (attempts == 0 ? start : first_attempt)).count();
+        measured = attempts > 0; // A cache hit takes microseconds and would drag every percentile towards 0
+        if (ok) {
+            failure.clear();
+        }
+    }
+
+    const nlohmann::json result = {
+        { "line", record.line }, { "template_id", template_id }, { "ok", ok }, { "url", url },
+        { "error", failure }, { "attempts", attempts }, { "cached", cached }, { "latency_ms", latency_ms },
+    };
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        output << result.dump() << '\n';
+        progress.done++;
+        progress.succeeded += ok;
+        progress.failed += !ok;
+        progress.retries += std::max(attempts - 1, 0);
+        progress.cached += cached;
+        if (measured) {
+            latencies_ms.push_back(latency_ms);
+        }
+    }
+    WakeRenderLoop();
+}
+
+// Function to close the output once the last worker is done
+void MemeBatch::FinishWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--active_workers > 0) {
+            return;
+        }
+        output.close();
+        if (output.fail() && error.empty()) {
+            error = "Error writing " + options.output_path;
+        }
+        end_time = std::chrono::steady_clock::now();
+        progress.running = false;
+        running = false;
+    }
+    queue_cv.notify_all(); // A reader held back by a cancel
+    WakeRenderLoop();
+}
+
+// Function to snapshot the counters, safe to call from the render loop while the batch runs
+MemeBatchProgress MemeBatch::GetProgress() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    MemeBatchProgress snapshot = progress;
+    const auto end = progress.running ? std::chrono::steady_clock::now() : end_time;
+    snapshot.elapsed_seconds = std::chrono::duration<double>(end - start_time).count();
+    return snapshot;
+}
+
+// Function to summarise the batch, percentiles are exact over every record that was sent;
+// records the result cache answered without a request are counted in cached but not timed
+MemeBatchReport MemeBatch::GetReport() const {
+    std::vector<double> sorted;
+    MemeBatchReport report;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sorted = latencies_ms;
+        report.records = progress.done;
+        report.succeeded = progress.succeeded;
+        report.failed = progress.failed;
+        report.retries = progress.retries;
+        report.cached = progress.cached;
+        report.cancelled = progress.cancelled;
+        report.error = error;
+        const auto end = progress.running ? std::chrono::steady_clock::now() : end_time;
+        report.seconds = std::chrono::duration<double>(end - start_time).count();
+    }
+    report.records_per_second = report.seconds > 0.0 ? report.records / report.seconds : 0.0;
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&](double fraction) {
+        if (sorted.empty()) {
+            return 0.0;
+        }
+        const size_t rank = static_cast<size_t>(std::ceil(fraction * sorted.size()));
+        return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+    };
+    report.p50_ms = percentile(0.50);
+    report.p90_ms = percentile(0.90);
+    report.p99_ms = percentile(0.99);
+    report.max_ms = sorted.empty() ? 0.0 : sorted.back();
+    return report;
+}
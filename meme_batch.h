@@ -0,0 +1,137 @@
+#ifndef MEME_BATCH_H
+#define MEME_BATCH_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Bulk meme creation from a JSONL file, one record per line:
+//   {"template_id": "181913649", "boxes": ["top text", "bottom text"]}
+// boxes may also hold Imgflip style {"text": "..."} objects. The input is streamed, not loaded
+// whole, and each result goes to the output file as one JSON line as soon as it is known:
+//   {"line": 3, "template_id": "181913649", "ok": true, "url": "...", "error": "", "attempts": 1, "cached": false, "latency_ms": 212.4}
+// Results come out in completion order; line ties them back to the input. Records that are
+// not valid JSON or lack a template_id fail with attempts 0, blank lines are skipped.
+// Memes already in the result cache come back with cached set, attempts 0 and no rate limit wait.
+struct MemeBatchOptions {
+    std::string input_path;
+    std::string output_path;
+    int concurrency = 4;          // Requests in flight at once (1-64); Start raises the per-host connection limit to match
+    double rate_per_second = 5.0; // Token bucket refill rate, 0 for no limit
+    int burst = 5;                // Token bucket size
+    int max_attempts = 3;         // Tries per record; only transient failures are retried
+    int retry_delay_ms = 250;     // First retry backoff, doubled on every further attempt
+};
+
+struct MemeBatchProgress {
+    uint64_t read = 0;      // Records taken from the input so far
+    uint64_t done = 0;      // Records with a result written
+    uint64_t succeeded = 0;
+    uint64_t failed = 0;
+    uint64_t retries = 0;
+    uint64_t cached = 0;    // Answered by the result cache, no new meme made
+    bool running = false;
+    bool cancelled = false;
+    bool input_finished = false; // The whole input has been read, read is the final record count
+    double elapsed_seconds = 0.0;
+};
+
+// Summary of a finished batch. Latencies run from the first attempt of a record to its result,
+// so they include retries and their backoff but not the wait for the first rate limit token.
+// Records answered from the result cache without a request are left out of the percentiles.
+struct MemeBatchReport {
+    uint64_t records = 0;
+    uint64_t succeeded = 0;
+    uint64_t failed = 0;
+    uint64_t retries = 0;
+    uint64_t cached = 0;
+    bool cancelled = false;
+    double seconds = 0.0;
+    double records_per_second = 0.0;
+    double p50_ms = 0.0;
+    double p90_ms = 0.0;
+    double p99_ms = 0.0;
+    double max_ms = 0.0;
+    std::string error; // Set when the batch could not start or the output could not be written
+};
+
+// Token bucket: holds up to burst tokens and refills at rate tokens per second
+class TokenBucket {
+public:
+    TokenBucket(double rate_per_second, int burst);
+
+    // Function to take one token, waiting for the refill; false if cancel became true first
+    bool Acquire(const std::atomic<bool>& cancel);
+    // Function to wake every waiter so it notices a cancel
+    void Interrupt();
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    double rate;
+    double capacity;
+    double tokens;
+    std::chrono::steady_clock::time_point last_refill;
+};
+
+// One batch run: a reader thread streams records into a bounded queue and a fixed set of
+// workers takes them from there, so memory stays flat however long the input is.
+class MemeBatch {
+public:
+    MemeBatch() = default;
+    ~MemeBatch();
+    MemeBatch(const MemeBatch&) = delete;
+    MemeBatch& operator=(const MemeBatch&) = delete;
+
+    // Function to open the files and start the threads; false with GetReport().error set if it could not.
+    // A finished batch can be started again, a running one is left alone.
+    bool Start(const MemeBatchOptions& options);
+    // Function to stop early: nothing new is sent, requests in flight still write their result
+    void Cancel();
+    // Function to wait for the batch to finish and join its threads
+    void Wait();
+
+    bool Running() const { return running; }
+    MemeBatchProgress GetProgress() const;
+    MemeBatchReport GetReport() const;
+
+private:
+    struct Record {
+        uint64_t line = 0;
+        std::string text; // The raw input line, parsed by the worker
+    };
+
+    void ReadInput();
+    void RunWorker();
+    void ProcessRecord(const Record& record);
+    void FinishWorker();
+
+    MemeBatchOptions options;
+    std::ifstream input;
+    std::ofstream output;
+    std::thread reader;
+    std::vector<std::thread> workers;
+    std::atomic<bool> running{ false };
+    std::atomic<bool> cancel{ false };
+    std::unique_ptr<TokenBucket> bucket;
+
+    mutable std::mutex mutex; // Guards everything below
+    std::condition_variable queue_cv;
+    std::deque<Record> queue;
+    int active_workers = 0;
+    MemeBatchProgress progress;
+    std::vector<double> latencies_ms;
+    std::chrono::steady_clock::time_point start_time;
+    std::chrono::steady_clock::time_point end_time;
+    std::string error;
+};
+
+#endif // MEME_BATCH_H
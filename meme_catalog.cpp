@@ -0,0 +1,210 @@
+#include "meme_catalog.h"
+#include "mapped_file.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+// Function to drop all rows while keeping the allocations for a rebuild
+void MemeCatalog::Clear() {
+    string_pool.clear();
+    id_offsets.clear();
+    name_offsets.clear();
+    url_offsets.clear();
+    widths.clear();
+    heights.clear();
+    box_counts.clear();
+}
+
+// Function to reserve room for a known number of rows and string bytes
+void MemeCatalog::Reserve(size_t rows, size_t pool_bytes) {
+    string_pool.reserve(pool_bytes);
+    id_offsets.reserve(rows);
+    name_offsets.reserve(rows);
+    url_offsets.reserve(rows);
+    widths.reserve(rows);
+    heights.reserve(rows);
+    box_counts.reserve(rows);
+}
+
+// Function to copy a string into the pool and return its offset
+uint32_t MemeCatalog::AppendString(const std::string& value) {
+    uint32_t offset = static_cast<uint32_t>(string_pool.size());
+    string_pool.insert(string_pool.end(), value.begin(), value.end());
+    string_pool.push_back('\0');
+    return offset;
+}
+
+// Function to append one template row
+void MemeCatalog::Add(const std::string& id, const std::string& name, const std::string& url, int width, int height, int box_count) {
+    id_offsets.push_back(AppendString(id));
+    name_offsets.push_back(AppendString(name));
+    url_offsets.push_back(AppendString(url));
+    widths.push_back(width);
+    heights.push_back(height);
+    box_counts.push_back(box_count);
+}
+
+// Function to build the catalog from a /get_memes response
+bool BuildMemeCatalog(const nlohmann::json& response, MemeCatalog& catalog) {
+    catalog.Clear();
+
+    auto data = response.find("data");
+    if (data == response.end() || !data->is_object()) {
+        return false;
+    }
+    auto memes = data->find("memes");
+    if (memes == data->end() || !memes->is_array()) {
+        return false;
+    }
+
+    // Size the pool up front so the strings land in a single allocation
+    size_t pool_bytes = 0;
+    for (const auto& meme : *memes) {
+        for (const char* key : { "id", "name", "url" }) {
+            auto field = meme.find(key);
+            if (field != meme.end() && field->is_string()) {
+                pool_bytes += field->get_ref<const std::string&>().size() + 1;
+            }
+        }
+    }
+    catalog.Reserve(memes->size(), pool_bytes);
+
+    for (const auto& meme : *memes) {
+        if (!meme.is_object()) {
+            continue;
+        }
+        catalog.Add(meme.value("id", std::string()),
+                    meme.value("name", std::string()),
+                    meme.value("url", std::string()),
+                    meme.value("width", 0),
+                    meme.value("height", 0),
+                    meme.value("box_count", 0));
+    }
+    return true;
+}
+
+// Function to compare two catalogs row for row
+bool MemeCatalog::operator==(const MemeCatalog& other) const {
+    return string_pool == other.string_pool && id_offsets == other.id_offsets && name_offsets == other.name_offsets &&
+           url_offsets == other.url_offsets && widths == other.widths && heights == other.heights && box_counts == other.box_counts;
+}
+
+// Snapshot header, followed by the arrays in declaration order, the pool and a 32-bit FNV-1a checksum
+struct CatalogSnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t rows;
+    uint32_t pool_bytes;
+};
+
+static const char catalog_snapshot_magic[4] = { 'M', 'C', 'A', 'T' };
+static const uint32_t catalog_snapshot_version = 1;
+
+// Function to checksum a byte range
+static uint32_t SnapshotChecksum(const unsigned char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Function to append a vector's raw bytes to a buffer
+template <typename T>
+static void AppendRaw(std::vector<unsigned char>& buffer, const std::vector<T>& values) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(values.data());
+    buffer.insert(buffer.end(), bytes, bytes + values.size() * sizeof(T));
+}
+
+// Function to copy rows of raw bytes out of a snapshot into a vector
+template <typename T>
+static const unsigned char* ReadRaw(const unsigned char* cursor, size_t count, std::vector<T>& values) {
+    values.resize(count);
+    if (count > 0) {
+        memcpy(values.data(), cursor, count * sizeof(T));
+    }
+    return cursor + count * sizeof(T);
+}
+
+// Function to write the snapshot through a temporary file so a crash never leaves a torn one
+bool SaveCatalogSnapshot(const MemeCatalog& catalog, const std::string& path) {
+    CatalogSnapshotHeader header;
+    memcpy(header.magic, catalog_snapshot_magic, 4);
+    header.version = catalog_snapshot_version;
+    header.rows = static_cast<uint32_t>(catalog.Size());
+    header.pool_bytes = static_cast<uint32_t>(catalog.string_pool.size());
+
+    std::vector<unsigned char> buffer;
+    const unsigned char* header_bytes = reinterpret_cast<const unsigned char*>(&header);
+    buffer.insert(buffer.end(), header_bytes, header_bytes + sizeof(header));
+    AppendRaw(buffer, catalog.id_offsets);
+    AppendRaw(buffer, catalog.name_offsets);
+    AppendRaw(buffer, catalog.url_offsets);
+    AppendRaw(buffer, catalog.widths);
+    AppendRaw(buffer, catalog.heights);
+    AppendRaw(buffer, catalog.box_counts);
+    AppendRaw(buffer, catalog.string_pool);
+    uint32_t checksum = SnapshotChecksum(buffer.data(), buffer.size());
+
+    const std::string temp_path = path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+        out.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+        out.close();
+        if (!out) {
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temp_path, path, ec);
+    return !ec;
+}
+
+// Function to load a snapshot, returns false if it is missing, from another version or corrupt
+bool LoadCatalogSnapshot(const std::string& path, MemeCatalog& catalog) {
+    MappedFile file;
+    if (!file.Open(path) || file.Size() < sizeof(CatalogSnapshotHeader) + sizeof(uint32_t)) {
+        return false;
+    }
+
+    CatalogSnapshotHeader header;
+    memcpy(&header, file.Data(), sizeof(header));
+    if (memcmp(header.magic, catalog_snapshot_magic, 4) != 0 || header.version != catalog_snapshot_version) {
+        return false;
+    }
+    const size_t rows = header.rows;
+    const size_t expected_size = sizeof(header) + rows * (3 * sizeof(uint32_t) + 3 * sizeof(int)) + header.pool_bytes + sizeof(uint32_t);
+    if (file.Size() != expected_size) {
+        return false;
+    }
+    uint32_t checksum;
+    memcpy(&checksum, file.Data() + file.Size() - sizeof(checksum), sizeof(checksum));
+    if (checksum != SnapshotChecksum(file.Data(), file.Size() - sizeof(checksum))) {
+        return false;
+    }
+
+    MemeCatalog loaded;
+    const unsigned char* cursor = file.Data() + sizeof(header);
+    cursor = ReadRaw(cursor, rows, loaded.id_offsets);
+    cursor = ReadRaw(cursor, rows, loaded.name_offsets);
+    cursor = ReadRaw(cursor, rows, loaded.url_offsets);
+    cursor = ReadRaw(cursor, rows, loaded.widths);
+    cursor = ReadRaw(cursor, rows, loaded.heights);
+    cursor = ReadRaw(cursor, rows, loaded.box_counts);
+    ReadRaw(cursor, header.pool_bytes, loaded.string_pool);
+
+    // Every offset must land inside the pool, and the pool must end on a terminator
+    if (rows > 0 && (loaded.string_pool.empty() || loaded.string_pool.back() != '\0')) {
+        return false;
+    }
+    for (size_t row = 0; row < rows; ++row) {
+        if (loaded.id_offsets[row] >= header.pool_bytes || loaded.name_offsets[row] >= header.pool_bytes || loaded.url_offsets[row] >= header.pool_bytes) {
+            return false;
+        }
+    }
+    catalog = std::move(loaded);
+    return true;
+}
@@ -0,0 +1,48 @@
+#ifndef MEME_CATALOG_H
+#define MEME_CATALOG_H
+
+#include "json.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Typed, struct-of-arrays copy of the Imgflip template list.
+// Every string lives NUL-terminated in one contiguous pool, so rows can be
+// drawn and compared straight from the arrays without touching the JSON.
+struct MemeCatalog {
+    std::vector<char> string_pool;
+    std::vector<uint32_t> id_offsets;
+    std::vector<uint32_t> name_offsets;
+    std::vector<uint32_t> url_offsets;
+    std::vector<int> widths;
+    std::vector<int> heights;
+    std::vector<int> box_counts;
+
+    size_t Size() const { return widths.size(); }
+    bool Empty() const { return widths.empty(); }
+
+    const char* Id(size_t row) const { return string_pool.data() + id_offsets[row]; }
+    const char* Name(size_t row) const { return string_pool.data() + name_offsets[row]; }
+    const char* Url(size_t row) const { return string_pool.data() + url_offsets[row]; }
+
+    bool operator==(const MemeCatalog& other) const;
+    bool operator!=(const MemeCatalog& other) const { return !(*this == other); }
+
+    void Clear();
+    void Reserve(size_t rows, size_t pool_bytes);
+    void Add(const std::string& id, const std::string& name, const std::string& url, int width, int height, int box_count);
+
+private:
+    uint32_t AppendString(const std::string& value);
+};
+
+// Function to build the catalog from a /get_memes response, returns false if the payload is malformed
+bool BuildMemeCatalog(const nlohmann::json& response, MemeCatalog& catalog);
+
+// Functions to persist the catalog as a flat binary snapshot: a fixed header, the raw
+// arrays and the string pool, followed by a checksum. Loading is a handful of memcpys.
+bool SaveCatalogSnapshot(const MemeCatalog& catalog, const std::string& path);
+bool LoadCatalogSnapshot(const std::string& path, MemeCatalog& catalog);
+
+#endif // MEME_CATALOG_H
@@ -0,0 +1,580 @@
+#include "meme_journal.h"
+#include "mapped_file.h"
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string_view>
+#include <system_error>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Record layout: magic, payload size, checksum of the payload, then the payload itself:
+// created (int64), template id, box count, the boxes and the URL, every string as a
+// uint32 length followed by its bytes
+static const char meme_journal_magic[4] = { 'M', 'G', 'J', '1' };
+static const size_t meme_journal_header_size = 4 + 4 + 4;
+static const uint32_t meme_journal_max_payload = 1 << 20;
+
+// Function to get a new list with urls added at the end, only the last partial chunk is copied
+std::shared_ptr<const GeneratedMemeList> GeneratedMemeList::Append(std::vector<std::string> urls) const {
+    auto list = std::make_shared<GeneratedMemeList>(*this);
+    size_t next = 0;
+    if (list->size % chunk_size != 0 && !urls.empty()) {
+        auto last = std::make_shared<std::vector<std::string>>();
+        last->reserve(chunk_size);
+        *last = *list->chunks.back();
+        while (last->size() < chunk_size && next < urls.size()) {
+            last->push_back(std::move(urls[next++]));
+        }
+        list->chunks.back() = last;
+    }
+    while (next < urls.size()) {
+        auto chunk = std::make_shared<std::vector<std::string>>();
+        chunk->reserve(chunk_size);
+        const size_t end = std::min(urls.size(), next + chunk_size);
+        while (next < end) {
+            chunk->push_back(std::move(urls[next++]));
+        }
+        list->chunks.push_back(chunk);
+    }
+    list->size += urls.size();
+    return list;
+}
+
+// Function to hash a URL for UrlIndex (64-bit FNV-1a with a final mix, never 0)
+uint64_t UrlHash(std::string_view url) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : url) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    // FNV leaves the low bits poorly mixed for URLs that differ only in a few characters, and
+    // the index picks slots by the low bits, so finish with the MurmurHash3 mixer
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash ? hash : 1;
+}
+
+// Function to make room for entries at no more than half load, existing entries are rehashed
+void UrlIndex::Reserve(size_t entries) {
+    size_t size = 16;
+    while (size < entries * 2) {
+        size *= 2;
+    }
+    if (size <= slots.size()) {
+        return;
+    }
+    std::vector<Slot> old_slots(size);
+    old_slots.swap(slots);
+    const size_t mask = size - 1;
+    for (const Slot& entry : old_slots) {
+        if (entry.hash == 0) {
+            continue;
+        }
+        size_t slot = entry.hash & mask;
+        while (slots[slot].hash != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = entry;
+    }
+}
+
+void UrlIndex::Clear() {
+    slots.clear();
+    count = 0;
+}
+
+// CRC-32 (IEEE) tables for slicing by eight: table[0] is the classic byte table, table[k]
+// advances a byte that sits k positions further back
+struct Crc32Tables {
+    uint32_t table[8][256];
+
+    Crc32Tables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+            }
+            table[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int k = 1; k < 8; ++k) {
+                table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+            }
+        }
+    }
+};
+
+// Function to checksum a record payload, eight bytes per step: the scan reads every byte of
+// the journal, and a byte-at-a-time hash would be most of the load time
+static uint32_t RecordChecksum(const unsigned char* data, size_t size) {
+    static const Crc32Tables tables;
+    const auto& t = tables.table;
+    uint32_t crc = 0xFFFFFFFFu;
+    for (; size >= 8; data += 8, size -= 8) {
+        uint32_t low, high;
+        memcpy(&low, data, 4);
+        memcpy(&high, data + 4, 4);
+        low ^= crc;
+        crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24] ^
+            t[3][high & 0xff] ^ t[2][(high >> 8) & 0xff] ^ t[1][(high >> 16) & 0xff] ^ t[0][high >> 24];
+    }
+    for (; size > 0; ++data, --size) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xff];
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static void PutU32(std::string& out, uint32_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void PutString(std::string& out, const std::string& value) {
+    PutU32(out, static_cast<uint32_t>(value.size()));
+    out += value;
+}
+
+// Function to append one encoded record to out, false if the meme is too large for a record
+static bool EncodeRecord(const GeneratedMeme& meme, std::string& out) {
+    const size_t header_at = out.size();
+    out.append(meme_journal_header_size, '\0');
+    out.append(reinterpret_cast<const char*>(&meme.created), sizeof(meme.created));
+    PutString(out, meme.template_id);
+    PutU32(out, static_cast<uint32_t>(meme.text.size()));
+    for (const std::string& box : meme.text) {
+        PutString(out, box);
+    }
+    PutString(out, meme.url);
+
+    const size_t payload_size = out.size() - header_at - meme_journal_header_size;
+    if (payload_size > meme_journal_max_payload) {
+        out.resize(header_at);
+        return false;
+    }
+    const uint32_t size32 = static_cast<uint32_t>(payload_size);
+    const uint32_t checksum = RecordChecksum(reinterpret_cast<const unsigned char*>(out.data()) + header_at + meme_journal_header_size, payload_size);
+    memcpy(&out[header_at], meme_journal_magic, 4);
+    memcpy(&out[header_at + 4], &size32, sizeof(size32));
+    memcpy(&out[header_at + 8], &checksum, sizeof(checksum));
+    return true;
+}
+
+// Bounds-checked reader over one record payload
+struct RecordReader {
+    const unsigned char* cursor;
+    const unsigned char* end;
+
+    bool U32(uint32_t& value) {
+        if (end - cursor < 4) {
+            return false;
+        }
+        memcpy(&value, cursor, sizeof(value));
+        cursor += sizeof(value);
+        return true;
+    }
+    bool View(std::string_view& value) {
+        uint32_t length;
+        if (!U32(length) || length > static_cast<size_t>(end - cursor)) {
+            return false;
+        }
+        value = std::string_view(reinterpret_cast<const char*>(cursor), length);
+        cursor += length;
+        return true;
+    }
+    bool String(std::string& value) {
+        std::string_view view;
+        if (!View(view)) {
+            return false;
+        }
+        value.assign(view.data(), view.size());
+        return true;
+    }
+};
+
+// Function to decode a payload into meme, reusing its strings; url points into the payload
+static bool DecodePayload(const unsigned char* data, size_t size, GeneratedMeme& meme, std::string_view& url) {
+    RecordReader reader = { data, data + size };
+    if (size < sizeof(meme.created)) {
+        return false;
+    }
+    memcpy(&meme.created, reader.cursor, sizeof(meme.created));
+    reader.cursor += sizeof(meme.created);
+    uint32_t boxes;
+    if (!reader.String(meme.template_id) || !reader.U32(boxes) || boxes > size) {
+        return false;
+    }
+    meme.text.resize(boxes);
+    for (std::string& box : meme.text) {
+        if (!reader.String(box)) {
+            return false;
+        }
+    }
+    if (!reader.View(url) || reader.cursor != reader.end) {
+        return false;
+    }
+    meme.url.assign(url.data(), url.size());
+    return true;
+}
+
+// Function to find the next record magic at or after from, end if there is none
+static const unsigned char* FindMagic(const unsigned char* from, const unsigned char* end) {
+    while (end - from >= 4) {
+        const void* found = memchr(from, meme_journal_magic[0], static_cast<size_t>(end - from - 3));
+        if (!found) {
+            break;
+        }
+        from = static_cast<const unsigned char*>(found);
+        if (memcmp(from, meme_journal_magic, 4) == 0) {
+            return from;
+        }
+        ++from;
+    }
+    return end;
+}
+
+struct JournalScan {
+    size_t live = 0;
+    size_t dead = 0;
+    uint64_t dead_bytes = 0;
+    uint64_t damaged_bytes = 0;
+    size_t good_end = 0; // End of the last readable record
+};
+
+// Function to walk every record of a mapped journal. visit gets the record's offset and size and
+// whether it is the first with its URL; bytes that do not form a valid record are skipped.
+template <typename Visit>
+static JournalScan ScanRecords(const unsigned char* data, size_t size, Visit&& visit) {
+    JournalScan scan;
+    UrlIndex urls; // Positions are the offsets of the URL length prefixes in the file
+    urls.Reserve(size / 128);
+    GeneratedMeme meme;
+    size_t offset = 0;
+    while (offset < size) {
+        uint32_t payload_size = 0;
+        uint32_t checksum = 0;
+        std::string_view url;
+        bool ok = size - offset >= meme_journal_header_size && memcmp(data + offset, meme_journal_magic, 4) == 0;
+        if (ok) {
+            memcpy(&payload_size, data + offset + 4, sizeof(payload_size));
+            memcpy(&checksum, data + offset + 8, sizeof(checksum));
+            const unsigned char* payload = data + offset + meme_journal_header_size;
+            ok = payload_size <= meme_journal_max_payload && payload_size <= size - offset - meme_journal_header_size &&
+                checksum == RecordChecksum(payload, payload_size) && DecodePayload(payload, payload_size, meme, url);
+        }
+        if (!ok) {
+            const size_t next = static_cast<size_t>(FindMagic(data + offset + 1, data + size) - data);
+            scan.damaged_bytes += next - offset;
+            offset = next;
+            continue;
+        }
+
+        const size_t record_size = meme_journal_header_size + payload_size;
+        const uint64_t url_at = static_cast<uint64_t>(reinterpret_cast<const unsigned char*>(url.data()) - data) - 4;
+        const bool first = urls.Insert(UrlHash(url), url_at, [data, &url](uint64_t position) {
+            uint32_t length;
+            memcpy(&length, data + position, sizeof(length));
+            return std::string_view(reinterpret_cast<const char*>(data + position + 4), length) == url;
+        });
+        if (first) {
+            scan.live++;
+        }
+        else {
+            scan.dead++;
+            scan.dead_bytes += record_size;
+        }
+        visit(offset, record_size, first, meme);
+        offset += record_size;
+        scan.good_end = offset;
+    }
+    return scan;
+}
+
+// Function to push written bytes through to the disk
+static bool SyncFile(FILE* file) {
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+MemeJournal::~MemeJournal() {
+    Close();
+}
+
+// Function to start the writer thread on path, which loads the file before writing
+void MemeJournal::Open(const std::string& path, const MemeJournalOptions& options, RecordFn on_record, LoadedFn on_loaded) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) {
+        return;
+    }
+    this->path = path;
+    this->options = options;
+    running = true;
+    closing = false;
+    first_lost_sequence = 0;
+    stats = Stats();
+    writer = std::thread(&MemeJournal::Run, this, std::move(on_record), std::move(on_loaded));
+}
+
+// Function to queue one record for the next group, dropped when the journal is not open
+void MemeJournal::Append(const GeneratedMeme& meme) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running || closing) {
+            return;
+        }
+        if (!EncodeRecord(meme, pending)) {
+            std::cerr << "Generated meme too large for the journal: " << meme.url << std::endl;
+            return;
+        }
+        pending_records++;
+        appended_sequence++;
+        stats.appends++;
+    }
+    pending_cv.notify_one();
+}
+
+// Function to wait until everything appended so far was written, false if any of it was lost
+bool MemeJournal::Flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    const uint64_t target = appended_sequence;
+    written_cv.wait(lock, [this, target] { return written_sequence >= target || !running; });
+    return written_sequence >= target && (first_lost_sequence == 0 || first_lost_sequence > target);
+}
+
+// Function to flush and stop the writer thread, later appends are dropped
+void MemeJournal::Close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        closing = true;
+    }
+    pending_cv.notify_all();
+    writer.join();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+        closing = false;
+    }
+    written_cv.notify_all();
+}
+
+MemeJournal::Stats MemeJournal::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+// Function to map the file, pass the first record of every URL to on_record and cut off a
+// damaged tail. waste_bytes gets the bytes a compaction would win back.
+bool MemeJournal::ScanFile(const RecordFn& on_record, uint64_t& waste_bytes) {
+    waste_bytes = 0;
+    MappedFile mapped;
+    if (!mapped.Open(path)) {
+        std::error_code ec;
+        const bool missing = !std::filesystem::exists(path, ec) || std::filesystem::file_size(path, ec) == 0;
+        if (!missing) {
+            std::cerr << "Failed to read the generated memes journal " << path << std::endl;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.records = 0;
+        scanned_records = 0;
+        stats.dead_records = 0;
+        stats.bytes = 0;
+        stats.damaged_bytes = 0;
+        return missing;
+    }
+
+    const JournalScan scan = ScanRecords(mapped.Data(), mapped.Size(), [&on_record](size_t, size_t, bool first, const GeneratedMeme& meme) {
+        if (first && on_record) {
+            on_record(meme);
+        }
+    });
+    const uint64_t tail_bytes = mapped.Size() - scan.good_end;
+    mapped.Close();
+    if (tail_bytes > 0) {
+        std::error_code ec;
+        std::filesystem::resize_file(path, scan.good_end, ec);
+        if (ec) {
+            std::cerr << "Failed to cut the damaged end off " << path << ": " << ec.message() << std::endl;
+        }
+    }
+    waste_bytes = scan.dead_bytes + scan.damaged_bytes - tail_bytes;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.records = scan.live;
+    stats.dead_records = scan.dead;
+    stats.bytes = scan.good_end;
+    scanned_records = scan.live;
+    stats.damaged_bytes = scan.damaged_bytes;
+    return true;
+}
+
+// Function to rewrite the file with only the first record of every URL, through a temporary file
+bool MemeJournal::Compact() {
+    PROFILE_SCOPE("Compact journal");
+    MappedFile mapped;
+    if (!mapped.Open(path)) {
+        return false;
+    }
+    const std::string temp_path = path + ".tmp";
+    FILE* out = fopen(temp_path.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+    const unsigned char* data = mapped.Data();
+    bool ok = true;
+    uint64_t written_bytes = 0;
+    const JournalScan scan = ScanRecords(data, mapped.Size(), [&](size_t offset, size_t record_size, bool first, const GeneratedMeme&) {
+        if (first && ok) {
+            ok = fwrite(data + offset, 1, record_size, out) == record_size;
+            written_bytes += record_size;
+        }
+    });
+    ok = ok && fflush(out) == 0 && SyncFile(out);
+    ok = fclose(out) == 0 && ok;
+    mapped.Close();
+
+    std::error_code ec;
+    if (ok) {
+        std::filesystem::rename(temp_path, path, ec);
+    }
+    if (!ok || ec) {
+        std::filesystem::remove(temp_path, ec);
+        std::cerr << "Failed to compact the generated memes journal " << path << std::endl;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.records = scan.live;
+    stats.dead_records = 0;
+    stats.bytes = written_bytes;
+    stats.damaged_bytes = 0;
+    stats.compactions++;
+    return true;
+}
+
+// Function to decide whether a rewrite is worth it: some waste, and at least a quarter of the file
+bool MemeJournal::WorthCompacting(uint64_t waste_bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return waste_bytes > 0 && waste_bytes >= options.compact_min_bytes && waste_bytes * 4 >= stats.bytes;
+}
+
+// Function to scan the file again and compact it if enough of it is waste, the file is
+// closed meanwhile so the scan sees everything written and Windows lets it be replaced
+void MemeJournal::CheckWaste() {
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+    uint64_t waste_bytes = 0;
+    if (ScanFile(nullptr, waste_bytes) && WorthCompacting(waste_bytes)) {
+        Compact();
+    }
+    OpenForAppend();
+}
+
+void MemeJournal::OpenForAppend() {
+    file = fopen(path.c_str(), "ab");
+    if (!file) {
+        std::cerr << "Failed to open the generated memes journal " << path << std::endl;
+    }
+}
+
+// Function to load the file, then write queued records in groups until Close
+void MemeJournal::Run(RecordFn on_record, LoadedFn on_loaded) {
+    PROFILE_THREAD("meme journal");
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t waste_bytes = 0;
+    {
+        PROFILE_SCOPE("Load journal");
+        ScanFile(on_record, waste_bytes);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        stats.loaded = true;
+    }
+    if (on_loaded) {
+        on_loaded();
+    }
+    if (WorthCompacting(waste_bytes)) {
+        Compact();
+    }
+    OpenForAppend();
+
+    std::string group;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        pending_cv.wait(lock, [this] { return closing || pending_records > 0; });
+        if (pending_records == 0) {
+            break;
+        }
+        if (!closing && pending_records < options.group_records) {
+            pending_cv.wait_for(lock, std::chrono::milliseconds(options.group_window_ms),
+                [this] { return closing || pending_records >= options.group_records; });
+        }
+        group.swap(pending);
+        const size_t records = pending_records;
+        const uint64_t sequence = appended_sequence;
+        pending_records = 0;
+        lock.unlock();
+
+        if (!file) {
+            OpenForAppend(); // The last open failed, the disk may be back
+        }
+        bool written = false;
+        {
+            PROFILE_SCOPE("Write journal group");
+            written = file && fwrite(group.data(), 1, group.size(), file) == group.size() && fflush(file) == 0 && SyncFile(file);
+        }
+        if (!written) {
+            std::cerr << "Failed to write " << records << " records to the generated memes journal " << path << std::endl;
+            if (file) {
+                fclose(file); // Reopened for the next group, the scan skips whatever part of this one landed
+                file = nullptr;
+            }
+        }
+        const uint64_t group_bytes = group.size();
+        group.clear();
+
+        lock.lock();
+        if (written) {
+            stats.records += records;
+            stats.bytes += group_bytes;
+            stats.syncs++;
+        }
+        else {
+            stats.failed_writes++;
+            stats.lost_records += records;
+            if (first_lost_sequence == 0) {
+                first_lost_sequence = sequence - records + 1;
+            }
+        }
+        written_sequence = sequence;
+        appends_since_check += records;
+        written_cv.notify_all();
+        if (appends_since_check >= std::max(options.compact_check_records, scanned_records)) {
+            appends_since_check = 0;
+            lock.unlock();
+            CheckWaste();
+            lock.lock();
+        }
+    }
+    lock.unlock();
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+}
@@ -0,0 +1,172 @@
+#ifndef MEME_JOURNAL_H
+#define MEME_JOURNAL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// One meme in the generated memes history
+struct GeneratedMeme {
+    int64_t created = 0; // Unix seconds, 0 for memes imported from the old URL list
+    std::string template_id;
+    std::vector<std::string> text;
+    std::string url;
+};
+
+// Immutable list of generated meme URLs, oldest first, kept in fixed-size chunks. Append
+// returns a new list that shares every full chunk with this one, so adding a meme costs the
+// same with ten entries as with a million, and a reader holding a list never sees it change.
+class GeneratedMemeList {
+public:
+    static const size_t chunk_size = 256;
+
+    size_t Size() const { return size; }
+    bool Empty() const { return size == 0; }
+    const std::string& operator[](size_t index) const { return (*chunks[index / chunk_size])[index % chunk_size]; }
+
+    // Function to get a new list with urls added at the end, this one is left as it is
+    std::shared_ptr<const GeneratedMemeList> Append(std::vector<std::string> urls) const;
+
+private:
+    std::vector<std::shared_ptr<const std::vector<std::string>>> chunks;
+    size_t size = 0;
+};
+
+// Function to hash a URL for UrlIndex (64-bit FNV-1a with a final mix, never 0)
+uint64_t UrlHash(std::string_view url);
+
+// Open-addressing set of URLs that stores only a hash and a position per entry; the caller
+// keeps the strings and confirms a hash match through same(position). One flat array, so a
+// million URLs cost no allocations beyond the arrays and about one cache miss per lookup.
+class UrlIndex {
+public:
+    size_t Size() const { return count; }
+    void Reserve(size_t entries);
+    void Clear();
+
+    // Function to add position under hash unless an entry with the same URL is there already,
+    // returns true if it was added
+    template <typename Same>
+    bool Insert(uint64_t hash, uint64_t position, Same&& same) {
+        if ((count + 1) * 2 > slots.size()) {
+            Reserve(count + 1);
+        }
+        const size_t mask = slots.size() - 1;
+        for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+            Slot& entry = slots[slot];
+            if (entry.hash == 0) {
+                entry.hash = hash;
+                entry.position = position;
+                count++;
+                return true;
+            }
+            if (entry.hash == hash && same(entry.position)) {
+                return false;
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        uint64_t hash = 0; // 0 marks a free slot
+        uint64_t position = 0;
+    };
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+};
+
+struct MemeJournalOptions {
+    int group_window_ms = 20;            // Longest an append waits for others to share its fsync
+    size_t group_records = 256;          // A group is written as soon as it holds this many
+    uint64_t compact_min_bytes = 64 << 10; // Waste below this is never worth a rewrite
+    size_t compact_check_records = 65536; // Fewest appends between two waste checks
+};
+
+// Append-only file behind the generated memes history. Every record is a header (magic,
+// payload size and a CRC-32 of the payload) followed by the meme, so damage
+// only costs the records it touches: the scan checks every checksum and steps to the next
+// magic when one does not match, and a torn record at the end is cut off.
+// Append encodes the meme into a buffer and returns at once. One writer thread writes what
+// has collected and syncs it with a single fsync, so a burst of memes shares one disk flush.
+// A group that cannot be written or synced is counted as lost rather than retried, and Flush
+// reports it.
+// That thread first maps and scans the existing file and hands the records over, so the
+// caller never waits for the history. When a scan finds more than a quarter of the file is
+// waste (repeated URLs or damaged bytes) the live records are rewritten to a temporary file
+// that is renamed into place. The scan runs at open and again once compact_check_records
+// records or as many as the file already held have been appended, whichever is more, so the
+// checks cost a constant amount per append however long the history gets.
+class MemeJournal {
+public:
+    struct Stats {
+        size_t records = 0;       // Live records in the file
+        size_t dead_records = 0;  // Records repeating an earlier URL, dropped by compaction
+        uint64_t bytes = 0;
+        uint64_t damaged_bytes = 0; // Unreadable bytes found by the last scan, including a cut off tail
+        uint64_t appends = 0;
+        uint64_t syncs = 0;
+        uint64_t compactions = 0;
+        uint64_t failed_writes = 0; // Groups whose write or fsync failed, their records are lost
+        uint64_t lost_records = 0;
+        double load_ms = 0.0;
+        bool loaded = false;
+    };
+
+    // Function called on the writer thread for the first record of every URL, oldest first
+    typedef std::function<void(const GeneratedMeme& meme)> RecordFn;
+    // Function called on the writer thread once the scan is done, before anything is written
+    typedef std::function<void()> LoadedFn;
+
+    MemeJournal() = default;
+    ~MemeJournal();
+    MemeJournal(const MemeJournal&) = delete;
+    MemeJournal& operator=(const MemeJournal&) = delete;
+
+    // Function to start the writer thread on path, which loads the file before writing
+    void Open(const std::string& path, const MemeJournalOptions& options, RecordFn on_record, LoadedFn on_loaded);
+    void Append(const GeneratedMeme& meme);
+    // Function to wait until everything appended so far was written, false if any of it
+    // could not be written or synced
+    bool Flush();
+    // Function to flush and stop the writer thread, later appends are dropped
+    void Close();
+    Stats GetStats();
+
+private:
+    void Run(RecordFn on_record, LoadedFn on_loaded);
+    bool ScanFile(const RecordFn& on_record, uint64_t& waste_bytes);
+    bool WorthCompacting(uint64_t waste_bytes);
+    bool Compact();
+    void CheckWaste();
+    void OpenForAppend();
+
+    std::string path;
+    MemeJournalOptions options;
+    std::thread writer;
+    FILE* file = nullptr; // Only touched by the writer thread
+
+    std::mutex mutex;
+    std::condition_variable pending_cv; // Signalled on append and on close
+    std::condition_variable written_cv; // Signalled after every group
+    std::string pending;                // Encoded records not written yet
+    size_t pending_records = 0;
+    uint64_t appended_sequence = 0;
+    uint64_t written_sequence = 0;    // Last record the writer is done with, on disk or lost
+    uint64_t first_lost_sequence = 0; // First record a failed group took with it, 0 if none
+    size_t appends_since_check = 0;
+    size_t scanned_records = 0; // Live records found by the last scan
+    bool running = false;
+    bool closing = false;
+    Stats stats;
+};
+
+#endif // MEME_JOURNAL_H
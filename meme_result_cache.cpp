@@ -0,0 +1,188 @@
+#include "meme_result_cache.h"
+#include "disk_cache.h"
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+// Function to tidy caption boxes so equal captions compare equal
+std::vector<std::string> NormalizeCaptionBoxes(const std::vector<std::string>& text) {
+    std::vector<std::string> normalized;
+    normalized.reserve(text.size());
+    for (const std::string& box : text) {
+        std::string tidy;
+        tidy.reserve(box.size());
+        bool space = false;
+        for (char c : box) {
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                space = !tidy.empty();
+                continue;
+            }
+            if (space) {
+                tidy.push_back(' ');
+                space = false;
+            }
+            tidy.push_back(c);
+        }
+        normalized.push_back(std::move(tidy));
+    }
+    while (!normalized.empty() && normalized.back().empty()) {
+        normalized.pop_back();
+    }
+    return normalized;
+}
+
+// Function to get the cache key of a meme, every part ends in a zero byte so no two splits collide
+std::string MemeResultKey(const std::string& scope, const std::string& template_id, const std::vector<std::string>& normalized_text) {
+    std::string joined = scope;
+    joined.push_back('\0');
+    joined += template_id;
+    joined.push_back('\0');
+    for (const std::string& box : normalized_text) {
+        joined += box;
+        joined.push_back('\0');
+    }
+    return DiskCacheKey(joined);
+}
+
+MemeResultCache::MemeResultCache(const std::string& path)
+    : path(path) {
+}
+
+// Function to read the file once, lines that do not parse are skipped
+void MemeResultCache::LoadLocked() {
+    if (loaded) {
+        return;
+    }
+    loaded = true;
+    std::ifstream file(path, std::ios::binary);
+    std::string line;
+    while (std::getline(file, line)) {
+        const size_t split = line.find(' ');
+        if (split == std::string::npos || split == 0 || split + 1 >= line.size()) {
+            continue;
+        }
+        urls[line.substr(0, split)] = line.substr(split + 1);
+    }
+}
+
+// Function to check that a remembered meme still exists; only local files can go away under us
+bool MemeResultCache::IsUsableLocked(const std::string& url) const {
+    if (url.compare(0, 7, "file://") != 0) {
+        return true;
+    }
+    std::error_code ec;
+    return std::filesystem::exists(url.substr(7), ec);
+}
+
+// Function to get the URL for key, running make at most once across concurrent callers
+bool MemeResultCache::GetOrCreate(const std::string& key, const MakeFn& make, std::string& url, std::string& error, bool* transient, bool* cached) {
+    std::shared_ptr<Flight> flight;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        LoadLocked();
+        auto found = urls.find(key);
+        if (found != urls.end() && IsUsableLocked(found->second)) {
+            stats.hits++;
+            url = found->second;
+            if (transient) {
+                *transient = false;
+            }
+            if (cached) {
+                *cached = true;
+            }
+            return true;
+        }
+
+        auto in_flight = flights.find(key);
+        if (in_flight != flights.end()) {
+            flight = in_flight->second;
+            stats.collapsed++;
+            flight->done_cv.wait(lock, [&flight] { return flight->done; });
+            url = flight->url;
+            error = flight->error;
+            if (transient) {
+                *transient = flight->transient;
+            }
+            if (cached) {
+                *cached = flight->ok;
+            }
+            return flight->ok;
+        }
+
+        flight = std::make_shared<Flight>();
+        flights.emplace(key, flight);
+        stats.misses++;
+    }
+
+    // Ends the flight as a failure if make throws, so its waiters never hang
+    struct FlightGuard {
+        MemeResultCache* cache;
+        const std::string& key;
+        Flight& flight;
+        bool finished;
+        ~FlightGuard() {
+            if (!finished) {
+                cache->FinishFlight(key, flight, false, false, std::string(), "Meme creation failed");
+            }
+        }
+    } guard = { this, key, *flight, false };
+
+    bool made_transient = false;
+    const bool ok = make(url, error, made_transient);
+    guard.finished = true;
+    FinishFlight(key, *flight, ok, made_transient, url, error);
+    if (transient) {
+        *transient = made_transient;
+    }
+    if (cached) {
+        *cached = false;
+    }
+    return ok;
+}
+
+// Function to hand a result to the callers waiting on its flight and keep it if it succeeded
+void MemeResultCache::FinishFlight(const std::string& key, Flight& flight, bool ok, bool transient, const std::string& url, const std::string& error) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        flight.done = true;
+        flight.ok = ok;
+        flight.transient = transient;
+        flight.url = url;
+        flight.error = error;
+        flights.erase(key);
+        if (ok) {
+            urls[key] = url;
+            std::ofstream file(path, std::ios::binary | std::ios::app);
+            file << key << ' ' << url << '\n';
+        }
+    }
+    flight.done_cv.notify_all();
+}
+
+// Function to get the URL for key only if it is already cached, counted as a hit
+bool MemeResultCache::Lookup(const std::string& key, std::string& url) {
+    std::lock_guard<std::mutex> lock(mutex);
+    LoadLocked();
+    auto found = urls.find(key);
+    if (found == urls.end() || !IsUsableLocked(found->second)) {
+        return false;
+    }
+    stats.hits++;
+    url = found->second;
+    return true;
+}
+
+// Function to forget every entry and truncate the file, requests in flight still finish
+void MemeResultCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    loaded = true;
+    urls.clear();
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+}
+
+MemeResultCache::Stats MemeResultCache::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats snapshot = stats;
+    snapshot.entries = urls.size();
+    return snapshot;
+}
@@ -0,0 +1,72 @@
+#ifndef MEME_RESULT_CACHE_H
+#define MEME_RESULT_CACHE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Function to tidy caption boxes so equal captions compare equal: runs of whitespace become one
+// space, ends are trimmed and empty boxes at the end are dropped. Case is kept, it shows in the meme.
+std::vector<std::string> NormalizeCaptionBoxes(const std::vector<std::string>& text);
+// Function to get the cache key of a meme: a hash of where it is made (API origin or local),
+// the template and the normalized boxes
+std::string MemeResultKey(const std::string& scope, const std::string& template_id, const std::vector<std::string>& normalized_text);
+
+// Persistent map from meme keys to the URL made for them, with single flight: while one caller
+// makes a meme, every other caller asking for the same key waits for that result instead of
+// making it again. Only successes are kept. The file is one "key url" line per meme, appended
+// as results arrive and read once on first use; a later line for a key wins.
+class MemeResultCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;      // Answered from the cache
+        uint64_t collapsed = 0; // Waited for an identical request already in flight
+        uint64_t misses = 0;    // Made a new meme
+        size_t entries = 0;
+    };
+
+    // Function to make one meme; on failure fills error and sets transient when a retry may help
+    typedef std::function<bool(std::string& url, std::string& error, bool& transient)> MakeFn;
+
+    explicit MemeResultCache(const std::string& path);
+    MemeResultCache(const MemeResultCache&) = delete;
+    MemeResultCache& operator=(const MemeResultCache&) = delete;
+
+    // Function to get the URL for key, running make at most once across concurrent callers.
+    // cached is set when the URL came from the cache or from another caller's successful request.
+    // If make throws, the callers waiting on it fail and the exception goes on to this caller.
+    bool GetOrCreate(const std::string& key, const MakeFn& make, std::string& url, std::string& error, bool* transient, bool* cached);
+    // Function to get the URL for key only if it is already cached, counted as a hit
+    bool Lookup(const std::string& key, std::string& url);
+    // Function to forget every entry and truncate the file
+    void Clear();
+    Stats GetStats();
+
+private:
+    struct Flight {
+        std::condition_variable done_cv;
+        bool done = false;
+        bool ok = false;
+        bool transient = false;
+        std::string url;
+        std::string error;
+    };
+
+    void LoadLocked();
+    bool IsUsableLocked(const std::string& url) const;
+    void FinishFlight(const std::string& key, Flight& flight, bool ok, bool transient, const std::string& url, const std::string& error);
+
+    std::string path;
+    std::mutex mutex;
+    bool loaded = false;
+    std::unordered_map<std::string, std::string> urls;
+    std::unordered_map<std::string, std::shared_ptr<Flight>> flights;
+    Stats stats;
+};
+
+#endif // MEME_RESULT_CACHE_H
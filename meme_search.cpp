@@ -0,0 +1,123 @@
+#include "meme_search.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+// Function to pack three bytes into a trigram key
+static inline uint32_t MakeTrigram(const char* s) {
+    return (static_cast<uint32_t>(static_cast<unsigned char>(s[0])) << 16) |
+           (static_cast<uint32_t>(static_cast<unsigned char>(s[1])) << 8) |
+           static_cast<uint32_t>(static_cast<unsigned char>(s[2]));
+}
+
+// Function to drop the index
+void MemeSearchIndex::Clear() {
+    trigram_keys.clear();
+    posting_offsets.clear();
+    postings.clear();
+}
+
+// Function to build the posting lists once per catalog
+void MemeSearchIndex::Build(const MemeCatalog& catalog) {
+    Clear();
+
+    // Collect (trigram, row) pairs, then sort so each trigram's rows end up contiguous and ascending
+    std::vector<uint64_t> pairs;
+    for (size_t row = 0; row < catalog.Size(); ++row) {
+        const char* name = catalog.Name(row);
+        size_t length = strlen(name);
+        for (size_t i = 0; i + 3 <= length; ++i) {
+            pairs.push_back((static_cast<uint64_t>(MakeTrigram(name + i)) << 32) | row);
+        }
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+    postings.reserve(pairs.size());
+    for (uint64_t pair : pairs) {
+        uint32_t trigram = static_cast<uint32_t>(pair >> 32);
+        if (trigram_keys.empty() || trigram_keys.back() != trigram) {
+            trigram_keys.push_back(trigram);
+            posting_offsets.push_back(static_cast<uint32_t>(postings.size()));
+        }
+        postings.push_back(static_cast<uint32_t>(pair));
+    }
+    posting_offsets.push_back(static_cast<uint32_t>(postings.size()));
+}
+
+// Function to look up the posting list of one trigram
+bool MemeSearchIndex::FindPostings(uint32_t trigram, const uint32_t*& begin, const uint32_t*& end) const {
+    auto it = std::lower_bound(trigram_keys.begin(), trigram_keys.end(), trigram);
+    if (it == trigram_keys.end() || *it != trigram) {
+        return false;
+    }
+    size_t slot = static_cast<size_t>(it - trigram_keys.begin());
+    begin = postings.data() + posting_offsets[slot];
+    end = postings.data() + posting_offsets[slot + 1];
+    return true;
+}
+
+// Function to answer a substring query from the posting lists
+void MemeSearchIndex::Query(const MemeCatalog& catalog, const char* query, std::vector<uint32_t>& out) const {
+    out.clear();
+    size_t length = strlen(query);
+
+    // Queries too short to form a trigram fall back to a scan
+    if (length < 3) {
+        for (size_t row = 0; row < catalog.Size(); ++row) {
+            if (strstr(catalog.Name(row), query) != nullptr) {
+                out.push_back(static_cast<uint32_t>(row));
+            }
+        }
+        return;
+    }
+
+    struct PostingRange { const uint32_t* begin; const uint32_t* end; };
+    std::vector<PostingRange> ranges;
+    ranges.reserve(length - 2);
+    for (size_t i = 0; i + 3 <= length; ++i) {
+        PostingRange range;
+        if (!FindPostings(MakeTrigram(query + i), range.begin, range.end)) {
+            return; // A trigram nobody has means no match at all
+        }
+        ranges.push_back(range);
+    }
+
+    // Intersect shortest lists first so the candidate set shrinks as fast as possible
+    std::sort(ranges.begin(), ranges.end(), [](const PostingRange& a, const PostingRange& b) {
+        if ((a.end - a.begin) != (b.end - b.begin))
+            return (a.end - a.begin) < (b.end - b.begin);
+        return a.begin < b.begin;
+    });
+    out.assign(ranges[0].begin, ranges[0].end);
+    std::vector<uint32_t> scratch;
+    for (size_t i = 1; i < ranges.size() && !out.empty(); ++i) {
+        if (ranges[i].begin == ranges[i - 1].begin) {
+            continue; // Repeated trigram in the query
+        }
+        scratch.clear();
+        std::set_intersection(out.begin(), out.end(), ranges[i].begin, ranges[i].end, std::back_inserter(scratch));
+        out.swap(scratch);
+    }
+
+    // Trigrams only prove the pieces exist, confirm they are contiguous
+    out.erase(std::remove_if(out.begin(), out.end(), [&](uint32_t row) {
+        return strstr(catalog.Name(row), query) == nullptr;
+    }), out.end());
+}
+
+// Function to refresh the cached results, returns true when they were recomputed
+bool UpdateSearchResults(const MemeSearchIndex& index, const MemeCatalog& catalog, const char* query, MemeSearchResults& results) {
+    if (results.valid && results.matches.size() == catalog.Size() && results.query == query) {
+        return false;
+    }
+
+    results.query = query;
+    index.Query(catalog, query, results.rows);
+    results.matches.assign(catalog.Size(), 0);
+    for (uint32_t row : results.rows) {
+        results.matches[row] = 1;
+    }
+    results.valid = true;
+    return true;
+}
@@ -0,0 +1,41 @@
+#ifndef MEME_SEARCH_H
+#define MEME_SEARCH_H
+
+#include "meme_catalog.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Trigram posting-list index over the catalog names.
+// Postings are stored flat (CSR style): trigram_keys is sorted, and the rows
+// for trigram_keys[i] are postings[posting_offsets[i] .. posting_offsets[i + 1]).
+class MemeSearchIndex {
+public:
+    void Build(const MemeCatalog& catalog);
+    void Clear();
+
+    // Rows whose name contains the query (same case-sensitive semantics as strstr), in catalog order
+    void Query(const MemeCatalog& catalog, const char* query, std::vector<uint32_t>& out) const;
+
+private:
+    bool FindPostings(uint32_t trigram, const uint32_t*& begin, const uint32_t*& end) const;
+
+    std::vector<uint32_t> trigram_keys;
+    std::vector<uint32_t> posting_offsets;
+    std::vector<uint32_t> postings;
+};
+
+// Cached result of the last query, recomputed only when the query text changes
+struct MemeSearchResults {
+    std::string query;
+    std::vector<uint32_t> rows;         // Matching rows in catalog order
+    std::vector<unsigned char> matches; // One flag per catalog row
+    bool valid = false;
+
+    void Invalidate() { valid = false; }
+};
+
+// Function to refresh the cached results, returns true when they were recomputed
+bool UpdateSearchResults(const MemeSearchIndex& index, const MemeCatalog& catalog, const char* query, MemeSearchResults& results);
+
+#endif // MEME_SEARCH_H
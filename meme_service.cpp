@@ -0,0 +1,551 @@
+#include "meme_service.h"
+#include "caption_renderer.h"
+#include "catalog_store.h"
+#include "http_pool.h"
+#include "image_pipeline.h"
+#include "meme_journal.h"
+#include "meme_result_cache.h"
+#include "json.hpp"
+#include "profiler.h"
+#include "wake_signal.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+const char* meme_catalog_snapshot_path = "meme_catalog.bin"; // Last good catalog, loaded at startup
+static std::thread meme_data_thread; // Background catalog load, see StartMemeDataFetch
+static std::atomic<bool> meme_data_running(false);
+const char* rendered_memes_directory = "rendered_memes"; // Memes made by the local caption renderer
+const char* meme_results_path = "meme_results.txt"; // Result cache, see CaptionMeme
+const char* generated_memes_journal_path = "generated_memes.journal"; // History, see MemeJournal
+static const char* generated_memes_legacy_path = "generated_memes.txt"; // Plain URL list from before the journal
+static std::atomic<int> local_meme_rendering(-1); // -1 until MEME_RENDER has been read
+
+// Decoded templates kept for the local renderer, so a batch on a few templates decodes each once
+static const size_t rendered_template_limit = 16;
+static std::mutex rendered_template_mutex;
+static std::deque<std::pair<std::string, std::shared_ptr<const DecodedImage>>> rendered_templates; // Most recently used first
+
+// Generated meme URLs, republished as a new immutable list on every append like the catalog.
+// The index answers "already listed?" without walking the list, its positions are list indices.
+static std::mutex generated_memes_mutex;
+static std::shared_ptr<const GeneratedMemeList> generated_memes = std::make_shared<const GeneratedMemeList>();
+static UrlIndex generated_meme_index;
+static std::vector<std::string> loaded_meme_urls; // Filled by the journal scan, published once it ends
+static bool generated_memes_loaded = false;
+
+// Submission queue behind SubmitMeme. Finished submissions stay listed until dismissed.
+static const int meme_submission_workers = 2;
+static std::mutex submission_mutex;
+static std::condition_variable submission_cv;
+static std::deque<uint64_t> submission_queue; // Tickets still waiting for a worker
+static std::vector<MemeSubmission> submissions; // Oldest first
+static std::vector<std::thread> submission_threads;
+static uint64_t next_submission_ticket = 1;
+static bool submissions_stopping = false;
+
+// Function to publish the saved catalog and then fetch the current one from the Imgflip API
+void FetchMemeData() {
+    if (GetLoadedCatalog()->catalog.Empty()) {
+        LoadCatalogFromSnapshot(meme_catalog_snapshot_path);
+    }
+    RefreshCatalog(meme_catalog_snapshot_path);
+}
+
+// Function to run FetchMemeData on a background thread, ignored while a fetch is still running
+void StartMemeDataFetch() {
+    if (meme_data_running.exchange(true)) {
+        return;
+    }
+    StopMemeDataFetch();
+    meme_data_thread = std::thread([] {
+        PROFILE_THREAD("catalog");
+        FetchMemeData();
+        meme_data_running = false;
+    });
+}
+
+// Function to wait for the background fetch, bounded by the HTTP pool's timeouts
+void StopMemeDataFetch() {
+    if (meme_data_thread.joinable()) {
+        meme_data_thread.join();
+    }
+}
+
+// Function to publish the history read from the journal. Memes made while it loaded are kept
+// after it, unless the journal already had them.
+static void PublishLoadedMemes() {
+    {
+        std::lock_guard<std::mutex> lock(generated_memes_mutex);
+        UrlIndex index;
+        index.Reserve(loaded_meme_urls.size() + generated_memes->Size());
+        for (size_t i = 0; i < loaded_meme_urls.size(); ++i) {
+            const std::string& url = loaded_meme_urls[i];
+            index.Insert(UrlHash(url), i, [&url](uint64_t position) { return loaded_meme_urls[position] == url; });
+        }
+        for (size_t i = 0; i < generated_memes->Size(); ++i) {
+            const std::string& url = (*generated_memes)[i];
+            if (index.Insert(UrlHash(url), loaded_meme_urls.size(), [&url](uint64_t position) { return loaded_meme_urls[position] == url; })) {
+                loaded_meme_urls.push_back(url);
+            }
+        }
+        generated_memes = std::make_shared<const GeneratedMemeList>()->Append(std::move(loaded_meme_urls));
+        std::swap(generated_meme_index, index);
+        loaded_meme_urls = std::vector<std::string>();
+        generated_memes_loaded = true;
+    }
+    WakeRenderLoop();
+}
+
+// Function to copy the old generated_memes.txt into a journal that did not exist yet
+static void ImportLegacyMemes(MemeJournal& journal) {
+    std::ifstream file(generated_memes_legacy_path);
+    std::unordered_set<std::string> imported;
+    std::string url;
+    while (std::getline(file, url)) {
+        if (!url.empty() && url.back() == '\r') {
+            url.pop_back();
+        }
+        if (url.empty() || !imported.insert(url).second) {
+            continue;
+        }
+        GeneratedMeme meme;
+        meme.url = url;
+        journal.Append(meme);
+        loaded_meme_urls.push_back(url);
+    }
+}
+
+static std::atomic<bool> generated_memes_journal_opened(false); // Set once GetGeneratedMemeJournal opened it
+
+// Function to get the history journal, opened on first use; the load runs on its writer thread
+static MemeJournal& GetGeneratedMemeJournal() {
+    static MemeJournal journal;
+    static std::once_flag opened;
+    std::call_once(opened, [] {
+        generated_memes_journal_opened = true;
+        std::error_code ec;
+        const bool import_legacy = !std::filesystem::exists(generated_memes_journal_path, ec) && std::filesystem::exists(generated_memes_legacy_path, ec);
+        journal.Open(generated_memes_journal_path, MemeJournalOptions(),
+            [](const GeneratedMeme& meme) { loaded_meme_urls.push_back(meme.url); },
+            [import_legacy] {
+                if (import_legacy) {
+                    ImportLegacyMemes(journal);
+                }
+                PublishLoadedMemes();
+            });
+    });
+    return journal;
+}
+
+// Function to start reading the generated memes history in the background
+void StartGeneratedMemesLoad() {
+    GetGeneratedMemeJournal();
+}
+
+// Function to write out the history journal and stop its thread, a journal never opened is left alone
+void StopGeneratedMemes() {
+    if (generated_memes_journal_opened) {
+        GetGeneratedMemeJournal().Close();
+    }
+}
+
+// Function to get the generated memes, oldest first
+std::shared_ptr<const GeneratedMemeList> GetGeneratedMemes() {
+    std::lock_guard<std::mutex> lock(generated_memes_mutex);
+    return generated_memes;
+}
+
+// Function to check whether the history is still being read from the journal
+bool GeneratedMemesLoading() {
+    std::lock_guard<std::mutex> lock(generated_memes_mutex);
+    return !generated_memes_loaded;
+}
+
+MemeJournal::Stats GetGeneratedMemeJournalStats() {
+    return GetGeneratedMemeJournal().GetStats();
+}
+
+// Function to add a generated meme to the history and append it to the journal, a URL already
+// listed is not added again. Neither step depends on how long the history is.
+static void AddGeneratedMeme(const std::string& template_id, const std::vector<std::string>& text, const std::string& url) {
+    MemeJournal& journal = GetGeneratedMemeJournal();
+    {
+        std::lock_guard<std::mutex> lock(generated_memes_mutex);
+        const auto listed = [&url](uint64_t position) { return (*generated_memes)[position] == url; };
+        if (!generated_meme_index.Insert(UrlHash(url), generated_memes->Size(), listed)) {
+            return;
+        }
+        generated_memes = generated_memes->Append({ url });
+    }
+    GeneratedMeme meme;
+    meme.created = static_cast<int64_t>(std::time(nullptr));
+    meme.template_id = template_id;
+    meme.text = text;
+    meme.url = url;
+    journal.Append(meme);
+    WakeRenderLoop();
+}
+
+// Function to POST a caption request, returns the meme URL or fills error.
+// transient is set when the failure may go away on a retry: no response, 429 or a 5xx status.
+bool PostCaption(const std::string& template_id, const std::vector<std::string>& text, std::string& url, std::string& error, bool* transient) {
+    if (transient) {
+        *transient = false;
+    }
+    std::string username = "welovecpp";
+    std::string password = "welovecpp";
+
+    httplib::Params params;
+    params.emplace("template_id", template_id);
+    params.emplace("username", username);
+    params.emplace("password", password);
+    for (size_t i = 0; i < text.size(); ++i) {
+        params.emplace("boxes[" + std::to_string(i) + "][text]", text[i]);
+    }
+
+    auto res = GetHttpClientPool().Post(GetApiOrigin(), "/caption_image", params);
+    if (!res) {
+        error = "No response from server: " + httplib::to_string(res.error());
+        if (transient) {
+            *transient = true;
+        }
+        return false;
+    }
+    if (res->status != 200) {
+        error = "HTTP status " + std::to_string(res->status);
+        if (transient) {
+            *transient = res->status == 429 || res->status >= 500;
+        }
+        return false;
+    }
+    // Only look at fields of the type imgflip documents, anything else in a 200 body is a failed request
+    nlohmann::json json_response = nlohmann::json::parse(res->body, nullptr, false);
+    if (json_response.is_discarded() || !json_response.is_object()) {
+        error = "Malformed response";
+        return false;
+    }
+    auto success = json_response.find("success");
+    if (success == json_response.end() || !success->is_boolean() || !success->get<bool>()) {
+        auto message = json_response.find("error_message");
+        error = message != json_response.end() && message->is_string() ? message->get<std::string>() : "Request was not successful";
+        return false;
+    }
+    auto data = json_response.find("data");
+    if (data != json_response.end() && data->is_object()) {
+        auto data_url = data->find("url");
+        if (data_url != data->end() && data_url->is_string()) {
+            url = data_url->get<std::string>();
+        }
+    }
+    if (url.empty()) {
+        error = "Response has no URL";
+        return false;
+    }
+    return true;
+}
+
+// Function to choose between the local caption renderer and /caption_image for every new meme
+void SetLocalMemeRendering(bool enabled) {
+    local_meme_rendering = enabled ? 1 : 0;
+}
+
+// Function to check which way memes are made, MEME_RENDER=local turns local rendering on at startup
+bool GetLocalMemeRendering() {
+    if (local_meme_rendering < 0) {
+        const char* mode = std::getenv("MEME_RENDER");
+        int expected = -1;
+        local_meme_rendering.compare_exchange_strong(expected, mode && std::string(mode) == "local" ? 1 : 0);
+    }
+    return local_meme_rendering == 1;
+}
+
+// Function to get the process-wide renderer, loading the first font FindCaptionFont finds
+static CaptionRenderer& GetCaptionRenderer() {
+    static CaptionRenderer renderer;
+    static std::once_flag font_loaded;
+    std::call_once(font_loaded, [] {
+        const std::string path = FindCaptionFont();
+        if (path.empty() || !renderer.LoadFont(path)) {
+            std::cerr << "No caption font found, set MEME_CAPTION_FONT to a .ttf file" << std::endl;
+        }
+    });
+    return renderer;
+}
+
+// Function to get a template's decoded image, from the small in-memory cache or through the image disk cache
+static std::shared_ptr<const DecodedImage> GetTemplateImage(const std::string& template_id, std::string& error) {
+    {
+        std::lock_guard<std::mutex> lock(rendered_template_mutex);
+        for (auto it = rendered_templates.begin(); it != rendered_templates.end(); ++it) {
+            if (it->first == template_id) {
+                auto found = *it;
+                rendered_templates.erase(it);
+                rendered_templates.push_front(found);
+                return found.second;
+            }
+        }
+    }
+
+    std::string template_url;
+    std::shared_ptr<const LoadedCatalog> loaded = GetLoadedCatalog();
+    for (size_t row = 0; row < loaded->catalog.Size(); ++row) {
+        if (template_id == loaded->catalog.Id(row)) {
+            template_url = loaded->catalog.Url(row);
+            break;
+        }
+    }
+    if (template_url.empty()) {
+        error = "Template " + template_id + " is not in the catalog";
+        return nullptr;
+    }
+    ImageBytes bytes;
+    auto image = std::make_shared<DecodedImage>();
+    if (!FetchImageBytes(template_url, bytes) || !DecodeImage(bytes.Data(), bytes.Size(), *image)) {
+        error = "Cannot load the template image " + template_url;
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(rendered_template_mutex);
+    rendered_templates.emplace_front(template_id, image);
+    if (rendered_templates.size() > rendered_template_limit) {
+        rendered_templates.pop_back();
+    }
+    return image;
+}
+
+// Function to caption a template without the API. The meme is written as a binary PPM, which
+// stb_image reads back, named after a hash of its template and text, and returned as a file:// URL.
+bool RenderCaptionLocally(const std::string& template_id, const std::vector<std::string>& text, std::string& url, std::string& error) {
+    PROFILE_SCOPE("Render meme locally");
+    CaptionRenderer& renderer = GetCaptionRenderer();
+    if (!renderer.HasFont()) {
+        error = "No caption font";
+        return false;
+    }
+    std::shared_ptr<const DecodedImage> template_image = GetTemplateImage(template_id, error);
+    if (!template_image) {
+        return false;
+    }
+    DecodedImage meme;
+    meme.width = template_image->width;
+    meme.height = template_image->height;
+    meme.pixels.assign(template_image->pixels.begin(), template_image->pixels.begin() + static_cast<size_t>(meme.width) * meme.height * 4);
+    if (!renderer.Render(meme, text)) {
+        error = "Cannot render the caption";
+        return false;
+    }
+
+    uint64_t hash = 1469598103934665603ull; // FNV-1a over the template id and every box, each ending in a zero byte
+    auto add = [&hash](const std::string& value) {
+        for (size_t i = 0; i <= value.size(); ++i) {
+            hash = (hash ^ static_cast<unsigned char>(i < value.size() ? value[i] : 0)) * 1099511628211ull;
+        }
+    };
+    add(template_id);
+    for (const std::string& box : text) {
+        add(box);
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.ppm", static_cast<unsigned long long>(hash));
+    std::error_code ec;
+    std::filesystem::create_directories(rendered_memes_directory, ec);
+    const std::string path = std::string(rendered_memes_directory) + "/" + name;
+
+    std::string ppm = "P6\n" + std::to_string(meme.width) + " " + std::to_string(meme.height) + "\n255\n";
+    const size_t header = ppm.size();
+    ppm.resize(header + static_cast<size_t>(meme.width) * meme.height * 3);
+    for (size_t pixel = 0; pixel < static_cast<size_t>(meme.width) * meme.height; ++pixel) {
+        memcpy(&ppm[header + pixel * 3], &meme.pixels[pixel * 4], 3);
+    }
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(ppm.data(), ppm.size());
+    if (!file) {
+        error = "Cannot write " + path;
+        return false;
+    }
+    url = "file://" + path;
+    return true;
+}
+
+// Function to get the result cache behind CaptionMeme
+static MemeResultCache& GetMemeResultCache() {
+    static MemeResultCache cache(meme_results_path);
+    return cache;
+}
+
+// Function to get the result cache key of a meme made the current way
+static std::string CurrentMemeResultKey(const std::string& template_id, const std::vector<std::string>& normalized_text) {
+    return MemeResultKey(GetLocalMemeRendering() ? "local" : GetApiOrigin(), template_id, normalized_text);
+}
+
+// Function to look a meme up in the result cache without making it
+bool FindCachedMeme(const std::string& template_id, const std::vector<std::string>& text, std::string& url) {
+    return GetMemeResultCache().Lookup(CurrentMemeResultKey(template_id, NormalizeCaptionBoxes(text)), url);
+}
+
+// Function to make one meme the current way, locally or through the API. transient is as for PostCaption.
+// The same template and captions made the same way before, or being made right now, are answered from the
+// result cache and set cached instead of making the meme again.
+bool CaptionMeme(const std::string& template_id, const std::vector<std::string>& text, std::string& url, std::string& error, bool* transient, bool* cached) {
+    const bool local = GetLocalMemeRendering();
+    const std::vector<std::string> boxes = NormalizeCaptionBoxes(text);
+    const std::string key = CurrentMemeResultKey(template_id, boxes);
+    return GetMemeResultCache().GetOrCreate(key, [&](std::string& made_url, std::string& made_error, bool& made_transient) {
+        if (local) {
+            return RenderCaptionLocally(template_id, boxes, made_url, made_error);
+        }
+        return PostCaption(template_id, boxes, made_url, made_error, &made_transient);
+    }, url, error, transient, cached);
+}
+
+// Function to get the result cache counters
+MemeResultCache::Stats GetMemeResultCacheStats() {
+    return GetMemeResultCache().GetStats();
+}
+
+// Function to forget every cached meme, the next request for each is made again
+void ClearMemeResultCache() {
+    GetMemeResultCache().Clear();
+}
+
+// Function to create a meme, blocks for the whole round trip unless the result is cached
+std::string CreateMeme(const std::string& template_id, const std::vector<std::string>& text) {
+    std::string url, error;
+    bool cached = false;
+    if (!CaptionMeme(template_id, text, url, error, nullptr, &cached)) {
+        std::cerr << "Failed to create meme: " << error << std::endl;
+        return "";
+    }
+    std::cout << (cached ? "Meme found in the result cache: " : "Meme created successfully: ") << url << std::endl;
+    AddGeneratedMeme(template_id, text, url);
+    return url;
+}
+
+// Function to find a submission by ticket, null if it was dismissed
+static MemeSubmission* FindSubmissionLocked(uint64_t ticket) {
+    for (MemeSubmission& submission : submissions) {
+        if (submission.ticket == ticket) {
+            return &submission;
+        }
+    }
+    return nullptr;
+}
+
+// Function to run queued submissions until StopMemeSubmissions
+static void SubmissionWorker() {
+    PROFILE_THREAD("meme submit");
+    std::unique_lock<std::mutex> lock(submission_mutex);
+    while (true) {
+        submission_cv.wait(lock, [] { return submissions_stopping || !submission_queue.empty(); });
+        if (submissions_stopping) {
+            return;
+        }
+        const uint64_t ticket = submission_queue.front();
+        submission_queue.pop_front();
+        MemeSubmission* submission = FindSubmissionLocked(ticket);
+        if (!submission) {
+            continue;
+        }
+        submission->state = MemeSubmissionState_InFlight;
+        const std::string template_id = submission->template_id;
+        const std::vector<std::string> text = submission->text;
+        lock.unlock();
+        WakeRenderLoop();
+
+        std::string url, error;
+        bool ok;
+        bool cached = false;
+        {
+            PROFILE_SCOPE("Create meme");
+            // A throw here would end the worker with the submission stuck in flight, so it fails instead
+            try {
+                ok = CaptionMeme(template_id, text, url, error, nullptr, &cached);
+            }
+            catch (const std::exception& e) {
+                ok = false;
+                url.clear();
+                error = std::string("Unexpected error: ") + e.what();
+            }
+        }
+        if (ok) {
+            AddGeneratedMeme(template_id, text, url);
+        }
+        else {
+            std::cerr << "Failed to create meme: " << error << std::endl;
+        }
+
+        lock.lock();
+        submission = FindSubmissionLocked(ticket);
+        if (submission) {
+            submission->state = ok ? MemeSubmissionState_Done : MemeSubmissionState_Failed;
+            submission->url = url;
+            submission->error = error;
+            submission->cached = cached;
+        }
+        WakeRenderLoop();
+    }
+}
+
+// Function to queue a meme for creation in the background, returns its ticket straight away
+uint64_t SubmitMeme(const std::string& template_id, const std::vector<std::string>& text) {
+    uint64_t ticket;
+    {
+        std::lock_guard<std::mutex> lock(submission_mutex);
+        if (submission_threads.empty()) {
+            submissions_stopping = false;
+            for (int i = 0; i < meme_submission_workers; ++i) {
+                submission_threads.emplace_back(SubmissionWorker);
+            }
+        }
+        ticket = next_submission_ticket++;
+        MemeSubmission submission;
+        submission.ticket = ticket;
+        submission.template_id = template_id;
+        submission.text = text;
+        submissions.push_back(std::move(submission));
+        submission_queue.push_back(ticket);
+    }
+    submission_cv.notify_one();
+    return ticket;
+}
+
+// Function to snapshot every submission that has not been dismissed, oldest first
+std::vector<MemeSubmission> GetMemeSubmissions() {
+    std::lock_guard<std::mutex> lock(submission_mutex);
+    return submissions;
+}
+
+// Function to drop finished submissions from the list, queued and in-flight ones stay
+void DismissFinishedSubmissions() {
+    std::lock_guard<std::mutex> lock(submission_mutex);
+    submissions.erase(std::remove_if(submissions.begin(), submissions.end(), [](const MemeSubmission& submission) {
+        return submission.state == MemeSubmissionState_Done || submission.state == MemeSubmissionState_Failed;
+    }), submissions.end());
+}
+
+// Function to stop the workers, waiting for requests in flight; queued submissions are dropped
+void StopMemeSubmissions() {
+    {
+        std::lock_guard<std::mutex> lock(submission_mutex);
+        submissions_stopping = true;
+        submission_queue.clear();
+    }
+    submission_cv.notify_all();
+    for (std::thread& thread : submission_threads) {
+        thread.join();
+    }
+    submission_threads.clear();
+}
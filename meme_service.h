@@ -0,0 +1,65 @@
+#ifndef MEME_SERVICE_H
+#define MEME_SERVICE_H
+
+#include "meme_journal.h"
+#include "meme_result_cache.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Imgflip calls and the files the app keeps next to them, free of any UI or GPU code
+extern const char* meme_catalog_snapshot_path;
+extern const char* rendered_memes_directory;
+extern const char* meme_results_path;
+extern const char* generated_memes_journal_path;
+
+enum MemeSubmissionState {
+    MemeSubmissionState_Queued,
+    MemeSubmissionState_InFlight,
+    MemeSubmissionState_Done,
+    MemeSubmissionState_Failed,
+};
+
+// One meme handed to SubmitMeme, identified by its ticket
+struct MemeSubmission {
+    uint64_t ticket = 0;
+    std::string template_id;
+    std::vector<std::string> text;
+    MemeSubmissionState state = MemeSubmissionState_Queued;
+    std::string url;   // Set once Done
+    std::string error; // Set once Failed
+    bool cached = false; // Done straight from the result cache
+};
+
+void FetchMemeData();
+void StartMemeDataFetch();
+void StopMemeDataFetch();
+// Generated memes history, kept in an append-only journal that is read in the background at
+// startup. Memes made before the load ends are listed straight away and kept after it.
+void StartGeneratedMemesLoad();
+void StopGeneratedMemes();
+std::shared_ptr<const GeneratedMemeList> GetGeneratedMemes();
+bool GeneratedMemesLoading();
+MemeJournal::Stats GetGeneratedMemeJournalStats();
+bool PostCaption(const std::string& template_id, const std::vector<std::string>& text, std::string& url, std::string& error, bool* transient = nullptr);
+bool RenderCaptionLocally(const std::string& template_id, const std::vector<std::string>& text, std::string& url, std::string& error);
+void SetLocalMemeRendering(bool enabled);
+bool GetLocalMemeRendering();
+// Function to make one meme with the local renderer when it is on, with /caption_image otherwise.
+// Identical requests are deduplicated through a persistent result cache, see MemeResultCache.
+bool CaptionMeme(const std::string& template_id, const std::vector<std::string>& text, std::string& url, std::string& error, bool* transient = nullptr, bool* cached = nullptr);
+bool FindCachedMeme(const std::string& template_id, const std::vector<std::string>& text, std::string& url);
+MemeResultCache::Stats GetMemeResultCacheStats();
+void ClearMemeResultCache();
+std::string CreateMeme(const std::string& template_id, const std::vector<std::string>& text);
+
+// Background creation: SubmitMeme returns at once, a small worker pool runs the requests in
+// order of submission and adds each result to the generated memes. The render loop is woken
+// on every state change, so the UI only needs to poll GetMemeSubmissions while drawing.
+uint64_t SubmitMeme(const std::string& template_id, const std::vector<std::string>& text);
+std::vector<MemeSubmission> GetMemeSubmissions();
+void DismissFinishedSubmissions();
+void StopMemeSubmissions();
+
+#endif // MEME_SERVICE_H
@@ -0,0 +1,143 @@
+#include "meme_sort.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+// Function to compare ids numerically when both are plain digit strings, bytewise otherwise
+static int CompareIdKeys(const char* a, const char* b) {
+    size_t len_a = strlen(a), len_b = strlen(b);
+    bool digits_a = len_a > 0 && strspn(a, "0123456789") == len_a;
+    bool digits_b = len_b > 0 && strspn(b, "0123456789") == len_b;
+    if (digits_a && digits_b) {
+        while (len_a > 1 && *a == '0') { ++a; --len_a; }
+        while (len_b > 1 && *b == '0') { ++b; --len_b; }
+        if (len_a != len_b)
+            return len_a < len_b ? -1 : +1;
+    }
+    return strcmp(a, b);
+}
+
+// Function to compare names case-insensitively
+static int CompareNameKeys(const char* a, const char* b) {
+    for (;; ++a, ++b) {
+        int ca = tolower(static_cast<unsigned char>(*a));
+        int cb = tolower(static_cast<unsigned char>(*b));
+        if (ca != cb || ca == 0)
+            return ca - cb;
+    }
+}
+
+// Function to turn a string column into dense ranks, so equal keys get equal ranks
+template <typename Accessor, typename Compare>
+static void BuildRanks(size_t rows, Accessor get, Compare compare, std::vector<uint32_t>& ranks) {
+    std::vector<uint32_t> order(rows);
+    for (size_t i = 0; i < rows; ++i) {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return compare(get(a), get(b)) < 0;
+    });
+
+    ranks.assign(rows, 0);
+    uint32_t rank = 0;
+    for (size_t i = 0; i < rows; ++i) {
+        if (i > 0 && compare(get(order[i - 1]), get(order[i])) != 0)
+            ++rank;
+        ranks[order[i]] = rank;
+    }
+}
+
+// Function to precompute the string column ranks for a catalog
+void MemeSortKeys::Build(const MemeCatalog& catalog) {
+    BuildRanks(catalog.Size(), [&](uint32_t row) { return catalog.Id(row); }, CompareIdKeys, id_ranks);
+    BuildRanks(catalog.Size(), [&](uint32_t row) { return catalog.Name(row); }, CompareNameKeys, name_ranks);
+}
+
+// Function to drop the precomputed keys
+void MemeSortKeys::Clear() {
+    id_ranks.clear();
+    name_ranks.clear();
+}
+
+// Function to check whether a column has sort keys
+static bool IsSortableColumn(int column) {
+    return column == MemeSortColumn_Id || column == MemeSortColumn_Name || column == MemeSortColumn_Width ||
+           column == MemeSortColumn_Height || column == MemeSortColumn_BoxCount;
+}
+
+// Function to map a signed column value to an unsigned key with the same ordering
+static inline uint32_t SignedKey(int value) {
+    return static_cast<uint32_t>(value) ^ 0x80000000u;
+}
+
+// Function to stable-sort order by a 32-bit key using LSD radix passes of 8 bits.
+// Passes whose byte is the same for every row are skipped.
+static void RadixSortByKey(std::vector<uint32_t>& order, std::vector<uint32_t>& scratch, std::vector<uint32_t>& keys, std::vector<uint32_t>& key_scratch) {
+    const size_t count = order.size();
+    uint32_t histograms[4][256] = {};
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t key = keys[i];
+        histograms[0][key & 0xff]++;
+        histograms[1][(key >> 8) & 0xff]++;
+        histograms[2][(key >> 16) & 0xff]++;
+        histograms[3][key >> 24]++;
+    }
+
+    scratch.resize(count);
+    key_scratch.resize(count);
+    for (int pass = 0; pass < 4; ++pass) {
+        uint32_t* histogram = histograms[pass];
+        const int shift = pass * 8;
+        if (histogram[(keys[0] >> shift) & 0xff] == count)
+            continue;
+
+        uint32_t offset = 0;
+        for (int bucket = 0; bucket < 256; ++bucket) {
+            uint32_t bucket_count = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucket_count;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t slot = histogram[(keys[i] >> shift) & 0xff]++;
+            scratch[slot] = order[i];
+            key_scratch[slot] = keys[i];
+        }
+        order.swap(scratch);
+        keys.swap(key_scratch);
+    }
+}
+
+// Function to fill order with a permutation of the catalog rows sorted by specs
+void SortMemeRows(const MemeCatalog& catalog, const MemeSortKeys& keys, const MemeSortSpec* specs, int specs_count, std::vector<uint32_t>& order) {
+    const size_t count = catalog.Size();
+    order.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    if (count < 2) {
+        return;
+    }
+
+    // Stable passes from the least significant spec to the most significant one
+    // compose into a multi-column sort
+    std::vector<uint32_t> scratch, sort_keys(count), key_scratch;
+    for (int n = specs_count - 1; n >= 0; --n) {
+        const MemeSortSpec& spec = specs[n];
+        if (!IsSortableColumn(spec.column))
+            continue;
+        const uint32_t flip = spec.descending ? 0xffffffffu : 0u;
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t row = order[i];
+            uint32_t key = 0;
+            switch (spec.column) {
+            case MemeSortColumn_Id: key = keys.id_ranks[row]; break;
+            case MemeSortColumn_Name: key = keys.name_ranks[row]; break;
+            case MemeSortColumn_Width: key = SignedKey(catalog.widths[row]); break;
+            case MemeSortColumn_Height: key = SignedKey(catalog.heights[row]); break;
+            case MemeSortColumn_BoxCount: key = SignedKey(catalog.box_counts[row]); break;
+            }
+            sort_keys[i] = key ^ flip;
+        }
+        RadixSortByKey(order, scratch, sort_keys, key_scratch);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef MEME_SORT_H
+#define MEME_SORT_H
+
+#include "meme_catalog.h"
+#include <cstdint>
+#include <vector>
+
+// Columns of the meme table, used as their user IDs so sort specs survive reordering.
+// Image and Actions have no sort keys.
+enum MemeSortColumn {
+    MemeSortColumn_Id = 0,
+    MemeSortColumn_Name = 1,
+    MemeSortColumn_Image = 2,
+    MemeSortColumn_Width = 3,
+    MemeSortColumn_Height = 4,
+    MemeSortColumn_BoxCount = 5,
+    MemeSortColumn_Actions = 6,
+};
+
+struct MemeSortSpec {
+    int column;
+    bool descending;
+};
+
+// Integer sort keys precomputed once per catalog.
+// Strings are replaced by their rank under a normalized ordering: ids compare
+// numerically when they are all digits, names compare case-insensitively.
+// Equal strings share a rank so the composite sort stays stable across them.
+struct MemeSortKeys {
+    std::vector<uint32_t> id_ranks;
+    std::vector<uint32_t> name_ranks;
+
+    void Build(const MemeCatalog& catalog);
+    void Clear();
+};
+
+// Function to fill order with a permutation of the catalog rows sorted by specs (first spec is primary).
+// The catalog is only read, never reordered.
+void SortMemeRows(const MemeCatalog& catalog, const MemeSortKeys& keys, const MemeSortSpec* specs, int specs_count, std::vector<uint32_t>& order);
+
+#endif // MEME_SORT_H
@@ -0,0 +1,143 @@
+#include "net_telemetry.h"
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+
+static const double histogram_first_edge_ms = 0.125;
+static const double histogram_growth = 1.25;
+static const size_t recent_request_limit = 128;
+
+static std::mutex telemetry_mutex;
+static std::unordered_map<std::string, HostTelemetry> host_telemetry;
+static std::deque<RequestTiming> recent_requests;
+
+// Function to add one sample
+void LatencyHistogram::Add(double ms) {
+    if (ms < 0.0) {
+        return;
+    }
+    int bucket = 0;
+    if (ms >= histogram_first_edge_ms) {
+        bucket = static_cast<int>(std::log(ms / histogram_first_edge_ms) / std::log(histogram_growth)) + 1;
+        bucket = std::min(bucket, bucket_count - 1);
+    }
+    buckets[bucket]++;
+    count++;
+    max_ms = std::max(max_ms, ms);
+}
+
+// Function to estimate a percentile, fraction in [0, 1]
+double LatencyHistogram::Percentile(double fraction) const {
+    if (count == 0) {
+        return 0.0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * count)));
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < bucket_count; ++bucket) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            return std::min(histogram_first_edge_ms * std::pow(histogram_growth, bucket), max_ms);
+        }
+    }
+    return max_ms;
+}
+
+// Function to get the display name of a phase
+const char* NetPhaseName(int phase) {
+    static const char* const names[NetPhase_COUNT] = { "DNS", "Connect", "TLS", "TTFB", "Transfer", "Total" };
+    return phase >= 0 && phase < NetPhase_COUNT ? names[phase] : "?";
+}
+
+// Function to add one finished request to its host's histograms and the recent request list
+void RecordRequestTiming(const RequestTiming& timing) {
+    std::lock_guard<std::mutex> lock(telemetry_mutex);
+    HostTelemetry& host = host_telemetry[timing.origin];
+    host.origin = timing.origin;
+    host.requests++;
+    host.failures += timing.status == 0 || timing.status >= 400;
+    host.retries += timing.retries;
+    host.reused += timing.reused;
+    host.bytes += timing.bytes;
+    host.phases[NetPhase_Dns].Add(timing.dns_ms);
+    host.phases[NetPhase_Connect].Add(timing.connect_ms);
+    host.phases[NetPhase_Tls].Add(timing.tls_ms);
+    host.phases[NetPhase_Ttfb].Add(timing.ttfb_ms);
+    host.phases[NetPhase_Transfer].Add(timing.transfer_ms);
+    host.phases[NetPhase_Total].Add(timing.total_ms);
+
+    recent_requests.push_back(timing);
+    if (recent_requests.size() > recent_request_limit) {
+        recent_requests.pop_front();
+    }
+}
+
+// Function to snapshot every host, sorted by origin
+std::vector<HostTelemetry> GetNetTelemetry() {
+    std::vector<HostTelemetry> hosts;
+    {
+        std::lock_guard<std::mutex> lock(telemetry_mutex);
+        hosts.reserve(host_telemetry.size());
+        for (const auto& entry : host_telemetry) {
+            hosts.push_back(entry.second);
+        }
+    }
+    std::sort(hosts.begin(), hosts.end(), [](const HostTelemetry& a, const HostTelemetry& b) { return a.origin < b.origin; });
+    return hosts;
+}
+
+// Function to get the last requests, oldest first
+std::vector<RequestTiming> GetRecentRequests() {
+    std::lock_guard<std::mutex> lock(telemetry_mutex);
+    return std::vector<RequestTiming>(recent_requests.begin(), recent_requests.end());
+}
+
+// Function to forget everything recorded so far
+void ResetNetTelemetry() {
+    std::lock_guard<std::mutex> lock(telemetry_mutex);
+    host_telemetry.clear();
+    recent_requests.clear();
+}
+
+// Function to export the per-host percentiles and the recent requests as JSON
+nlohmann::json NetTelemetryToJson() {
+    nlohmann::json hosts = nlohmann::json::array();
+    for (const HostTelemetry& host : GetNetTelemetry()) {
+        nlohmann::json phases = nlohmann::json::object();
+        for (int phase = 0; phase < NetPhase_COUNT; ++phase) {
+            const LatencyHistogram& histogram = host.phases[phase];
+            phases[NetPhaseName(phase)] = {
+                { "samples", histogram.Count() },
+                { "p50_ms", histogram.Percentile(0.50) },
+                { "p90_ms", histogram.Percentile(0.90) },
+                { "p99_ms", histogram.Percentile(0.99) },
+                { "max_ms", histogram.Max() },
+            };
+        }
+        hosts.push_back({
+            { "origin", host.origin }, { "requests", host.requests }, { "failures", host.failures },
+            { "retries", host.retries }, { "reused", host.reused }, { "bytes", host.bytes }, { "phases", phases },
+        });
+    }
+
+    nlohmann::json requests = nlohmann::json::array();
+    for (const RequestTiming& timing : GetRecentRequests()) {
+        requests.push_back({
+            { "origin", timing.origin }, { "path", timing.path }, { "method", timing.method },
+            { "dns_ms", timing.dns_ms }, { "connect_ms", timing.connect_ms }, { "tls_ms", timing.tls_ms },
+            { "ttfb_ms", timing.ttfb_ms }, { "transfer_ms", timing.transfer_ms }, { "retry_ms", timing.retry_ms }, { "total_ms", timing.total_ms },
+            { "bytes", timing.bytes }, { "status", timing.status }, { "retries", timing.retries },
+            { "reused", timing.reused }, { "error", timing.error },
+        });
+    }
+    return { { "hosts", hosts }, { "recent_requests", requests } };
+}
+
+// Function to write NetTelemetryToJson to a file
+bool SaveNetTelemetry(const std::string& path) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << NetTelemetryToJson().dump(2);
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,81 @@
+#ifndef NET_TELEMETRY_H
+#define NET_TELEMETRY_H
+
+#include "json.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Phase timings of one HTTP request, filled in by HttpClientPool::Get and Post.
+// Phases that did not happen (DNS, connect and TLS on a reused connection) stay at -1.
+struct RequestTiming {
+    std::string origin;
+    std::string path;
+    const char* method = "GET";
+    double dns_ms = -1.0;      // Start until the socket exists, name resolution
+    double connect_ms = -1.0;  // TCP connect, only measurable on https where the TLS handshake marks its end
+    double tls_ms = -1.0;      // TLS handshake
+    double ttfb_ms = -1.0;     // End of the previous phase until the first body byte, includes the connect on http
+    double transfer_ms = -1.0; // First body byte until the response is complete, 0 without a body
+    double retry_ms = 0.0;     // Failed attempts before the one the phases above describe
+    double total_ms = 0.0;     // Every attempt, retry_ms included
+    uint64_t bytes = 0;        // Response body bytes
+    int status = 0;            // HTTP status, 0 when no response arrived
+    int retries = 0;
+    bool reused = false;       // Sent on an already open keep-alive connection
+    std::string error;         // httplib error name when there was no response
+};
+
+enum NetPhase {
+    NetPhase_Dns,
+    NetPhase_Connect,
+    NetPhase_Tls,
+    NetPhase_Ttfb,
+    NetPhase_Transfer,
+    NetPhase_Total,
+    NetPhase_COUNT
+};
+
+// Latency histogram with logarithmic buckets: bucket 0 holds everything below 0.125 ms and
+// each following bucket is 25% wider, so 64 buckets reach past two minutes with percentiles
+// accurate to within one bucket width.
+class LatencyHistogram {
+public:
+    static const int bucket_count = 64;
+
+    void Add(double ms);
+    double Percentile(double fraction) const; // Upper edge of the bucket holding that rank, 0 when empty
+    uint64_t Count() const { return count; }
+    double Max() const { return max_ms; }
+
+private:
+    uint32_t buckets[bucket_count] = {};
+    uint64_t count = 0;
+    double max_ms = 0.0;
+};
+
+struct HostTelemetry {
+    std::string origin;
+    uint64_t requests = 0;
+    uint64_t failures = 0; // No response, or a status of 400 and above
+    uint64_t retries = 0;
+    uint64_t reused = 0;
+    uint64_t bytes = 0;
+    LatencyHistogram phases[NetPhase_COUNT];
+};
+
+// Function to get the display name of a phase
+const char* NetPhaseName(int phase);
+
+// Function to add one finished request to its host's histograms and the recent request list
+void RecordRequestTiming(const RequestTiming& timing);
+std::vector<HostTelemetry> GetNetTelemetry();
+// Function to get the last requests, oldest first
+std::vector<RequestTiming> GetRecentRequests();
+void ResetNetTelemetry();
+
+// Functions to export the per-host percentiles and the recent requests as JSON
+nlohmann::json NetTelemetryToJson();
+bool SaveNetTelemetry(const std::string& path);
+
+#endif // NET_TELEMETRY_H
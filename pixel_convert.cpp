@@ -0,0 +1,155 @@
+#include "pixel_convert.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PIXEL_CONVERT_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PIXEL_CONVERT_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define PIXEL_CONVERT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define PIXEL_CONVERT_X86 0
+#endif
+
+// Function to swap the R and B bytes of one little-endian RGBA pixel: 0xAABBGGRR -> 0xAARRGGBB
+static inline uint32_t SwizzlePixel(uint32_t rgba) {
+    uint32_t rb = rgba & 0x00FF00FFu;
+    return (rgba & 0xFF00FF00u) | (rb << 16) | (rb >> 16);
+}
+
+// Function to convert the tail of a row that the vector loops did not cover
+static inline void ConvertRowScalar(unsigned char* dst, const unsigned char* src, int count) {
+    for (int x = 0; x < count; ++x) {
+        uint32_t pixel;
+        memcpy(&pixel, src + 4 * x, 4);
+        pixel = SwizzlePixel(pixel);
+        memcpy(dst + 4 * x, &pixel, 4);
+    }
+}
+
+void ConvertRGBAToBGRA_Scalar(unsigned char* dst, size_t dst_pitch, const unsigned char* src, size_t src_pitch, int width, int height) {
+    for (int y = 0; y < height; ++y) {
+        ConvertRowScalar(dst, src, width);
+        dst += dst_pitch;
+        src += src_pitch;
+    }
+}
+
+#if PIXEL_CONVERT_X86
+
+// SSE2 has no byte shuffle, so the swap is done with masks and 16-bit shifts per 32-bit lane
+void ConvertRGBAToBGRA_SSE2(unsigned char* dst, size_t dst_pitch, const unsigned char* src, size_t src_pitch, int width, int height) {
+    const __m128i mask_ag = _mm_set1_epi32(static_cast<int>(0xFF00FF00u));
+    const __m128i mask_rb = _mm_set1_epi32(0x00FF00FF);
+    for (int y = 0; y < height; ++y) {
+        int x = 0;
+        for (; x + 4 <= width; x += 4) {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * x));
+            __m128i ag = _mm_and_si128(pixels, mask_ag);
+            __m128i rb = _mm_and_si128(pixels, mask_rb);
+            rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * x), _mm_or_si128(ag, rb));
+        }
+        ConvertRowScalar(dst + 4 * x, src + 4 * x, width - x);
+        dst += dst_pitch;
+        src += src_pitch;
+    }
+}
+
+PIXEL_CONVERT_TARGET_AVX2
+void ConvertRGBAToBGRA_AVX2(unsigned char* dst, size_t dst_pitch, const unsigned char* src, size_t src_pitch, int width, int height) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    for (int y = 0; y < height; ++y) {
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 4 * x));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 4 * x + 32));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 4 * x), _mm256_shuffle_epi8(a, shuffle));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 4 * x + 32), _mm256_shuffle_epi8(b, shuffle));
+        }
+        for (; x + 8 <= width; x += 8) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 4 * x));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 4 * x), _mm256_shuffle_epi8(a, shuffle));
+        }
+        ConvertRowScalar(dst + 4 * x, src + 4 * x, width - x);
+        dst += dst_pitch;
+        src += src_pitch;
+    }
+}
+
+bool CpuHasSSE2() {
+#if defined(_M_X64) || defined(__x86_64__)
+    return true;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+bool CpuHasAVX2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#else // !PIXEL_CONVERT_X86
+
+void ConvertRGBAToBGRA_SSE2(unsigned char* dst, size_t dst_pitch, const unsigned char* src, size_t src_pitch, int width, int height) {
+    ConvertRGBAToBGRA_Scalar(dst, dst_pitch, src, src_pitch, width, height);
+}
+
+void ConvertRGBAToBGRA_AVX2(unsigned char* dst, size_t dst_pitch, const unsigned char* src, size_t src_pitch, int width, int height) {
+    ConvertRGBAToBGRA_Scalar(dst, dst_pitch, src, src_pitch, width, height);
+}
+
+bool CpuHasSSE2() { return false; }
+bool CpuHasAVX2() { return false; }
+
+#endif // PIXEL_CONVERT_X86
+
+struct PixelConvertKernel {
+    PixelConvertFn fn;
+    const char* name;
+};
+
+// Function to pick the kernel once, the result never changes for the life of the process
+static const PixelConvertKernel& SelectKernel() {
+    static const PixelConvertKernel kernel = [] {
+        if (CpuHasAVX2())
+            return PixelConvertKernel{ ConvertRGBAToBGRA_AVX2, "AVX2" };
+        if (CpuHasSSE2())
+            return PixelConvertKernel{ ConvertRGBAToBGRA_SSE2, "SSE2" };
+        return PixelConvertKernel{ ConvertRGBAToBGRA_Scalar, "Scalar" };
+    }();
+    return kernel;
+}
+
+void ConvertRGBAToBGRA(unsigned char* dst, size_t dst_pitch, const unsigned char* src, size_t src_pitch, int width, int height) {
+    SelectKernel().fn(dst, dst_pitch, src, src_pitch, width, height);
+}
+
+const char* GetPixelConvertKernelName() {
+    return SelectKernel().name;
+}
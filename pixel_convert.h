@@ -0,0 +1,24 @@
+#ifndef PIXEL_CONVERT_H
+#define PIXEL_CONVERT_H
+
+#include <cstddef>
+
+// Row converters from stb_image's RGBA8 to the BGRA8 layout of D3DFMT_A8R8G8B8.
+// Each kernel converts width pixels per row and advances src and dst by their own
+// pitch, so it can write straight into a locked rect. Callers validate sizes once.
+typedef void (*PixelConvertFn)(unsigned char* dst, size_t dst_pitch, const unsigned char* src, size_t src_pitch, int width, int height);
+
+void ConvertRGBAToBGRA_Scalar(unsigned char* dst, size_t dst_pitch, const unsigned char* src, size_t src_pitch, int width, int height);
+void ConvertRGBAToBGRA_SSE2(unsigned char* dst, size_t dst_pitch, const unsigned char* src, size_t src_pitch, int width, int height);
+void ConvertRGBAToBGRA_AVX2(unsigned char* dst, size_t dst_pitch, const unsigned char* src, size_t src_pitch, int width, int height);
+
+// Function to check which kernels this CPU can run
+bool CpuHasSSE2();
+bool CpuHasAVX2();
+
+// Function to convert with the fastest kernel the CPU supports, picked once at first use
+void ConvertRGBAToBGRA(unsigned char* dst, size_t dst_pitch, const unsigned char* src, size_t src_pitch, int width, int height);
+// Function to name the kernel ConvertRGBAToBGRA dispatches to
+const char* GetPixelConvertKernelName();
+
+#endif // PIXEL_CONVERT_H
@@ -0,0 +1,147 @@
+#include "profiler.h"
+#include "json.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+// Events kept per thread; at a few dozen scopes per frame this covers well over ten seconds
+static const size_t profiler_thread_capacity = 1 << 16;
+static const size_t profiler_frame_capacity = 512;
+
+// Ring buffer owned by one thread. Only that thread writes, the mutex is taken by readers,
+// so it stays uncontended apart from the rare collect. Buffers outlive their threads so a
+// dump still shows work from threads that have exited.
+struct ProfileThreadBuffer {
+    std::mutex mutex;
+    std::vector<ProfileEvent> events;
+    size_t next = 0;
+    int id = 0;
+    std::string name;
+};
+
+static std::mutex registry_mutex;
+static std::vector<std::shared_ptr<ProfileThreadBuffer>> registry;
+static std::mutex frame_mutex;
+static std::vector<float> frame_times; // Ring of milliseconds, frame_next is the oldest slot once full
+static size_t frame_next = 0;
+static int64_t last_frame_ns = -1;
+
+// Function to get this thread's buffer, registering it on first use
+static ProfileThreadBuffer& LocalBuffer() {
+    thread_local std::shared_ptr<ProfileThreadBuffer> buffer = [] {
+        auto created = std::make_shared<ProfileThreadBuffer>();
+        created->events.reserve(profiler_thread_capacity);
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        created->id = static_cast<int>(registry.size()) + 1;
+        created->name = "thread " + std::to_string(created->id);
+        registry.push_back(created);
+        return created;
+    }();
+    return *buffer;
+}
+
+int64_t ProfilerNow() {
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+// Function to append one event, overwriting the oldest once the ring is full
+void ProfilerRecord(const char* name, int64_t start_ns, int64_t end_ns) {
+    ProfileThreadBuffer& buffer = LocalBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    ProfileEvent event = { name, start_ns, end_ns, buffer.id };
+    if (buffer.events.size() < profiler_thread_capacity) {
+        buffer.events.push_back(event);
+    }
+    else {
+        buffer.events[buffer.next] = event;
+    }
+    buffer.next = (buffer.next + 1) % profiler_thread_capacity;
+}
+
+void ProfilerSetThreadName(const char* name) {
+    ProfileThreadBuffer& buffer = LocalBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.name = name;
+}
+
+// Function to record the time since the previous frame mark
+void ProfilerMarkFrame() {
+    const int64_t now = ProfilerNow();
+    std::lock_guard<std::mutex> lock(frame_mutex);
+    if (last_frame_ns >= 0) {
+        const float ms = static_cast<float>((now - last_frame_ns) / 1e6);
+        if (frame_times.size() < profiler_frame_capacity) {
+            frame_times.push_back(ms);
+        }
+        else {
+            frame_times[frame_next] = ms;
+        }
+        frame_next = (frame_next + 1) % profiler_frame_capacity;
+    }
+    last_frame_ns = now;
+}
+
+std::vector<ProfileEvent> ProfilerCollect(int64_t since_ns) {
+    std::vector<std::shared_ptr<ProfileThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        buffers = registry;
+    }
+    std::vector<ProfileEvent> events;
+    for (const auto& buffer : buffers) {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        for (const ProfileEvent& event : buffer->events) {
+            if (event.end_ns >= since_ns) {
+                events.push_back(event);
+            }
+        }
+    }
+    std::sort(events.begin(), events.end(), [](const ProfileEvent& a, const ProfileEvent& b) { return a.start_ns < b.start_ns; });
+    return events;
+}
+
+std::vector<ProfileThreadInfo> ProfilerThreads() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::vector<ProfileThreadInfo> threads;
+    for (const auto& buffer : registry) {
+        std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+        threads.push_back({ buffer->id, buffer->name });
+    }
+    return threads;
+}
+
+std::vector<float> ProfilerFrameTimes() {
+    std::lock_guard<std::mutex> lock(frame_mutex);
+    if (frame_times.size() < profiler_frame_capacity) {
+        return frame_times;
+    }
+    std::vector<float> ordered(frame_times.begin() + frame_next, frame_times.end());
+    ordered.insert(ordered.end(), frame_times.begin(), frame_times.begin() + frame_next);
+    return ordered;
+}
+
+// Function to write complete ("X") events plus thread name metadata, timestamps in microseconds
+bool ProfilerWriteChromeTrace(const std::string& path, double seconds) {
+    const int64_t since = ProfilerNow() - static_cast<int64_t>(seconds * 1e9);
+    nlohmann::json trace_events = nlohmann::json::array();
+    for (const ProfileThreadInfo& thread : ProfilerThreads()) {
+        trace_events.push_back({
+            { "name", "thread_name" }, { "ph", "M" }, { "pid", 1 }, { "tid", thread.id },
+            { "args", { { "name", thread.name } } },
+        });
+    }
+    for (const ProfileEvent& event : ProfilerCollect(since)) {
+        trace_events.push_back({
+            { "name", event.name }, { "cat", "meme" }, { "ph", "X" }, { "pid", 1 }, { "tid", event.thread },
+            { "ts", event.start_ns / 1000.0 }, { "dur", (event.end_ns - event.start_ns) / 1000.0 },
+        });
+    }
+    nlohmann::json trace = { { "traceEvents", trace_events }, { "displayTimeUnit", "ms" } };
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << trace.dump();
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,69 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Scoped frame profiler. PROFILE_SCOPE("phase") records the time until the end of the
+// enclosing block into a per-thread ring buffer; the overlay and the Chrome trace dump
+// read those buffers back. Build with MEME_PROFILER=0 and every macro expands to nothing,
+// so instrumented code carries no cost at all.
+#ifndef MEME_PROFILER
+#define MEME_PROFILER 1
+#endif
+
+// One finished scope. name must be a string literal, only the pointer is stored.
+struct ProfileEvent {
+    const char* name;
+    int64_t start_ns; // Since the profiler's epoch, see ProfilerNow
+    int64_t end_ns;
+    int thread;
+};
+
+struct ProfileThreadInfo {
+    int id;
+    std::string name;
+};
+
+// Function to get nanoseconds since the profiler's epoch (first use in the process)
+int64_t ProfilerNow();
+void ProfilerRecord(const char* name, int64_t start_ns, int64_t end_ns);
+void ProfilerSetThreadName(const char* name);
+// Function to mark the start of a frame on the render thread, feeds the frame-time history
+void ProfilerMarkFrame();
+
+// Function to copy every event that ended after since_ns, from all threads, ordered by start
+std::vector<ProfileEvent> ProfilerCollect(int64_t since_ns);
+std::vector<ProfileThreadInfo> ProfilerThreads();
+// Function to get recent frame times in milliseconds, oldest first
+std::vector<float> ProfilerFrameTimes();
+// Function to write the last seconds of events as Chrome trace_event JSON (chrome://tracing, Perfetto)
+bool ProfilerWriteChromeTrace(const std::string& path, double seconds);
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) : name(name), start_ns(ProfilerNow()) {}
+    ~ProfileScope() { ProfilerRecord(name, start_ns, ProfilerNow()); }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name;
+    int64_t start_ns;
+};
+
+#if MEME_PROFILER
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define PROFILE_THREAD(name) ProfilerSetThreadName(name)
+#define PROFILE_FRAME() ProfilerMarkFrame()
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#endif
+
+#endif // PROFILER_H
@@ -0,0 +1,639 @@
+// Unit tests for the headless core: the catalog snapshot, the search index, the
+// connection pool, the caches, the atlas packer, the journal's URL index, the meme sort,
+// the batch token bucket, caption normalization and the result cache's single flight.
+// Every check prints its file and line when it fails, and the run exits with status 1 if
+// any did.
+//
+// Build on Linux with the CMake build in the repo root (target core_tests), run with ctest.
+
+#include "atlas_packer.h"
+#include "disk_cache.h"
+#include "http_pool.h"
+#include "meme_batch.h"
+#include "meme_catalog.h"
+#include "meme_journal.h"
+#include "meme_result_cache.h"
+#include "meme_search.h"
+#include "meme_sort.h"
+#include "texture_cache.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static int checks = 0;
+static int failures = 0;
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        checks++;                                                           \
+        if (!(condition)) {                                                 \
+            failures++;                                                     \
+            printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #condition);   \
+        }                                                                   \
+    } while (0)
+
+// Function to make an empty scratch directory for one test
+static fs::path ScratchDirectory(const char* name) {
+    const fs::path directory = fs::temp_directory_path() / "meme_core_tests" / name;
+    std::error_code ec;
+    fs::remove_all(directory, ec);
+    fs::create_directories(directory);
+    return directory;
+}
+
+static double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Function to read a whole file
+static std::string ReadFile(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Function to replace a whole file
+static void WriteFile(const fs::path& path, const std::string& bytes) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+}
+
+static void TestCatalogSnapshot() {
+    const fs::path directory = ScratchDirectory("catalog_snapshot");
+    const std::string path = (directory / "catalog.bin").string();
+    const nlohmann::json response = {
+        { "success", true },
+        { "data", { { "memes", {
+            { { "id", "181913649" }, { "name", "Drake Hotline Bling" }, { "url", "https://i.imgflip.com/30b1gx.jpg" },
+              { "width", 1200 }, { "height", 1200 }, { "box_count", 2 } },
+            { { "id", "87743020" }, { "name", "Two Buttons" }, { "url", "https://i.imgflip.com/1g8my4.jpg" },
+              { "width", 600 }, { "height", 908 }, { "box_count", 3 } },
+            { { "id", "112126428" }, { "name", "" }, { "url", "" }, { "width", 0 }, { "height", 0 }, { "box_count", 0 } },
+        } } } },
+    };
+    MemeCatalog catalog;
+    CHECK(BuildMemeCatalog(response, catalog) && catalog.Size() == 3);
+    CHECK(strcmp(catalog.Name(1), "Two Buttons") == 0 && catalog.heights[1] == 908 && catalog.box_counts[1] == 3);
+
+    // A round trip gives back the same catalog
+    MemeCatalog loaded;
+    CHECK(SaveCatalogSnapshot(catalog, path) && LoadCatalogSnapshot(path, loaded));
+    CHECK(loaded == catalog);
+    const std::string clean = ReadFile(path);
+
+    // Any damage is refused and leaves the catalog it was loading into alone
+    std::string damaged = clean;
+    damaged[clean.size() / 2] ^= 0x01;
+    WriteFile(path, damaged);
+    CHECK(!LoadCatalogSnapshot(path, loaded) && loaded == catalog);
+    damaged = clean;
+    damaged[clean.size() - 1] ^= 0x80; // The checksum itself
+    WriteFile(path, damaged);
+    CHECK(!LoadCatalogSnapshot(path, loaded));
+    WriteFile(path, clean.substr(0, clean.size() - 5));
+    CHECK(!LoadCatalogSnapshot(path, loaded));
+    WriteFile(path, clean + "x");
+    CHECK(!LoadCatalogSnapshot(path, loaded));
+    damaged = clean;
+    damaged[4] = 2; // Another version
+    WriteFile(path, damaged);
+    CHECK(!LoadCatalogSnapshot(path, loaded));
+    CHECK(!LoadCatalogSnapshot((directory / "missing.bin").string(), loaded));
+
+    // An offset outside the pool is refused even when the checksum matches
+    damaged = clean;
+    const uint32_t outside = 0xffff;
+    memcpy(&damaged[16], &outside, sizeof(outside)); // First id offset, right after the header
+    uint32_t checksum = 2166136261u;
+    for (size_t i = 0; i + 4 < damaged.size(); ++i) {
+        checksum ^= static_cast<unsigned char>(damaged[i]);
+        checksum *= 16777619u;
+    }
+    memcpy(&damaged[damaged.size() - 4], &checksum, sizeof(checksum));
+    WriteFile(path, damaged);
+    CHECK(!LoadCatalogSnapshot(path, loaded));
+
+    // An empty catalog survives the round trip too, and malformed responses build nothing
+    MemeCatalog empty;
+    CHECK(SaveCatalogSnapshot(empty, path) && LoadCatalogSnapshot(path, loaded) && loaded.Empty());
+    CHECK(!BuildMemeCatalog(nlohmann::json::array(), loaded));
+    CHECK(!BuildMemeCatalog({ { "success", true }, { "data", nullptr } }, loaded));
+}
+
+static void TestMemeSearch() {
+    MemeCatalog catalog;
+    const char* names[] = { "Drake Hotline Bling", "Distracted Boyfriend", "Two Buttons", "Change My Mind",
+        "Left Exit 12 Off Ramp", "Running Away Balloon", "aaaa", "", "UNO Draw 25 Cards", "Bu" };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        catalog.Add(std::to_string(i), names[i], "u", 1, 1, 2);
+    }
+    MemeSearchIndex index;
+    index.Build(catalog);
+
+    // Every query must find exactly what strstr finds, in catalog order
+    const char* queries[] = { "", "B", "Bu", "Butt", "butt", "ing", "aaa", "aaaaa", "Exit 12", "t 1", " ", "Draw 25 Cards",
+        "Two Buttons", "Two Buttonsx", "zzz", "oy", "ay B" };
+    std::vector<uint32_t> found;
+    for (const char* query : queries) {
+        std::vector<uint32_t> expected;
+        for (size_t row = 0; row < catalog.Size(); ++row) {
+            if (strstr(catalog.Name(row), query) != nullptr) {
+                expected.push_back(static_cast<uint32_t>(row));
+            }
+        }
+        index.Query(catalog, query, found);
+        CHECK(found == expected);
+    }
+
+    // The cached results are recomputed only when the query or the catalog changes
+    MemeSearchResults results;
+    CHECK(UpdateSearchResults(index, catalog, "Bu", results));
+    CHECK((results.rows == std::vector<uint32_t>{ 2, 9 }) && results.matches[2] && results.matches[9] && !results.matches[0]);
+    CHECK(!UpdateSearchResults(index, catalog, "Bu", results));
+    CHECK(UpdateSearchResults(index, catalog, "Mind", results) && (results.rows == std::vector<uint32_t>{ 3 }));
+    results.Invalidate();
+    CHECK(UpdateSearchResults(index, catalog, "Mind", results));
+
+    index.Clear();
+    index.Query(catalog, "Mind", found);
+    CHECK(found.empty());
+}
+
+static void TestHttpClientPool() {
+    // Leases are created lazily, handed back on destruction and reused by the next caller
+    HttpClientPool pool(2);
+    const std::string origin = "http://127.0.0.1:9";
+    {
+        HttpClientPool::Lease first = pool.Acquire(origin);
+        HttpClientPool::Lease second = pool.Acquire(origin);
+        CHECK(first && second && &*first != &*second);
+        CHECK(pool.GetStats().size() == 1 && pool.GetStats()[0].open_clients == 2 && pool.GetStats()[0].idle_clients == 0);
+    }
+    CHECK(pool.GetStats()[0].open_clients == 2 && pool.GetStats()[0].idle_clients == 2);
+    {
+        HttpClientPool::Lease reused = pool.Acquire(origin);
+        CHECK(pool.GetStats()[0].open_clients == 2 && pool.GetStats()[0].idle_clients == 1 && pool.GetStats()[0].requests == 3);
+        HttpClientPool::Lease moved = std::move(reused);
+        CHECK(moved && !reused);
+    }
+
+    // A third caller waits while both slots are leased, and gets one as soon as it is returned
+    {
+        HttpClientPool::Lease first = pool.Acquire(origin);
+        HttpClientPool::Lease second = pool.Acquire(origin);
+        std::atomic<bool> acquired(false);
+        std::thread waiter([&] {
+            HttpClientPool::Lease third = pool.Acquire(origin);
+            acquired = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        CHECK(!acquired);
+        first = HttpClientPool::Lease();
+        waiter.join();
+        CHECK(acquired && pool.GetStats()[0].open_clients == 2);
+    }
+
+    // Raising the limit wakes a waiter, lowering it closes idle clients and those handed back over it
+    {
+        HttpClientPool::Lease first = pool.Acquire(origin);
+        HttpClientPool::Lease second = pool.Acquire(origin);
+        std::atomic<bool> acquired(false);
+        std::thread waiter([&] {
+            HttpClientPool::Lease third = pool.Acquire(origin);
+            acquired = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        pool.SetMaxConnectionsPerHost(3);
+        waiter.join();
+        CHECK(acquired && pool.GetMaxConnectionsPerHost() == 3 && pool.GetStats()[0].open_clients == 3);
+        pool.SetMaxConnectionsPerHost(1);
+        CHECK(pool.GetStats()[0].open_clients == 2 && pool.GetStats()[0].idle_clients == 0);
+    }
+    CHECK(pool.GetStats()[0].open_clients == 1 && pool.GetStats()[0].idle_clients == 1);
+    pool.SetMaxConnectionsPerHost(0);
+    CHECK(pool.GetMaxConnectionsPerHost() == 1);
+
+    // Origins are pooled separately
+    HttpClientPool::Lease other = pool.Acquire("http://127.0.0.1:7");
+    CHECK(other && pool.GetStats().size() == 2);
+}
+
+static void TestSortMemeRows() {
+    MemeCatalog catalog;
+    catalog.Add("10", "banana", "u0", 300, 10, 2);
+    catalog.Add("9", "Apple", "u1", 100, 20, 3);
+    catalog.Add("200", "apple", "u2", 200, 30, 2);
+    catalog.Add("1", "Cherry", "u3", 200, 40, 4);
+    catalog.Add("55", "apple", "u4", 400, 50, 2);
+    MemeSortKeys keys;
+    keys.Build(catalog);
+    std::vector<uint32_t> order;
+
+    // Ids compare as numbers, not as strings
+    const MemeSortSpec by_id[] = { { MemeSortColumn_Id, false } };
+    SortMemeRows(catalog, keys, by_id, 1, order);
+    CHECK((order == std::vector<uint32_t>{ 3, 1, 0, 4, 2 }));
+
+    // Names ignore case, ties fall through to the next spec
+    const MemeSortSpec by_name_width[] = { { MemeSortColumn_Name, false }, { MemeSortColumn_Width, true } };
+    SortMemeRows(catalog, keys, by_name_width, 2, order);
+    CHECK((order == std::vector<uint32_t>{ 4, 2, 1, 0, 3 }));
+
+    const MemeSortSpec by_boxes_desc[] = { { MemeSortColumn_BoxCount, true } };
+    SortMemeRows(catalog, keys, by_boxes_desc, 1, order);
+    CHECK(order.size() == catalog.Size());
+    for (size_t i = 1; i < order.size(); ++i) {
+        CHECK(catalog.box_counts[order[i - 1]] >= catalog.box_counts[order[i]]);
+    }
+
+    // Columns without keys leave the catalog order alone
+    const MemeSortSpec by_image[] = { { MemeSortColumn_Image, false } };
+    SortMemeRows(catalog, keys, by_image, 1, order);
+    CHECK((order == std::vector<uint32_t>{ 0, 1, 2, 3, 4 }));
+}
+
+static void TestTextureCache() {
+    std::vector<std::string> released;
+    TextureCache cache(300, [&released](void* texture) { released.push_back(static_cast<const char*>(texture)); });
+    TextureCacheEntry* entry = nullptr;
+    const char* names[] = { "a", "b", "c", "d" };
+
+    cache.BeginFrame(1);
+    for (int i = 0; i < 3; ++i) {
+        CHECK(cache.Acquire(names[i], entry));
+        cache.SetReady(names[i], const_cast<char*>(names[i]), 100);
+    }
+    CHECK(!cache.Acquire("a", entry) && entry->state == ImageLoadState_Ready);
+    CHECK(released.empty() && cache.GetStats().bytes == 300);
+
+    // Frame 1 is two frames back, so nothing is pinned and the least recently used goes first
+    cache.BeginFrame(3);
+    CHECK(cache.Acquire("d", entry));
+    cache.SetReady("d", const_cast<char*>(names[3]), 100);
+    CHECK((released == std::vector<std::string>{ "b" }));
+    CHECK(cache.Lookup("b") == nullptr && cache.Lookup("a") != nullptr);
+
+    // Entries used in this or the previous frame stay even over budget
+    CHECK(!cache.Acquire("c", entry));
+    cache.BeginFrame(4);
+    cache.SetBudget(0);
+    CHECK((released == std::vector<std::string>{ "b", "a" }));
+    CHECK(cache.GetStats().entries == 2 && cache.GetStats().bytes == 200);
+
+    // EvictIf skips pinned entries too, once they age out it takes them
+    CHECK(cache.EvictIf([](const TextureCacheEntry&) { return true; }) == 0);
+    cache.SetBudget(300);
+    cache.BeginFrame(6);
+    CHECK(cache.EvictIf([](const TextureCacheEntry& candidate) { return candidate.key == "c"; }) == 1);
+    CHECK(released.back() == "c" && cache.Lookup("d") != nullptr);
+
+    // A failed load stays negative until its backoff runs out
+    CHECK(cache.Acquire("e", entry));
+    cache.SetFailed("e");
+    CHECK(!cache.Acquire("e", entry) && entry->state == ImageLoadState_Failed);
+
+    // Loading and negative entries hold no bytes, they go once unused for expire_frames frames
+    CHECK(cache.Acquire("f", entry));
+    cache.BeginFrame(6 + TextureCache::expire_frames / 2);
+    CHECK(!cache.Acquire("e", entry));
+    cache.BeginFrame(7 + TextureCache::expire_frames + 64);
+    CHECK(cache.Lookup("f") == nullptr && cache.Lookup("e") != nullptr && cache.Lookup("d") != nullptr);
+    CHECK(cache.GetStats().expired == 1 && cache.GetStats().entries == 2);
+
+    // A texture that finishes loading counts as used now, so eviction takes older entries first
+    const uint64_t frame = 8 + TextureCache::expire_frames * 2;
+    cache.BeginFrame(frame);
+    CHECK(cache.Acquire("g", entry));
+    cache.BeginFrame(frame + 2);
+    cache.SetReady("g", const_cast<char*>("g"), 100);
+    CHECK(cache.Lookup("g")->last_used_frame == frame + 2);
+    cache.SetBudget(100);
+    CHECK(released.back() == "d" && cache.Lookup("g") != nullptr);
+
+    cache.Clear();
+    CHECK(released.size() == 5 && cache.GetStats().entries == 0 && cache.GetStats().bytes == 0);
+}
+
+static void TestDiskCache() {
+    const fs::path directory = ScratchDirectory("disk_cache");
+    const std::string url = "https://i.imgflip.com/30b1gx.jpg";
+    const std::string body = "not really a jpeg";
+    DiskCacheValidators validators;
+    validators.etag = "\"abc\"";
+    validators.stored_at = 1700000000;
+    const fs::path entry_path = directory / (DiskCacheKey(url) + ".bin");
+
+    DiskCache cache(directory.string(), 1 << 20);
+    CHECK(cache.Store(url, body.data(), body.size(), validators));
+    MappedFile file;
+    size_t offset = 0;
+    DiskCacheValidators found;
+    CHECK(cache.Lookup(url, file, offset, found));
+    CHECK(std::string(reinterpret_cast<const char*>(file.Data()) + offset, file.Size() - offset) == body);
+    CHECK(found.etag == validators.etag && found.stored_at == validators.stored_at);
+    file.Close();
+
+    // A damaged magic is a miss and the entry is deleted
+    {
+        std::fstream out(entry_path, std::ios::binary | std::ios::in | std::ios::out);
+        out.write("XXXX", 4);
+    }
+    CHECK(!cache.Lookup(url, file, offset, found));
+    CHECK(!fs::exists(entry_path) && cache.GetStats().entries == 0 && cache.GetStats().bytes == 0);
+
+    // So is a header whose sizes do not add up to the file
+    CHECK(cache.Store(url, body.data(), body.size(), validators));
+    fs::resize_file(entry_path, fs::file_size(entry_path) - 1);
+    CHECK(!cache.Lookup(url, file, offset, found));
+    CHECK(!fs::exists(entry_path));
+
+    // And a header that is not JSON
+    CHECK(cache.Store(url, body.data(), body.size(), validators));
+    {
+        std::fstream out(entry_path, std::ios::binary | std::ios::in | std::ios::out);
+        out.seekp(16);
+        out.write("}", 1);
+    }
+    CHECK(!cache.Lookup(url, file, offset, found));
+
+    // A fresh cache drops leftover temporary files when it scans the directory
+    CHECK(cache.Store(url, body.data(), body.size(), validators));
+    std::ofstream(directory / "0123456789abcdef.bin.tmp7") << "torn";
+    DiskCache reopened(directory.string(), 1 << 20);
+    CHECK(reopened.Lookup(url, file, offset, found));
+    file.Close();
+    CHECK(!fs::exists(directory / "0123456789abcdef.bin.tmp7"));
+}
+
+static void TestAtlasPacker() {
+    // Regions grow by a 1-pixel border on each side, so four 30 x 30 images fill a 64 x 64 page
+    AtlasPacker packer(64, 1);
+    AtlasRegion regions[4];
+    for (AtlasRegion& region : regions) {
+        CHECK(packer.Allocate(30, 30, region) && region.page == 0 && region.width == 32 && region.height == 32);
+    }
+    AtlasRegion extra;
+    CHECK(!packer.Allocate(30, 30, extra));
+    CHECK(!packer.Allocate(63, 1, extra)); // Too wide once bordered, whatever is free
+    CHECK(packer.GetStats().live_regions == 4);
+
+    // Freed space comes back only once the whole page drains
+    for (int i = 0; i < 3; ++i) {
+        packer.Free(regions[i]);
+    }
+    CHECK(!packer.Allocate(30, 30, extra));
+    CHECK(packer.GetStats().resets == 0);
+    packer.Free(regions[3]);
+    CHECK(packer.GetStats().resets == 1 && packer.GetStats().live_regions == 0);
+    CHECK(packer.Allocate(62, 62, extra) && extra.page == 0 && extra.x == 0 && extra.y == 0);
+
+    // A second page opens only when the first has no room
+    AtlasPacker two_pages(64, 2);
+    AtlasRegion first;
+    AtlasRegion second;
+    CHECK(two_pages.Allocate(40, 40, first) && first.page == 0);
+    CHECK(two_pages.Allocate(40, 40, second) && second.page == 1);
+    CHECK(two_pages.GetStats().pages == 2);
+}
+
+static void TestTokenBucket() {
+    std::atomic<bool> cancel(false);
+
+    // The burst is free, after it tokens come at the refill rate
+    TokenBucket bucket(100.0, 3);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 3; ++i) {
+        CHECK(bucket.Acquire(cancel));
+    }
+    CHECK(MillisecondsSince(start) < 20.0);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 5; ++i) {
+        CHECK(bucket.Acquire(cancel));
+    }
+    CHECK(MillisecondsSince(start) >= 40.0);
+
+    // A cancel wakes a waiter
+    TokenBucket slow(0.5, 1);
+    CHECK(slow.Acquire(cancel));
+    start = std::chrono::steady_clock::now();
+    std::thread canceller([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        cancel = true;
+        slow.Interrupt();
+    });
+    CHECK(!slow.Acquire(cancel));
+    canceller.join();
+    CHECK(MillisecondsSince(start) < 1000.0);
+
+    // No rate means no limit
+    TokenBucket unlimited(0.0, 1);
+    CHECK(!unlimited.Acquire(cancel));
+    cancel = false;
+    CHECK(unlimited.Acquire(cancel) && unlimited.Acquire(cancel));
+
+    // Starting a batch makes room in the connection pool for every worker, and never shrinks it
+    const fs::path directory = ScratchDirectory("batch");
+    std::ofstream(directory / "input.jsonl", std::ios::binary) << "\n";
+    MemeBatchOptions options;
+    options.input_path = (directory / "input.jsonl").string();
+    options.output_path = (directory / "output.jsonl").string();
+    options.concurrency = 12;
+    const int max_connections = GetHttpClientPool().GetMaxConnectionsPerHost();
+    MemeBatch batch;
+    CHECK(batch.Start(options));
+    batch.Wait();
+    CHECK(GetHttpClientPool().GetMaxConnectionsPerHost() == std::max(max_connections, 12));
+    options.concurrency = 2;
+    CHECK(batch.Start(options));
+    batch.Wait();
+    CHECK(GetHttpClientPool().GetMaxConnectionsPerHost() == std::max(max_connections, 12));
+    GetHttpClientPool().SetMaxConnectionsPerHost(max_connections);
+}
+
+static void TestNormalizeCaptionBoxes() {
+    CHECK((NormalizeCaptionBoxes({ "  top   text ", "\tBottom\r\nText\n" }) == std::vector<std::string>{ "top text", "Bottom Text" }));
+    CHECK((NormalizeCaptionBoxes({ "one", "", "  ", "\n" }) == std::vector<std::string>{ "one" }));
+    CHECK((NormalizeCaptionBoxes({ "", "two" }) == std::vector<std::string>{ "", "two" }));
+    CHECK(NormalizeCaptionBoxes({ " ", "" }).empty());
+    // Normalized captions share a key, different case or templates do not
+    const std::string key = MemeResultKey("local", "181913649", NormalizeCaptionBoxes({ "a  b", "" }));
+    CHECK(key == MemeResultKey("local", "181913649", NormalizeCaptionBoxes({ " a b " })));
+    CHECK(key != MemeResultKey("local", "181913649", NormalizeCaptionBoxes({ "A b" })));
+    CHECK(key != MemeResultKey("local", "87743020", NormalizeCaptionBoxes({ "a b" })));
+    CHECK(MemeResultKey("s", "1", { "23" }) != MemeResultKey("s", "12", { "3" }));
+}
+
+static void TestMemeResultCache() {
+    const fs::path directory = ScratchDirectory("result_cache");
+    const std::string path = (directory / "memes.txt").string();
+
+    // Eight callers at once make the meme once
+    {
+        MemeResultCache cache(path);
+        std::atomic<int> made(0);
+        const MemeResultCache::MakeFn make = [&made](std::string& url, std::string&, bool&) {
+            made++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            url = "https://i.imgflip.com/made.jpg";
+            return true;
+        };
+        std::vector<std::thread> callers;
+        std::atomic<int> succeeded(0);
+        std::atomic<int> cached(0);
+        for (int i = 0; i < 8; ++i) {
+            callers.emplace_back([&] {
+                std::string url;
+                std::string error;
+                bool was_cached = false;
+                if (cache.GetOrCreate("key", make, url, error, nullptr, &was_cached) && url == "https://i.imgflip.com/made.jpg") {
+                    succeeded++;
+                }
+                cached += was_cached;
+            });
+        }
+        for (std::thread& caller : callers) {
+            caller.join();
+        }
+        const MemeResultCache::Stats stats = cache.GetStats();
+        CHECK(made == 1 && succeeded == 8 && cached == 7);
+        CHECK(stats.misses == 1 && stats.hits + stats.collapsed == 7 && stats.entries == 1);
+    }
+
+    // Failures are not remembered, successes survive a restart
+    {
+        MemeResultCache cache(path);
+        std::string url;
+        std::string error;
+        bool transient = false;
+        bool cached = true;
+        const MemeResultCache::MakeFn fail = [](std::string&, std::string& error, bool& transient) {
+            error = "rate limited";
+            transient = true;
+            return false;
+        };
+        CHECK(!cache.GetOrCreate("other", fail, url, error, &transient, &cached));
+        CHECK(error == "rate limited" && transient && !cached);
+        CHECK(!cache.Lookup("other", url));
+        CHECK(cache.Lookup("key", url) && url == "https://i.imgflip.com/made.jpg");
+        cache.Clear();
+        CHECK(!cache.Lookup("key", url) && cache.GetStats().entries == 0);
+    }
+
+    // A failed flight fails its waiters without calling them cached, a throwing one does not hang them
+    {
+        MemeResultCache cache(path);
+        for (bool throws : { false, true }) {
+            std::atomic<bool> started(false);
+            const MemeResultCache::MakeFn make = [&started, throws](std::string&, std::string& error, bool&) -> bool {
+                started = true;
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                if (throws) {
+                    throw std::runtime_error("bad response");
+                }
+                error = "failed";
+                return false;
+            };
+            bool threw = false;
+            std::thread maker([&] {
+                std::string url;
+                std::string error;
+                try {
+                    cache.GetOrCreate("flaky", make, url, error, nullptr, nullptr);
+                }
+                catch (const std::runtime_error&) {
+                    threw = true;
+                }
+            });
+            while (!started) {
+                std::this_thread::yield();
+            }
+            std::string url;
+            std::string error;
+            bool cached = true;
+            CHECK(!cache.GetOrCreate("flaky", make, url, error, nullptr, &cached));
+            CHECK(!cached && !error.empty());
+            maker.join();
+            CHECK(threw == throws);
+        }
+        CHECK(cache.GetStats().collapsed == 2 && cache.GetStats().entries == 0);
+    }
+
+    // A local meme whose file is gone is made again
+    {
+        MemeResultCache cache(path);
+        const std::string local = (directory / "meme.png").string();
+        std::ofstream(local) << "png";
+        std::string url;
+        std::string error;
+        const MemeResultCache::MakeFn make_local = [&local](std::string& url, std::string&, bool&) {
+            url = "file://" + local;
+            return true;
+        };
+        CHECK(cache.GetOrCreate("local", make_local, url, error, nullptr, nullptr));
+        CHECK(cache.Lookup("local", url));
+        fs::remove(local);
+        CHECK(!cache.Lookup("local", url));
+    }
+}
+
+static void TestUrlIndex() {
+    std::vector<std::string> stored;
+    UrlIndex index;
+    auto insert = [&](uint64_t hash, const std::string& url) {
+        const bool added = index.Insert(hash, stored.size(), [&](uint64_t position) { return stored[position] == url; });
+        if (added) {
+            stored.push_back(url);
+        }
+        return added;
+    };
+
+    CHECK(insert(UrlHash("https://i.imgflip.com/1.jpg"), "https://i.imgflip.com/1.jpg"));
+    CHECK(!insert(UrlHash("https://i.imgflip.com/1.jpg"), "https://i.imgflip.com/1.jpg"));
+    // A hash collision between different URLs keeps both
+    CHECK(insert(42, "first"));
+    CHECK(insert(42, "second"));
+    CHECK(!insert(42, "second"));
+    CHECK(index.Size() == 3);
+
+    // Growing rehashes without losing anything
+    for (int i = 0; i < 5000; ++i) {
+        const std::string url = "https://i.imgflip.com/" + std::to_string(i) + ".png";
+        CHECK(insert(UrlHash(url), url));
+    }
+    CHECK(!insert(UrlHash("https://i.imgflip.com/4999.png"), "https://i.imgflip.com/4999.png"));
+    CHECK(index.Size() == 5003);
+    CHECK(UrlHash("") != 0);
+
+    index.Clear();
+    CHECK(index.Size() == 0);
+    stored.clear();
+    CHECK(insert(42, "first"));
+}
+
+int main() {
+    TestCatalogSnapshot();
+    TestMemeSearch();
+    TestHttpClientPool();
+    TestSortMemeRows();
+    TestTextureCache();
+    TestDiskCache();
+    TestAtlasPacker();
+    TestTokenBucket();
+    TestNormalizeCaptionBoxes();
+    TestMemeResultCache();
+    TestUrlIndex();
+
+    std::error_code ec;
+    fs::remove_all(fs::temp_directory_path() / "meme_core_tests", ec);
+    printf("%d checks, %d failed\n", checks, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+#include "texture_cache.h"
+#include <algorithm>
+
+TextureCache::TextureCache(size_t budget_bytes, std::function<void(void*)> release_texture)
+    : release_texture(std::move(release_texture)) {
+    stats.budget = budget_bytes;
+}
+
+TextureCache::~TextureCache() {
+    Clear();
+}
+
+// Function to advance the frame counter and trim anything that is no longer pinned
+void TextureCache::BeginFrame(uint64_t frame) {
+    current_frame = frame;
+    EvictToBudget();
+    if (current_frame >= last_expire_frame + 64) {
+        last_expire_frame = current_frame;
+        ExpireEmptyEntries();
+    }
+}
+
+// Function to find an entry and move it to the front of the LRU list, marking it used this frame
+// so the list stays ordered by last use
+TextureCacheEntry* TextureCache::Find(const std::string& key) {
+    auto it = index.find(key);
+    if (it == index.end()) {
+        return nullptr;
+    }
+    lru.splice(lru.begin(), lru, it->second);
+    it->second->last_used_frame = current_frame;
+    return &*it->second;
+}
+
+// Function to look up key for use this frame
+bool TextureCache::Acquire(const std::string& key, TextureCacheEntry*& entry) {
+    entry = Find(key);
+    if (entry) {
+        if (entry->state == ImageLoadState_Failed && std::chrono::steady_clock::now() >= entry->retry_at) {
+            entry->state = ImageLoadState_Loading;
+            stats.misses++;
+            return true;
+        }
+        stats.hits++;
+        return false;
+    }
+
+    lru.emplace_front();
+    entry = &lru.front();
+    entry->key = key;
+    entry->last_used_frame = current_frame;
+    index.emplace(key, lru.begin());
+    stats.entries = index.size();
+    stats.misses++;
+    return true;
+}
+
+// Function to inspect an entry, for schedulers that rank work by when it was last wanted
+const TextureCacheEntry* TextureCache::Lookup(const std::string& key) const {
+    auto it = index.find(key);
+    return it == index.end() ? nullptr : &*it->second;
+}
+
+// Function to use an entry this frame if it exists, for callers that can make do without it
+TextureCacheEntry* TextureCache::Peek(const std::string& key) {
+    return Find(key);
+}
+
+// Function to store a loaded texture, the cache takes ownership of it
+void TextureCache::SetReady(const std::string& key, void* texture, size_t bytes) {
+    TextureCacheEntry* entry = Find(key);
+    if (!entry) {
+        // Nobody is waiting for it any more
+        release_texture(texture);
+        return;
+    }
+    if (entry->texture) {
+        release_texture(entry->texture);
+        stats.bytes -= entry->bytes;
+    }
+    entry->texture = texture;
+    entry->bytes = bytes;
+    entry->state = ImageLoadState_Ready;
+    entry->failures = 0;
+    stats.bytes += bytes;
+    EvictToBudget();
+}
+
+// Function to turn an entry negative, retrying after 1, 2, 4 ... seconds up to five minutes
+void TextureCache::SetFailed(const std::string& key) {
+    TextureCacheEntry* entry = Find(key);
+    if (!entry) {
+        return;
+    }
+    entry->state = ImageLoadState_Failed;
+    entry->failures++;
+    int backoff_seconds = 1 << std::min(entry->failures - 1, 8);
+    entry->retry_at = std::chrono::steady_clock::now() + std::chrono::seconds(std::min(backoff_seconds, 300));
+    stats.failures++;
+}
+
+// Function to evict least recently used textures until the cache fits its budget.
+// The list is ordered by last use, so the first pinned entry from the back ends the walk.
+void TextureCache::EvictToBudget() {
+    while (stats.bytes > stats.budget && !lru.empty()) {
+        auto it = std::prev(lru.end());
+        while (it->bytes == 0 && it != lru.begin()) {
+            --it; // Loading and negative entries hold no texture memory
+        }
+        if (it->bytes == 0 || IsPinned(*it)) {
+            break;
+        }
+        release_texture(it->texture);
+        stats.bytes -= it->bytes;
+        stats.evictions++;
+        index.erase(it->key);
+        lru.erase(it);
+    }
+    stats.entries = index.size();
+}
+
+// Function to drop loading and negative entries nobody asked for in expire_frames frames.
+// The list is ordered by last use, so the walk from the back ends at the first recent entry.
+void TextureCache::ExpireEmptyEntries() {
+    auto it = lru.end();
+    while (it != lru.begin()) {
+        --it;
+        if (it->last_used_frame + expire_frames >= current_frame) {
+            break;
+        }
+        if (it->bytes == 0 && !it->texture) {
+            index.erase(it->key);
+            it = lru.erase(it);
+            stats.expired++;
+        }
+    }
+    stats.entries = index.size();
+}
+
+// Function to visit every entry without touching its recency
+void TextureCache::ForEach(const std::function<void(const TextureCacheEntry& entry)>& visit) const {
+    for (const auto& entry : lru) {
+        visit(entry);
+    }
+}
+
+// Function to evict chosen entries ahead of their turn, pinned ones are skipped as always
+size_t TextureCache::EvictIf(const std::function<bool(const TextureCacheEntry& entry)>& match) {
+    size_t evicted = 0;
+    for (auto it = lru.begin(); it != lru.end();) {
+        if (it->bytes == 0 || IsPinned(*it) || !match(*it)) {
+            ++it;
+            continue;
+        }
+        release_texture(it->texture);
+        stats.bytes -= it->bytes;
+        stats.evictions++;
+        index.erase(it->key);
+        it = lru.erase(it);
+        evicted++;
+    }
+    stats.entries = index.size();
+    return evicted;
+}
+
+// Function to release every texture
+void TextureCache::Clear() {
+    for (auto& entry : lru) {
+        if (entry.texture) {
+            release_texture(entry.texture);
+        }
+    }
+    lru.clear();
+    index.clear();
+    stats.bytes = 0;
+    stats.entries = 0;
+}
+
+// Function to change the byte budget, shrinking takes effect right away
+void TextureCache::SetBudget(size_t budget_bytes) {
+    stats.budget = budget_bytes;
+    EvictToBudget();
+}
@@ -0,0 +1,89 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "image_pipeline.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+// One cached texture, keyed by image URL
+struct TextureCacheEntry {
+    std::string key;
+    void* texture = nullptr;
+    size_t bytes = 0;
+    ImageLoadState state = ImageLoadState_Loading;
+    uint64_t last_used_frame = 0;
+    int failures = 0;
+    std::chrono::steady_clock::time_point retry_at; // Failed entries stay negative until then
+};
+
+// Byte-budgeted LRU cache of GPU textures.
+// Entries used in the current or previous frame are pinned: they are on screen and are
+// never evicted, even if that means running over budget for a while. Failed loads stay
+// cached as negative entries and are only retried after an exponential backoff. Those and
+// loads nobody waits for any more hold no bytes, so the budget never removes them; they
+// are dropped once nobody has asked for them in expire_frames frames.
+class TextureCache {
+public:
+    static const uint64_t expire_frames = 600;
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t failures = 0;
+        uint64_t expired = 0; // Loading and negative entries dropped after going unused
+        size_t bytes = 0;
+        size_t budget = 0;
+        size_t entries = 0;
+    };
+
+    TextureCache(size_t budget_bytes, std::function<void(void*)> release_texture);
+    ~TextureCache();
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    void BeginFrame(uint64_t frame);
+
+    // Looks up key for use this frame. Returns true if the caller should start a load:
+    // the key was missing, or it is a negative entry whose backoff has expired.
+    bool Acquire(const std::string& key, TextureCacheEntry*& entry);
+    // Looks up key without touching its recency or the counters, null if missing
+    const TextureCacheEntry* Lookup(const std::string& key) const;
+    // Looks up key for use this frame without starting a load or counting a hit or miss, null if missing
+    TextureCacheEntry* Peek(const std::string& key);
+
+    void SetReady(const std::string& key, void* texture, size_t bytes);
+    void SetFailed(const std::string& key);
+    void Clear();
+
+    // Calls visit for every entry, most recently used first
+    void ForEach(const std::function<void(const TextureCacheEntry& entry)>& visit) const;
+    // Evicts every entry that holds a texture, is not pinned and is accepted by match,
+    // returns how many were evicted
+    size_t EvictIf(const std::function<bool(const TextureCacheEntry& entry)>& match);
+    bool IsPinned(const TextureCacheEntry& entry) const { return entry.last_used_frame + 1 >= current_frame; }
+
+    void SetBudget(size_t budget_bytes);
+    const Stats& GetStats() const { return stats; }
+
+private:
+    typedef std::list<TextureCacheEntry> EntryList;
+
+    TextureCacheEntry* Find(const std::string& key);
+    void EvictToBudget();
+    void ExpireEmptyEntries();
+
+    EntryList lru; // Most recently used first
+    std::unordered_map<std::string, EntryList::iterator> index;
+    std::function<void(void*)> release_texture;
+    uint64_t current_frame = 0;
+    uint64_t last_expire_frame = 0;
+    Stats stats;
+};
+
+#endif // TEXTURE_CACHE_H
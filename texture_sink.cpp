@@ -0,0 +1,63 @@
+#include "texture_sink.h"
+
+// Size of a null texture, kept so writes can be bounds-checked like a real one would be
+struct NullTexture {
+    int width;
+    int height;
+    int levels;
+};
+
+void* NullTextureSink::CreateTexture(int width, int height, int levels) {
+    if (width <= 0 || height <= 0 || levels <= 0) {
+        return nullptr;
+    }
+    created.fetch_add(1, std::memory_order_relaxed);
+    return new NullTexture{ width, height, levels };
+}
+
+bool NullTextureSink::WriteRegion(void* texture, int level, int x, int y, int width, int height, const unsigned char* rgba, size_t pitch) {
+    const NullTexture* target = static_cast<const NullTexture*>(texture);
+    if (!target || !rgba || level < 0 || level >= target->levels || pitch < static_cast<size_t>(width) * 4) {
+        return false;
+    }
+    const int level_width = target->width >> level > 0 ? target->width >> level : 1;
+    const int level_height = target->height >> level > 0 ? target->height >> level : 1;
+    if (x < 0 || y < 0 || x + width > level_width || y + height > level_height) {
+        return false;
+    }
+    bytes_written.fetch_add(static_cast<uint64_t>(width) * height * 4, std::memory_order_relaxed);
+    return true;
+}
+
+void NullTextureSink::ReleaseTexture(void* texture) {
+    if (texture) {
+        released.fetch_add(1, std::memory_order_relaxed);
+        delete static_cast<NullTexture*>(texture);
+    }
+}
+
+NullTextureSink::Stats NullTextureSink::GetStats() const {
+    Stats stats;
+    stats.created = created.load(std::memory_order_relaxed);
+    stats.released = released.load(std::memory_order_relaxed);
+    stats.bytes_written = bytes_written.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// Function to create a texture holding a decoded image and its whole mip chain, null on failure
+void* CreateTextureFromImage(TextureSink& sink, const DecodedImage& image) {
+    const int levels = image.mips.empty() ? 1 : static_cast<int>(image.mips.size());
+    void* texture = sink.CreateTexture(image.width, image.height, levels);
+    if (!texture) {
+        return nullptr;
+    }
+    for (int level = 0; level < levels; ++level) {
+        const MipLevel mip = image.mips.empty() ? MipLevel{ image.width, image.height, 0 } : image.mips[level];
+        const size_t row_bytes = static_cast<size_t>(mip.width) * 4;
+        if (!sink.WriteRegion(texture, level, 0, 0, mip.width, mip.height, image.pixels.data() + mip.offset, row_bytes)) {
+            sink.ReleaseTexture(texture);
+            return nullptr;
+        }
+    }
+    return texture;
+}
@@ -0,0 +1,47 @@
+#ifndef TEXTURE_SINK_H
+#define TEXTURE_SINK_H
+
+#include "image_pipeline.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Where decoded images go once they leave the pipeline. The core only ever holds the opaque
+// handles a sink returns; the Windows front end implements it over D3D9 (d3d9_texture_sink.h),
+// while benchmarks and load tests use NullTextureSink and never touch a GPU.
+// Every call comes from the thread that drives ImageStore, the render thread in the app.
+class TextureSink {
+public:
+    virtual ~TextureSink() = default;
+
+    // Creates an RGBA texture with levels mip levels, null on failure
+    virtual void* CreateTexture(int width, int height, int levels) = 0;
+    // Copies a width x height block of RGBA8 pixels, pitch bytes per row, to (x, y) of one level
+    virtual bool WriteRegion(void* texture, int level, int x, int y, int width, int height, const unsigned char* rgba, size_t pitch) = 0;
+    virtual void ReleaseTexture(void* texture) = 0;
+};
+
+// Sink that keeps nothing but counters, for running the core without a GPU
+class NullTextureSink : public TextureSink {
+public:
+    struct Stats {
+        uint64_t created = 0;
+        uint64_t released = 0;
+        uint64_t bytes_written = 0;
+    };
+
+    void* CreateTexture(int width, int height, int levels) override;
+    bool WriteRegion(void* texture, int level, int x, int y, int width, int height, const unsigned char* rgba, size_t pitch) override;
+    void ReleaseTexture(void* texture) override;
+    Stats GetStats() const;
+
+private:
+    std::atomic<uint64_t> created{ 0 };
+    std::atomic<uint64_t> released{ 0 };
+    std::atomic<uint64_t> bytes_written{ 0 };
+};
+
+// Function to create a texture holding a decoded image and its whole mip chain, null on failure
+void* CreateTextureFromImage(TextureSink& sink, const DecodedImage& image);
+
+#endif // TEXTURE_SINK_H
@@ -0,0 +1,111 @@
+// Command line front end for MemeBatch: creates one meme per line of a JSONL file and writes
+// one result line per meme, see meme_batch.h for both formats. Progress goes to stderr once a
+// second, the summary with throughput and latency percentiles at the end.
+//
+//   meme_batch --input memes.jsonl --output results.jsonl --concurrency 8 --rate 10
+//
+// Options:
+//   --input PATH        Records to create (required)
+//   --output PATH       Results, overwritten (batch_results.jsonl)
+//   --concurrency N     Requests in flight at once (4)
+//   --rate F            Requests started per second, 0 for no limit (5)
+//   --burst N           Requests that may start back to back after an idle spell (5)
+//   --attempts N        Tries per record, transient failures only (3)
+//   --retry-delay-ms N  Backoff before the first retry, doubled after each (250)
+//   --max-connections N Connections kept open per host, raised to --concurrency if lower (4)
+//   --api-origin URL    Imgflip API origin, e.g. a mock_imgflip_server (MEME_API_ORIGIN or api.imgflip.com)
+//   --render-local      Caption the templates here instead of calling /caption_image; the catalog
+//                       is fetched first to find the template images (off, or MEME_RENDER=local)
+//
+// Exits with 0 when every record succeeded, 1 when some failed and 2 on bad arguments or files.
+//
+// Build with the CMake build in the repo root (target meme_batch).
+
+#include "http_pool.h"
+#include "meme_batch.h"
+#include "meme_service.h"
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+static volatile std::sig_atomic_t interrupted = 0;
+
+static bool ParseOptions(int argc, char** argv, MemeBatchOptions& options) {
+    options.output_path = "batch_results.jsonl";
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--render-local") {
+            SetLocalMemeRendering(true);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--input") options.input_path = value;
+        else if (arg == "--output") options.output_path = value;
+        else if (arg == "--concurrency") options.concurrency = atoi(value);
+        else if (arg == "--rate") options.rate_per_second = atof(value);
+        else if (arg == "--burst") options.burst = atoi(value);
+        else if (arg == "--attempts") options.max_attempts = atoi(value);
+        else if (arg == "--retry-delay-ms") options.retry_delay_ms = atoi(value);
+        else if (arg == "--api-origin") SetApiOrigin(value);
+        else if (arg == "--max-connections") GetHttpClientPool().SetMaxConnectionsPerHost(atoi(value));
+        else return false;
+    }
+    return !options.input_path.empty();
+}
+
+int main(int argc, char** argv) {
+    MemeBatchOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        fprintf(stderr, "Usage: meme_batch --input PATH [--output PATH] [--concurrency N] [--rate F] [--burst N]\n"
+                        "       [--attempts N] [--retry-delay-ms N] [--max-connections N] [--api-origin URL] [--render-local]\n");
+        return 2;
+    }
+
+    if (GetLocalMemeRendering()) {
+        FetchMemeData();
+    }
+
+    MemeBatch batch;
+    if (!batch.Start(options)) {
+        fprintf(stderr, "%s\n", batch.GetReport().error.c_str());
+        return 2;
+    }
+    // Ctrl+C lets the requests in flight finish and still prints the summary
+    std::signal(SIGINT, [](int) { interrupted = 1; });
+
+    for (int tick = 1; batch.Running(); ++tick) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (interrupted) {
+            batch.Cancel();
+        }
+        if (tick % 10 != 0) {
+            continue;
+        }
+        const MemeBatchProgress progress = batch.GetProgress();
+        fprintf(stderr, "%6.1f s  %llu/%llu%s done, %llu failed, %llu retries\n", progress.elapsed_seconds,
+            static_cast<unsigned long long>(progress.done), static_cast<unsigned long long>(progress.read),
+            progress.input_finished ? "" : "+", static_cast<unsigned long long>(progress.failed),
+            static_cast<unsigned long long>(progress.retries));
+    }
+    batch.Wait();
+    std::signal(SIGINT, SIG_DFL);
+
+    const MemeBatchReport report = batch.GetReport();
+    printf("%llu records in %.2f s, %.2f records/s%s\n", static_cast<unsigned long long>(report.records), report.seconds,
+        report.records_per_second, report.cancelled ? " (cancelled)" : "");
+    printf("%llu succeeded (%llu from the result cache), %llu failed, %llu retries\n", static_cast<unsigned long long>(report.succeeded),
+        static_cast<unsigned long long>(report.cached), static_cast<unsigned long long>(report.failed),
+        static_cast<unsigned long long>(report.retries));
+    printf("latency p50 %.1f ms  p90 %.1f ms  p99 %.1f ms  max %.1f ms\n", report.p50_ms, report.p90_ms, report.p99_ms, report.max_ms);
+    if (!report.error.empty()) {
+        fprintf(stderr, "%s\n", report.error.c_str());
+        return 2;
+    }
+    return report.failed == 0 && !report.cancelled ? 0 : 1;
+}
@@ -0,0 +1,330 @@
+// Local stand-in for api.imgflip.com and i.imgflip.com, so performance runs are repeatable
+// and work offline. Serves /get_memes from a fixture file, answers /caption_image with a
+// response derived only from its parameters, and serves template images from a directory.
+// Images missing from the directory are generated at the template's size. Every template URL
+// in the catalog is rewritten to point back at this server.
+//
+// Point the app or the core at it with --api-origin http://127.0.0.1:8080 or the
+// MEME_API_ORIGIN environment variable.
+//
+// Options:
+//   --host H            Address to listen on (127.0.0.1)
+//   --port N            Port, 0 picks a free one (8080)
+//   --fixture PATH      /get_memes response to serve (tools/fixtures/get_memes.json)
+//   --images DIR        Template images by file name, e.g. DIR/30b1gx.jpg (none)
+//   --scale N           Repeat the fixture's templates N times, each copy with its own id and URL (1)
+//   --latency-ms N      Delay before every response (0)
+//   --jitter-ms N       Extra random delay of up to N ms (0)
+//   --kbps N            Per-response bandwidth cap in kilobits per second, 0 for none (0)
+//   --error-rate F      Fraction of requests answered with 503 (0)
+//   --seed N            Seed for jitter and errors (1)
+//   --verbose           Log every request
+//
+// Build with the CMake build in the repo root (target mock_imgflip_server), or:
+//   g++ -O2 -std=c++17 -I. tools/mock_imgflip_server.cpp -lpthread -o mock_imgflip_server
+
+#include "httplib.h"
+#include "json.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#ifndef MOCK_FIXTURE_DIR
+#define MOCK_FIXTURE_DIR "tools/fixtures"
+#endif
+
+struct MockOptions {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    std::string fixture = MOCK_FIXTURE_DIR "/get_memes.json";
+    std::string image_dir;
+    int scale = 1;
+    int latency_ms = 0;
+    int jitter_ms = 0;
+    int kbps = 0;
+    double error_rate = 0.0;
+    unsigned seed = 1;
+    bool verbose = false;
+};
+
+// Size of a template image, used to generate it when the image directory does not have it
+struct MockImage {
+    int width;
+    int height;
+};
+
+// An image body ready to serve, with its validator
+struct ServedImage {
+    std::string body;
+    std::string etag;
+};
+
+// Latency, bandwidth and error injection shared by every route
+class Shaper {
+public:
+    explicit Shaper(const MockOptions& options) : options(options), rng(options.seed) {}
+
+    // Function to sleep for the configured latency, returns true if this request should fail instead
+    bool Delay() {
+        int delay_ms = options.latency_ms;
+        bool fail = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (options.jitter_ms > 0) {
+                delay_ms += std::uniform_int_distribution<int>(0, options.jitter_ms)(rng);
+            }
+            fail = options.error_rate > 0.0 && std::uniform_real_distribution<double>(0.0, 1.0)(rng) < options.error_rate;
+        }
+        if (delay_ms > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+        }
+        return fail;
+    }
+
+    // Function to send a body, throttled to the bandwidth cap in 16 KB chunks when there is one
+    void Send(httplib::Response& response, std::string body, const char* content_type) {
+        if (options.kbps <= 0) {
+            response.set_content(std::move(body), content_type);
+            return;
+        }
+        auto shared = std::make_shared<std::string>(std::move(body));
+        const double bytes_per_second = options.kbps * 1000.0 / 8.0;
+        response.set_content_provider(shared->size(), content_type, [shared, bytes_per_second](size_t offset, size_t length, httplib::DataSink& sink) {
+            const size_t chunk = std::min<size_t>(length, 16 * 1024);
+            std::this_thread::sleep_for(std::chrono::duration<double>(chunk / bytes_per_second));
+            return sink.write(shared->data() + offset, chunk);
+        });
+    }
+
+private:
+    const MockOptions& options;
+    std::mutex mutex;
+    std::mt19937 rng;
+};
+
+// Function to hash a string into 16 hex digits (64-bit FNV-1a), stable across runs
+static std::string HashHex(const std::string& text) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+    return hex;
+}
+
+// Function to get the file name at the end of a URL
+static std::string UrlFileName(const std::string& url) {
+    size_t slash = url.rfind('/');
+    return slash == std::string::npos ? url : url.substr(slash + 1);
+}
+
+// Function to encode a binary PPM with a gradient seeded by the file name, stb_image decodes it like any JPEG
+static std::string MakeImage(const std::string& name, int width, int height) {
+    const unsigned seed = static_cast<unsigned>(std::stoull(HashHex(name).substr(0, 8), nullptr, 16));
+    std::string ppm = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    ppm.reserve(ppm.size() + static_cast<size_t>(width) * height * 3);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            ppm.push_back(static_cast<char>((x + seed) & 0xff));
+            ppm.push_back(static_cast<char>((y + (seed >> 8)) & 0xff));
+            ppm.push_back(static_cast<char>(((x ^ y) + (seed >> 16)) & 0xff));
+        }
+    }
+    return ppm;
+}
+
+// Function to read a whole file, returns false if it cannot be opened
+static bool ReadFile(const std::string& path, std::string& out) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    out = contents.str();
+    return true;
+}
+
+// Function to build the served catalog: the fixture repeated scale times, with URLs on this server
+static bool BuildCatalog(const MockOptions& options, const std::string& origin, std::string& body,
+    std::unordered_map<std::string, std::string>& template_images, std::unordered_map<std::string, MockImage>& image_sizes) {
+    std::string text;
+    if (!ReadFile(options.fixture, text)) {
+        std::cerr << "Cannot read fixture: " << options.fixture << std::endl;
+        return false;
+    }
+    nlohmann::json fixture = nlohmann::json::parse(text, nullptr, false);
+    if (fixture.is_discarded() || !fixture.contains("data") || !fixture["data"].contains("memes") || !fixture["data"]["memes"].is_array()) {
+        std::cerr << "Fixture is not a /get_memes response: " << options.fixture << std::endl;
+        return false;
+    }
+
+    nlohmann::json memes = nlohmann::json::array();
+    for (int copy = 0; copy < options.scale; ++copy) {
+        for (const auto& meme : fixture["data"]["memes"]) {
+            nlohmann::json row = meme;
+            const std::string file_name = UrlFileName(meme.value("url", std::string()));
+            std::string url = origin + "/images/" + file_name;
+            if (copy > 0) {
+                row["id"] = meme.value("id", std::string()) + "-" + std::to_string(copy);
+                row["name"] = meme.value("name", std::string()) + " #" + std::to_string(copy + 1);
+                url += "?copy=" + std::to_string(copy);
+            }
+            row["url"] = url;
+            template_images[row["id"].get<std::string>()] = file_name;
+            image_sizes[file_name] = { meme.value("width", 500), meme.value("height", 500) };
+            memes.push_back(std::move(row));
+        }
+    }
+    body = nlohmann::json{ { "success", true }, { "data", { { "memes", memes } } } }.dump();
+    return true;
+}
+
+// Function to parse the command line, returns false on an unknown option or a missing value
+static bool ParseOptions(int argc, char** argv, MockOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--verbose") {
+            options.verbose = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--host") options.host = value;
+        else if (arg == "--port") options.port = atoi(value);
+        else if (arg == "--fixture") options.fixture = value;
+        else if (arg == "--images") options.image_dir = value;
+        else if (arg == "--scale") options.scale = atoi(value) > 0 ? atoi(value) : 1;
+        else if (arg == "--latency-ms") options.latency_ms = atoi(value);
+        else if (arg == "--jitter-ms") options.jitter_ms = atoi(value);
+        else if (arg == "--kbps") options.kbps = atoi(value);
+        else if (arg == "--error-rate") options.error_rate = atof(value);
+        else if (arg == "--seed") options.seed = static_cast<unsigned>(strtoul(value, nullptr, 10));
+        else return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    MockOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        std::cerr << "Usage: mock_imgflip_server [--host H] [--port N] [--fixture PATH] [--images DIR] [--scale N]\n"
+                     "       [--latency-ms N] [--jitter-ms N] [--kbps N] [--error-rate F] [--seed N] [--verbose]" << std::endl;
+        return 2;
+    }
+
+    httplib::Server server;
+    const int port = options.port > 0 ? (server.bind_to_port(options.host, options.port) ? options.port : -1) : server.bind_to_any_port(options.host);
+    if (port <= 0) {
+        std::cerr << "Cannot listen on " << options.host << ":" << options.port << std::endl;
+        return 1;
+    }
+    const std::string origin = "http://" + options.host + ":" + std::to_string(port);
+
+    std::string catalog_body;
+    std::unordered_map<std::string, std::string> template_images; // Template id -> image file name
+    std::unordered_map<std::string, MockImage> image_sizes;       // Image file name -> size to generate
+    if (!BuildCatalog(options, origin, catalog_body, template_images, image_sizes)) {
+        return 1;
+    }
+    std::mutex image_mutex;
+    std::unordered_map<std::string, std::shared_ptr<const ServedImage>> images; // Loaded or generated, by file name
+    Shaper shaper(options);
+
+    server.Get("/get_memes", [&](const httplib::Request&, httplib::Response& response) {
+        if (shaper.Delay()) {
+            response.status = 503;
+            return;
+        }
+        shaper.Send(response, catalog_body, "application/json");
+    });
+
+    // Same parameters, same answer: the URL is a hash of every form field
+    server.Post("/caption_image", [&](const httplib::Request& request, httplib::Response& response) {
+        if (shaper.Delay()) {
+            response.status = 503;
+            return;
+        }
+        const std::string template_id = request.get_param_value("template_id");
+        auto it = template_images.find(template_id);
+        nlohmann::json answer;
+        if (it == template_images.end()) {
+            answer = { { "success", false }, { "error_message", "No template with id " + template_id } };
+        }
+        else {
+            std::string fields;
+            for (const auto& param : request.params) {
+                fields += param.first + "=" + param.second + "\n";
+            }
+            const std::string hash = HashHex(fields);
+            answer = { { "success", true }, { "data", {
+                { "url", origin + "/images/" + it->second + "?caption=" + hash },
+                { "page_url", origin + "/i/" + hash },
+            } } };
+        }
+        shaper.Send(response, answer.dump(), "application/json");
+    });
+
+    server.Get(R"(/images/([^/]+))", [&](const httplib::Request& request, httplib::Response& response) {
+        if (shaper.Delay()) {
+            response.status = 503;
+            return;
+        }
+        const std::string name = request.matches[1];
+        std::shared_ptr<const ServedImage> image;
+        {
+            std::lock_guard<std::mutex> lock(image_mutex);
+            auto cached = images.find(name);
+            if (cached != images.end()) {
+                image = cached->second;
+            }
+        }
+        if (!image) {
+            std::string body;
+            auto size = image_sizes.find(name);
+            if (options.image_dir.empty() || !ReadFile(options.image_dir + "/" + name, body)) {
+                if (size == image_sizes.end()) {
+                    response.status = 404;
+                    return;
+                }
+                body = MakeImage(name, size->second.width, size->second.height);
+            }
+            const std::string etag = "\"" + HashHex(body) + "\"";
+            std::lock_guard<std::mutex> lock(image_mutex);
+            image = images.emplace(name, std::make_shared<const ServedImage>(ServedImage{ std::move(body), etag })).first->second;
+        }
+
+        response.set_header("ETag", image->etag);
+        if (request.get_header_value("If-None-Match") == image->etag) {
+            response.status = 304;
+            return;
+        }
+        shaper.Send(response, image->body, "image/jpeg");
+    });
+
+    if (options.verbose) {
+        server.set_logger([](const httplib::Request& request, const httplib::Response& response) {
+            printf("%s %s -> %d\n", request.method.c_str(), request.target.c_str(), response.status);
+        });
+    }
+
+    printf("Serving %zu templates on %s (latency %d+%d ms, %d kbps, %.1f%% errors)\n", template_images.size(), origin.c_str(),
+        options.latency_ms, options.jitter_ms, options.kbps, options.error_rate * 100.0);
+    fflush(stdout);
+    return server.listen_after_bind() ? 0 : 1;
+}
@@ -1,11 +1,10 @@
 #include "utils.h"
-#include <fstream>
+#include "d3d9_texture_sink.h"
+#include <algorithm>
+#include <cstring>
+#include <ctime>
 #include <iostream>
 
-// Include stb_image implementation
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-
 // Include imgui_impl_win32.h
 #include "imgui_impl_win32.h"
 //#include <imgui_impl_win32.cpp> // This should be included elsewhere in the project
@@ -18,17 +17,17 @@ D3DPRESENT_PARAMETERS g_d3dpp = {};
 UINT g_ResizeWidth = 0, g_ResizeHeight = 0;
 
 // Data structures for meme handling
-nlohmann::json meme_data;
-std::unordered_map<std::string, LPDIRECT3DTEXTURE9> meme_textures;
 std::unordered_set<std::string> seen_images;
 std::unordered_set<std::string> viewed_images;
-std::vector<std::string> generated_memes;
 std::string fullscreen_image_url = "";
 std::string create_meme_url = "";
 std::vector<std::string> text_boxes;
-std::mutex meme_mutex;
-std::condition_variable cv;
-bool isReady = false; // Flag to indicate meme data is ready
+static D3D9TextureSink texture_sink(g_pd3dDevice);
+// 256 MB of full images, 32 MB of thumbnails in 4 MB atlas pages (each fits about ninety 100 px thumbnails).
+// The budget matches the eight pages, so the atlas tends to fill first and then gives up its least used page.
+static ImageStore image_store(texture_sink, 256u * 1024u * 1024u, 32u * 1024u * 1024u, 1024, 8);
+static int last_draw_calls = 0; // Draw commands submitted in the last rendered frame
+static MemeBatch meme_batch; // Bulk creation started from the Batch panel
 
 // Function to create a Direct3D9 device
 bool CreateDeviceD3D(HWND hWnd) {
@@ -94,195 +93,536 @@ LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     return ::DefWindowProcW(hWnd, msg, wParam, lParam);
 }
 
-// Function to fetch meme data from Imgflip API
-void FetchMemeData() {
-    httplib::SSLClient client("api.imgflip.com");
-    auto res = client.Get("/get_memes");
-    if (res && res->status == 200) {
-        std::unique_lock<std::mutex> lock(meme_mutex);
-        meme_data = nlohmann::json::parse(res->body);
-        isReady = true;
-        cv.notify_all();
+// Function to load texture from memory
+LPDIRECT3DTEXTURE9 LoadTextureFromMemory(unsigned char* image_data, int image_width, int image_height) {
+    if (!image_data || image_width <= 0 || image_height <= 0) {
+        return nullptr;
     }
-    else {
-        std::cerr << "Failed to fetch meme data: " << (res ? res->status : 0) << std::endl;
+    void* texture = texture_sink.CreateTexture(image_width, image_height, 1);
+    if (texture && !texture_sink.WriteRegion(texture, 0, 0, 0, image_width, image_height, image_data, static_cast<size_t>(image_width) * 4)) {
+        texture_sink.ReleaseTexture(texture);
+        texture = nullptr;
     }
+    return static_cast<LPDIRECT3DTEXTURE9>(texture);
 }
 
-// Function to load texture from memory
-LPDIRECT3DTEXTURE9 LoadTextureFromMemory(unsigned char* image_data, int image_width, int image_height) {
-    if (!image_data) {
+// Function to create a texture with every level of a decoded image's mip chain
+LPDIRECT3DTEXTURE9 LoadMipmappedTexture(const DecodedImage& image) {
+    return static_cast<LPDIRECT3DTEXTURE9>(CreateTextureFromImage(texture_sink, image));
+}
+
+// Function to load texture from a URL, blocks on the disk cache or download and the decode
+LPDIRECT3DTEXTURE9 LoadTextureFromURL(const std::string& url) {
+    ImageBytes bytes;
+    if (!FetchImageBytes(url, bytes)) {
         return nullptr;
     }
-
-    LPDIRECT3DTEXTURE9 texture;
-    HRESULT hr = g_pd3dDevice->CreateTexture(image_width, image_height, 1, 0, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &texture, nullptr);
-    if (FAILED(hr)) {
+    DecodedImage image;
+    if (!DecodeImage(bytes.Data(), bytes.Size(), image)) {
         return nullptr;
     }
+    BuildMipChain(image);
+    return LoadMipmappedTexture(image);
+}
 
-    D3DLOCKED_RECT rect;
-    hr = texture->LockRect(0, &rect, nullptr, D3DLOCK_DISCARD);
-    if (FAILED(hr)) {
-        texture->Release();
-        return nullptr;
+// Function to start the background image loaders
+void StartImagePipeline() {
+    unsigned int cores = std::thread::hardware_concurrency();
+    int decode_workers = cores > 2 ? static_cast<int>(cores) - 1 : 1;
+    if (decode_workers > 4) {
+        decode_workers = 4;
     }
+    image_store.Start(4, decode_workers);
+}
+
+// Function to stop the background image loaders and release every texture
+void StopImagePipeline() {
+    image_store.Stop();
+}
 
-    unsigned char* dst = static_cast<unsigned char*>(rect.pBits);
-    const unsigned char* src = image_data;
+// Function to start a new frame for the texture cache, textures touched from here on are pinned
+void BeginTextureFrame() {
+    image_store.BeginFrame();
+}
 
-    for (int y = 0; y < image_height; ++y) {
-        for (int x = 0; x < image_width; ++x) {
-            unsigned char r = src[4 * (y * image_width + x) + 0];
-            unsigned char g = src[4 * (y * image_width + x) + 1];
-            unsigned char b = src[4 * (y * image_width + x) + 2];
-            unsigned char a = src[4 * (y * image_width + x) + 3];
-            int index = 4 * (y * image_width + x);
-            int pitch_index = 4 * x + y * rect.Pitch;
+// Function to upload decoded images within a per-frame budget, called once per frame on the render thread
+void UploadDecodedTextures(const UploadBudget& budget) {
+    image_store.UploadDecoded(budget);
+}
 
-            if (index < 0 || index >= image_width * image_height * 4) {
-                texture->UnlockRect(0);
-                texture->Release();
-                return nullptr;
-            }
+// Function to tell the render loop that uploads are still queued, it has to keep drawing frames to drain them
+bool HasPendingUploads() {
+    return image_store.HasPendingUploads();
+}
 
-            if (pitch_index < 0 || pitch_index >= rect.Pitch * image_height) {
-                texture->UnlockRect(0);
-                texture->Release();
-                return nullptr;
-            }
+// Function to change how much texture memory the cache may hold
+void SetTextureBudget(size_t budget_bytes) {
+    image_store.SetTextureBudget(budget_bytes);
+}
 
-            dst[pitch_index + 0] = b;
-            dst[pitch_index + 1] = g;
-            dst[pitch_index + 2] = r;
-            dst[pitch_index + 3] = a;
+// Function to get meme texture, queueing it for loading if necessary.
+// Never blocks: returns the placeholder until the texture is ready.
+LPDIRECT3DTEXTURE9 GetMemeTexture(const std::string& url, ImageLoadState* state) {
+    return static_cast<LPDIRECT3DTEXTURE9>(image_store.GetTexture(url, state));
+}
+
+// Function to get a reduced-size preview drawn from an atlas page, or the full image once that is loaded
+MemeImage GetMemeThumbnail(const std::string& url, int max_size) {
+    StoredImage stored = image_store.GetThumbnail(url, max_size);
+    MemeImage image;
+    image.texture = static_cast<LPDIRECT3DTEXTURE9>(stored.texture);
+    image.uv0 = ImVec2(stored.uv0[0], stored.uv0[1]);
+    image.uv1 = ImVec2(stored.uv1[0], stored.uv1[1]);
+    image.state = stored.state;
+    return image;
+}
+
+// Function to sort the row order of the catalog from the table sort specs, the catalog itself is never moved
+void SortMemeOrder(const MemeCatalog& catalog, const MemeSortKeys& keys, std::vector<uint32_t>& order, const ImGuiTableSortSpecs* sortSpecs) {
+    PROFILE_SCOPE("Sort rows");
+    std::vector<MemeSortSpec> specs;
+    if (sortSpecs) {
+        for (int n = 0; n < sortSpecs->SpecsCount; n++) {
+            const ImGuiTableColumnSortSpecs* sortSpec = &sortSpecs->Specs[n];
+            specs.push_back({ static_cast<int>(sortSpec->ColumnUserID), sortSpec->SortDirection == ImGuiSortDirection_Descending });
         }
     }
-
-    texture->UnlockRect(0);
-    return texture;
+    SortMemeRows(catalog, keys, specs.data(), static_cast<int>(specs.size()), order);
 }
 
-// Function to load texture from a URL
-LPDIRECT3DTEXTURE9 LoadTextureFromURL(const std::string& url) {
-    std::string domain = url.substr(8); // Extract domain from URL
-    size_t pos = domain.find('/');
-    std::string path = domain.substr(pos);
-    domain = domain.substr(0, pos);
-
-    httplib::SSLClient client(domain.c_str());
-    auto res = client.Get(path.c_str());
-    if (res && res->status == 200) {
-        int image_width, image_height, channels;
-        unsigned char* image_data = stbi_load_from_memory(reinterpret_cast<const unsigned char*>(res->body.data()), res->body.size(), &image_width, &image_height, &channels, STBI_rgb_alpha);
-        if (image_data) {
-            LPDIRECT3DTEXTURE9 texture = LoadTextureFromMemory(image_data, image_width, image_height);
-            stbi_image_free(image_data);
-            return texture;
+// Function to list the background meme submissions, returns the URL of a finished meme the user asked to view
+std::string ShowMemeSubmissions() {
+    std::vector<MemeSubmission> submissions = GetMemeSubmissions();
+    if (submissions.empty()) {
+        return "";
+    }
+    int pending = 0;
+    for (const MemeSubmission& submission : submissions) {
+        pending += submission.state == MemeSubmissionState_Queued || submission.state == MemeSubmissionState_InFlight;
+    }
+
+    std::string picked;
+    char label[64];
+    snprintf(label, sizeof(label), "Meme submissions (%d pending)###Submissions", pending);
+    if (ImGui::CollapsingHeader(label, ImGuiTreeNodeFlags_DefaultOpen)) {
+        if (ImGui::BeginTable("Submissions", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("#", ImGuiTableColumnFlags_WidthFixed);
+            ImGui::TableSetupColumn("Template");
+            ImGui::TableSetupColumn("Text");
+            ImGui::TableSetupColumn("State");
+            ImGui::TableHeadersRow();
+            for (auto it = submissions.rbegin(); it != submissions.rend(); ++it) {
+                ImGui::PushID(static_cast<int>(it->ticket));
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(it->ticket));
+                ImGui::TableNextColumn(); ImGui::Text("%s", it->template_id.c_str());
+                ImGui::TableNextColumn(); ImGui::Text("%s", it->text.empty() ? "" : it->text[0].c_str());
+                ImGui::TableNextColumn();
+                switch (it->state) {
+                case MemeSubmissionState_Queued:
+                    ImGui::TextDisabled("Queued");
+                    break;
+                case MemeSubmissionState_InFlight:
+                    ImGui::Text("Sending...");
+                    break;
+                case MemeSubmissionState_Done:
+                    if (ImGui::SmallButton("View")) {
+                        picked = it->url;
+                    }
+                    if (it->cached) {
+                        ImGui::SameLine();
+                        ImGui::TextDisabled("cached");
+                    }
+                    break;
+                case MemeSubmissionState_Failed:
+                    ImGui::TextColored(ImVec4(0.8f, 0.1f, 0.1f, 1.0f), "Failed: %s", it->error.c_str());
+                    break;
+                }
+                ImGui::PopID();
+            }
+            ImGui::EndTable();
+        }
+        if (static_cast<size_t>(pending) < submissions.size() && ImGui::Button("Clear finished")) {
+            DismissFinishedSubmissions();
         }
     }
-    return nullptr;
+    return picked;
 }
 
-// Function to load meme textures
-void LoadMemeTextures() {
-    std::unique_lock<std::mutex> lock(meme_mutex);
-    cv.wait(lock, [] {return isReady; });
-    for (const auto& meme : meme_data["data"]["memes"]) {
-        std::string url = meme["url"].get<std::string>();
-        meme_textures[url] = nullptr;
+// Function to run a JSONL batch of memes from the UI: file names, limits, progress and the final report
+void ShowMemeBatch() {
+    static char input_path[260] = "memes.jsonl";
+    static char output_path[260] = "batch_results.jsonl";
+    static MemeBatchOptions options;
+    static float rate_per_second = static_cast<float>(options.rate_per_second);
+    static bool started = false;
+
+    const bool running = meme_batch.Running();
+    ImGui::BeginDisabled(running);
+    ImGui::InputText("Input JSONL", input_path, IM_ARRAYSIZE(input_path));
+    ImGui::InputText("Results JSONL", output_path, IM_ARRAYSIZE(output_path));
+    ImGui::SliderInt("Concurrency", &options.concurrency, 1, 32);
+    ImGui::SliderFloat("Requests per second", &rate_per_second, 0.0f, 50.0f, rate_per_second > 0.0f ? "%.1f" : "No limit");
+    ImGui::SliderInt("Burst", &options.burst, 1, 50);
+    ImGui::SliderInt("Attempts", &options.max_attempts, 1, 5);
+    bool render_locally = GetLocalMemeRendering();
+    if (ImGui::Checkbox("Render locally", &render_locally)) {
+        SetLocalMemeRendering(render_locally);
+    }
+    if (ImGui::Button("Start batch")) {
+        options.input_path = input_path;
+        options.output_path = output_path;
+        options.rate_per_second = rate_per_second;
+        started = meme_batch.Start(options);
+    }
+    ImGui::EndDisabled();
+    if (running) {
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel")) {
+            meme_batch.Cancel();
+        }
+    }
+
+    const MemeResultCache::Stats cache_stats = GetMemeResultCacheStats();
+    ImGui::Text("Result cache: %zu memes, %llu hits, %llu collapsed, %llu made", cache_stats.entries,
+        static_cast<unsigned long long>(cache_stats.hits), static_cast<unsigned long long>(cache_stats.collapsed),
+        static_cast<unsigned long long>(cache_stats.misses));
+    ImGui::SameLine();
+    if (ImGui::SmallButton("Clear cache")) {
+        ClearMemeResultCache();
+    }
+
+    const MemeBatchProgress progress = meme_batch.GetProgress();
+    const MemeBatchReport report = meme_batch.GetReport();
+    if (!report.error.empty()) {
+        ImGui::TextColored(ImVec4(0.8f, 0.1f, 0.1f, 1.0f), "%s", report.error.c_str());
+    }
+    if (!started) {
+        return;
+    }
+    char overlay[96];
+    snprintf(overlay, sizeof(overlay), "%llu / %llu%s", static_cast<unsigned long long>(progress.done),
+        static_cast<unsigned long long>(progress.read), progress.input_finished ? "" : "+");
+    ImGui::ProgressBar(progress.read ? static_cast<float>(progress.done) / progress.read : 0.0f, ImVec2(-FLT_MIN, 0), overlay);
+    ImGui::Text("%llu succeeded (%llu cached), %llu failed, %llu retries, %.1f s", static_cast<unsigned long long>(progress.succeeded),
+        static_cast<unsigned long long>(progress.cached), static_cast<unsigned long long>(progress.failed),
+        static_cast<unsigned long long>(progress.retries), progress.elapsed_seconds);
+    if (!running) {
+        ImGui::Text("%.2f records/s%s, latency p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms", report.records_per_second,
+            report.cancelled ? " (cancelled)" : "", report.p50_ms, report.p90_ms, report.p99_ms, report.max_ms);
     }
 }
 
-// Function to get meme texture, loading it if necessary
-LPDIRECT3DTEXTURE9 GetMemeTexture(const std::string& url) {
-    if (meme_textures[url] == nullptr) {
-        meme_textures[url] = LoadTextureFromURL(url);
+// Function to cancel a running batch and wait for its requests in flight
+void StopMemeBatch() {
+    meme_batch.Cancel();
+    meme_batch.Wait();
+}
+
+// Function to show per-host connection pool counters
+void ShowHttpPoolStats() {
+    HttpClientPool& pool = GetHttpClientPool();
+    int limit = pool.GetMaxConnectionsPerHost();
+    if (ImGui::SliderInt("Connections per host", &limit, 1, 64)) {
+        pool.SetMaxConnectionsPerHost(limit);
+    }
+    std::vector<HttpClientPool::HostStats> stats = pool.GetStats();
+    if (ImGui::BeginTable("HttpPoolStats", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Host");
+        ImGui::TableSetupColumn("Open");
+        ImGui::TableSetupColumn("Idle");
+        ImGui::TableSetupColumn("Handshakes");
+        ImGui::TableSetupColumn("Requests");
+        ImGui::TableHeadersRow();
+        for (const auto& host : stats) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::Text("%s", host.origin.c_str());
+            ImGui::TableNextColumn(); ImGui::Text("%d", host.open_clients);
+            ImGui::TableNextColumn(); ImGui::Text("%d", host.idle_clients);
+            ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(host.connects));
+            ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(host.requests));
+        }
+        ImGui::EndTable();
     }
-    return meme_textures[url];
 }
 
-// Comparison function for sorting memes
-int CompareMemes(const void* a, const void* b) {
-    const nlohmann::json* memeA = static_cast<const nlohmann::json*>(a);
-    const nlohmann::json* memeB = static_cast<const nlohmann::json*>(b);
+// Function to show one phase timing in a table cell, a dash for phases the request skipped
+static void NetTimingCell(double ms) {
+    ImGui::TableNextColumn();
+    if (ms < 0.0) {
+        ImGui::TextDisabled("-");
+    }
+    else {
+        ImGui::Text("%.1f", ms);
+    }
+}
 
-    ImGuiTableSortSpecs* sortSpecs = ImGui::TableGetSortSpecs();
-    for (int n = 0; n < sortSpecs->SpecsCount; n++) {
-        const ImGuiTableColumnSortSpecs* sortSpec = &sortSpecs->Specs[n];
-        int delta = 0;
+// Function to show per-host request phase percentiles and the last requests, with a JSON dump
+void ShowNetTelemetry() {
+    if (ImGui::Button("Save JSON")) {
+        const std::string path = "net_telemetry_" + std::to_string(static_cast<long long>(std::time(nullptr))) + ".json";
+        if (SaveNetTelemetry(path)) {
+            std::cout << "Wrote network telemetry: " << path << std::endl;
+        }
+        else {
+            std::cerr << "Failed to write network telemetry: " << path << std::endl;
+        }
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Reset")) {
+        ResetNetTelemetry();
+    }
 
-        switch (sortSpec->ColumnIndex) {
-        case 0: delta = strcmp((*memeA)["id"].get<std::string>().c_str(), (*memeB)["id"].get<std::string>().c_str()); break;
-        case 1: delta = strcmp((*memeA)["name"].get<std::string>().c_str(), (*memeB)["name"].get<std::string>().c_str()); break;
-        case 3: delta = (*memeA)["width"].get<int>() - (*memeB)["width"].get<int>(); break;
-        case 4: delta = (*memeA)["height"].get<int>() - (*memeB)["height"].get<int>(); break;
-        case 5: delta = (*memeA)["box_count"].get<int>() - (*memeB)["box_count"].get<int>(); break;
+    for (const HostTelemetry& host : GetNetTelemetry()) {
+        ImGui::PushID(host.origin.c_str());
+        ImGui::Text("%s: %llu requests, %llu failed, %llu retries, %llu reused, %.1f MB", host.origin.c_str(),
+            static_cast<unsigned long long>(host.requests), static_cast<unsigned long long>(host.failures),
+            static_cast<unsigned long long>(host.retries), static_cast<unsigned long long>(host.reused), host.bytes / (1024.0 * 1024.0));
+        if (ImGui::BeginTable("Phases", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Phase (ms)");
+            ImGui::TableSetupColumn("Samples");
+            ImGui::TableSetupColumn("p50");
+            ImGui::TableSetupColumn("p90");
+            ImGui::TableSetupColumn("p99");
+            ImGui::TableSetupColumn("Max");
+            ImGui::TableHeadersRow();
+            for (int phase = 0; phase < NetPhase_COUNT; ++phase) {
+                const LatencyHistogram& histogram = host.phases[phase];
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::Text("%s", NetPhaseName(phase));
+                ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(histogram.Count()));
+                NetTimingCell(histogram.Count() ? histogram.Percentile(0.50) : -1.0);
+                NetTimingCell(histogram.Count() ? histogram.Percentile(0.90) : -1.0);
+                NetTimingCell(histogram.Count() ? histogram.Percentile(0.99) : -1.0);
+                NetTimingCell(histogram.Count() ? histogram.Max() : -1.0);
+            }
+            ImGui::EndTable();
         }
+        ImGui::PopID();
+    }
 
-        if (delta > 0) return sortSpec->SortDirection == ImGuiSortDirection_Ascending ? +1 : -1;
-        if (delta < 0) return sortSpec->SortDirection == ImGuiSortDirection_Ascending ? -1 : +1;
+    if (ImGui::TreeNode("Recent requests")) {
+        std::vector<RequestTiming> requests = GetRecentRequests();
+        if (ImGui::BeginTable("RecentRequests", 10, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY, ImVec2(0.0f, 240.0f))) {
+            ImGui::TableSetupScrollFreeze(0, 1);
+            ImGui::TableSetupColumn("Request");
+            ImGui::TableSetupColumn("Status");
+            ImGui::TableSetupColumn("DNS");
+            ImGui::TableSetupColumn("Connect");
+            ImGui::TableSetupColumn("TLS");
+            ImGui::TableSetupColumn("TTFB");
+            ImGui::TableSetupColumn("Transfer");
+            ImGui::TableSetupColumn("Total");
+            ImGui::TableSetupColumn("KB");
+            ImGui::TableSetupColumn("Retries");
+            ImGui::TableHeadersRow();
+            for (auto it = requests.rbegin(); it != requests.rend(); ++it) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::Text("%s %s%s", it->method, it->origin.c_str(), it->path.c_str());
+                ImGui::TableNextColumn();
+                if (it->status) {
+                    ImGui::Text("%d", it->status);
+                }
+                else {
+                    ImGui::TextColored(ImVec4(0.8f, 0.1f, 0.1f, 1.0f), "%s", it->error.c_str());
+                }
+                NetTimingCell(it->dns_ms);
+                NetTimingCell(it->connect_ms);
+                NetTimingCell(it->tls_ms);
+                NetTimingCell(it->ttfb_ms);
+                NetTimingCell(it->transfer_ms);
+                NetTimingCell(it->total_ms);
+                ImGui::TableNextColumn(); ImGui::Text("%.1f", it->bytes / 1024.0);
+                ImGui::TableNextColumn();
+                if (it->retries) {
+                    ImGui::Text("%d (%.1f ms)", it->retries, it->retry_ms);
+                }
+                else {
+                    ImGui::Text("0");
+                }
+            }
+            ImGui::EndTable();
+        }
+        ImGui::TreePop();
     }
+}
 
-    return 0;
+// Function to tell whether anything the app draws by itself is moving, the loading indicator
+bool IsCatalogLoadingAnimated() {
+    CatalogFetchState state = GetCatalogFetchStatus().state;
+    return GetLoadedCatalog()->catalog.Empty() && state != CatalogFetchState_Failed && state != CatalogFetchState_Ready;
 }
 
-// Function to save generated memes to a file
-void SaveGeneratedMemes() {
-    std::ofstream file("generated_memes.txt");
-    if (file.is_open()) {
-        for (const auto& url : generated_memes) {
-            file << url << std::endl;
+// Function to show the catalog fetch state above the table, returns false while there are no rows to list
+bool ShowCatalogFetchStatus(bool catalog_empty) {
+    CatalogFetchStatus status = GetCatalogFetchStatus();
+    if (status.state == CatalogFetchState_Failed) {
+        if (catalog_empty) {
+            ImGui::TextColored(ImVec4(0.8f, 0.1f, 0.1f, 1.0f), "Could not load memes: %s", status.error.c_str());
+        }
+        else {
+            ImGui::TextColored(ImVec4(0.8f, 0.1f, 0.1f, 1.0f), "Could not refresh memes, showing the saved list: %s", status.error.c_str());
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Retry")) {
+            StartMemeDataFetch();
         }
-        file.close();
     }
+    else if (catalog_empty && status.state == CatalogFetchState_Ready) {
+        ImGui::Text("No memes available.");
+    }
+    else if (catalog_empty) {
+        static const char spinner[] = "|/-\\";
+        ImGui::Text("Loading memes... %c", spinner[static_cast<int>(ImGui::GetTime() / 0.1) & 3]);
+    }
+    else if (status.state == CatalogFetchState_Loading) {
+        ImGui::TextDisabled("Refreshing meme list...");
+    }
+    return !catalog_empty;
+}
+
+// Draw callback that switches the sampler's mip filter, the DX9 backend leaves it at its default of none
+static void SetMipFilterCallback(const ImDrawList*, const ImDrawCmd* cmd) {
+    g_pd3dDevice->SetSamplerState(0, D3DSAMP_MIPFILTER, static_cast<DWORD>(reinterpret_cast<intptr_t>(cmd->UserCallbackData)));
 }
 
-// Function to create a meme using Imgflip API
-std::string CreateMeme(const std::string& template_id, const std::vector<std::string>& text) {
-    std::string username = "welovecpp";
-    std::string password = "welovecpp";
+// Function to turn on trilinear filtering for everything drawn this frame, so mipmapped textures
+// are sampled from the level that matches their on-screen size. Single-level textures are unaffected.
+void EnableMipmapFiltering() {
+    ImGui::GetBackgroundDrawList()->AddCallback(SetMipFilterCallback, reinterpret_cast<void*>(static_cast<intptr_t>(D3DTEXF_LINEAR)));
+}
 
-    httplib::SSLClient client("api.imgflip.com");
-    httplib::Params params;
-    params.emplace("template_id", template_id);
-    params.emplace("username", username);
-    params.emplace("password", password);
+// Function to count the draw commands of a rendered frame, one DrawIndexedPrimitive each in the DX9 backend
+void RecordDrawCalls(const ImDrawData* draw_data) {
+    int draw_calls = 0;
+    for (int n = 0; n < draw_data->CmdListsCount; n++) {
+        for (const ImDrawCmd& cmd : draw_data->CmdLists[n]->CmdBuffer) {
+            if (!cmd.UserCallback) {
+                draw_calls++;
+            }
+        }
+    }
+    last_draw_calls = draw_calls;
+}
 
-    std::cout << "Adding param: template_id = " << template_id << std::endl;
+// Function to show the counters of one texture cache
+static void ShowCacheCounters(const char* label, const TextureCache::Stats& stats) {
+    ImGui::Text("%s: %.1f / %.1f MB in %zu entries", label, stats.bytes / (1024.0 * 1024.0), stats.budget / (1024.0 * 1024.0), stats.entries);
+    ImGui::Text("  Hits: %llu  Misses: %llu  Evictions: %llu  Failed loads: %llu  Expired: %llu",
+        static_cast<unsigned long long>(stats.hits), static_cast<unsigned long long>(stats.misses),
+        static_cast<unsigned long long>(stats.evictions), static_cast<unsigned long long>(stats.failures),
+        static_cast<unsigned long long>(stats.expired));
+}
 
-    for (size_t i = 0; i < text.size(); ++i) {
-        std::string key = "boxes[" + std::to_string(i) + "][text]";
-        std::string value = text[i];
-        std::cout << "Adding param: " << key << " = " << value << std::endl;
-        params.emplace(key, value);
+// Function to show texture cache counters
+void ShowTextureCacheStats() {
+    ShowCacheCounters("Images", image_store.TextureStats());
+    int budgetMegabytes = static_cast<int>(image_store.TextureStats().budget / (1024u * 1024u));
+    if (ImGui::SliderInt("Image cache budget (MB)", &budgetMegabytes, 16, 2048)) {
+        SetTextureBudget(static_cast<size_t>(budgetMegabytes) * 1024u * 1024u);
     }
+    ShowCacheCounters("Thumbnails", image_store.ThumbnailStats());
+    AtlasPacker::Stats atlas = image_store.AtlasStats();
+    ImGui::Text("Atlas: %d / %d pages, %d thumbnails packed, %d pages reused",
+        atlas.pages, atlas.max_pages, atlas.live_regions, atlas.resets);
+    ImGui::Text("Draw calls last frame: %d", last_draw_calls);
+    const UploadStats& upload_stats = image_store.GetUploadStats();
+    ImGui::Text("Uploads: %zu pending, %.1f KB in %.2f ms last frame, worst frame %.2f ms",
+        upload_stats.pending, upload_stats.last_frame_bytes / 1024.0, upload_stats.last_frame_ms, upload_stats.max_frame_ms);
+}
 
-    auto res = client.Post("/caption_image", params);
+// Function to write the last ten seconds of profiler events to a timestamped Chrome trace file
+void SaveProfilerTrace() {
+    const std::string path = "trace_" + std::to_string(static_cast<long long>(std::time(nullptr))) + ".json";
+    if (ProfilerWriteChromeTrace(path, 10.0)) {
+        std::cout << "Wrote profiler trace: " << path << std::endl;
+    }
+    else {
+        std::cerr << "Failed to write profiler trace: " << path << std::endl;
+    }
+}
 
-    if (res) {
-        if (res->status == 200) {
-            auto json_response = nlohmann::json::parse(res->body);
-            if (json_response["success"]) {
-                std::string url = json_response["data"]["url"];
-                std::cout << "Meme created successfully: " << url << std::endl;
-                generated_memes.push_back(url);
-                SaveGeneratedMemes();
-                return url;
-            }
-            else {
-                std::cerr << "Imgflip API response was not successful: " << json_response.dump(4) << std::endl;
-            }
+// Function to show frame times and a per-phase breakdown of the last second
+void ShowProfilerOverlay(bool* open) {
+    ImGui::SetNextWindowSize(ImVec2(560, 520), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Profiler", open)) {
+        ImGui::End();
+        return;
+    }
+#if !MEME_PROFILER
+    ImGui::TextDisabled("Profiler compiled out (MEME_PROFILER=0)");
+#endif
+
+    // Frame times over the history, then their distribution in 2 ms buckets
+    std::vector<float> frames = ProfilerFrameTimes();
+    if (!frames.empty()) {
+        std::vector<float> sorted = frames;
+        std::sort(sorted.begin(), sorted.end());
+        float total = 0.0f;
+        for (float ms : frames) {
+            total += ms;
         }
-        else {
-            std::cerr << "Failed to create meme, HTTP status: " << res->status << std::endl;
+        ImGui::Text("Frame: avg %.2f ms  p50 %.2f  p99 %.2f  max %.2f  (%zu frames)", total / frames.size(),
+            sorted[sorted.size() / 2], sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)], sorted.back(), frames.size());
+        ImGui::PlotLines("##FrameTimes", frames.data(), static_cast<int>(frames.size()), 0, "frame time (ms)", 0.0f, 40.0f, ImVec2(-1.0f, 70.0f));
+        float buckets[17] = {};
+        for (float ms : frames) {
+            buckets[std::min(static_cast<int>(ms / 2.0f), 16)] += 1.0f;
         }
-    }
-    else {
-        std::cerr << "Failed to create meme, no response from server" << std::endl;
+        ImGui::PlotHistogram("##FrameHistogram", buckets, 17, 0, "0-34+ ms in 2 ms buckets", 0.0f, FLT_MAX, ImVec2(-1.0f, 70.0f));
     }
 
-    return "";
+    // Per thread and phase over the last second
+    struct PhaseTotals {
+        int thread;
+        const char* name;
+        int calls = 0;
+        double total_ms = 0.0;
+        double max_ms = 0.0;
+    };
+    std::vector<PhaseTotals> phases;
+    for (const ProfileEvent& event : ProfilerCollect(ProfilerNow() - 1000000000)) {
+        auto it = std::find_if(phases.begin(), phases.end(), [&](const PhaseTotals& phase) {
+            return phase.thread == event.thread && strcmp(phase.name, event.name) == 0;
+        });
+        if (it == phases.end()) {
+            phases.push_back({ event.thread, event.name });
+            it = phases.end() - 1;
+        }
+        const double ms = (event.end_ns - event.start_ns) / 1e6;
+        it->calls++;
+        it->total_ms += ms;
+        it->max_ms = std::max(it->max_ms, ms);
+    }
+    std::vector<ProfileThreadInfo> threads = ProfilerThreads();
+    if (ImGui::BeginTable("ProfilerPhases", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY, ImVec2(0.0f, -ImGui::GetFrameHeightWithSpacing()))) {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("Thread");
+        ImGui::TableSetupColumn("Phase");
+        ImGui::TableSetupColumn("Calls/s");
+        ImGui::TableSetupColumn("Avg ms");
+        ImGui::TableSetupColumn("Max ms");
+        ImGui::TableHeadersRow();
+        for (const PhaseTotals& phase : phases) {
+            const char* thread_name = "?";
+            for (const ProfileThreadInfo& thread : threads) {
+                if (thread.id == phase.thread) {
+                    thread_name = thread.name.c_str();
+                }
+            }
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::Text("%s", thread_name);
+            ImGui::TableNextColumn(); ImGui::Text("%s", phase.name);
+            ImGui::TableNextColumn(); ImGui::Text("%d", phase.calls);
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", phase.total_ms / phase.calls);
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", phase.max_ms);
+        }
+        ImGui::EndTable();
+    }
+    if (ImGui::Button("Save trace (F9)")) {
+        SaveProfilerTrace();
+    }
+    ImGui::End();
 }
 
 // Function to customize ImGui style
@@ -1,15 +1,23 @@
 #ifndef UTILS_H
 #define UTILS_H
 
-#define CPPHTTPLIB_OPENSSL_SUPPORT
-#include "httplib.h"
+#include "http_pool.h"
 #include "json.hpp"
 #include "imgui.h"
 #include "imgui_impl_dx9.h"
 #include "imgui_impl_win32.h"
+#include "catalog_store.h"
+#include "image_store.h"
+#include "meme_batch.h"
+#include "meme_service.h"
+#include "net_telemetry.h"
+#include "profiler.h"
+#include "texture_cache.h"
+#include "wake_signal.h"
 #include <d3d9.h>
+#include <atomic>
 #include <mutex>
-#include <condition_variable>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <string>
@@ -21,30 +29,48 @@ extern bool g_DeviceLost;
 extern D3DPRESENT_PARAMETERS g_d3dpp;
 extern UINT g_ResizeWidth, g_ResizeHeight;
 
-extern nlohmann::json meme_data;
-extern std::unordered_map<std::string, LPDIRECT3DTEXTURE9> meme_textures;
 extern std::unordered_set<std::string> seen_images;
 extern std::unordered_set<std::string> viewed_images;
-extern std::vector<std::string> generated_memes;
 extern std::string fullscreen_image_url;
 extern std::string create_meme_url;
 extern std::vector<std::string> text_boxes;
-extern std::mutex meme_mutex;
-extern std::condition_variable cv;
-extern bool isReady;
+
+// A texture and the part of it that holds one image, thumbnails share atlas pages
+struct MemeImage {
+    LPDIRECT3DTEXTURE9 texture = nullptr;
+    ImVec2 uv0 = ImVec2(0.0f, 0.0f);
+    ImVec2 uv1 = ImVec2(1.0f, 1.0f);
+    ImageLoadState state = ImageLoadState_Loading;
+};
 
 bool CreateDeviceD3D(HWND hWnd);
 void CleanupDeviceD3D();
 void ResetDevice();
 LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
-void FetchMemeData();
 LPDIRECT3DTEXTURE9 LoadTextureFromMemory(unsigned char* image_data, int image_width, int image_height);
+LPDIRECT3DTEXTURE9 LoadMipmappedTexture(const DecodedImage& image);
 LPDIRECT3DTEXTURE9 LoadTextureFromURL(const std::string& url);
-void LoadMemeTextures();
-LPDIRECT3DTEXTURE9 GetMemeTexture(const std::string& url);
-int CompareMemes(const void* a, const void* b);
-void SaveGeneratedMemes();
-std::string CreateMeme(const std::string& template_id, const std::vector<std::string>& text);
+void StartImagePipeline();
+void StopImagePipeline();
+void BeginTextureFrame();
+void UploadDecodedTextures(const UploadBudget& budget);
+bool HasPendingUploads();
+void SetTextureBudget(size_t budget_bytes);
+LPDIRECT3DTEXTURE9 GetMemeTexture(const std::string& url, ImageLoadState* state = nullptr);
+MemeImage GetMemeThumbnail(const std::string& url, int max_size);
+void SortMemeOrder(const MemeCatalog& catalog, const MemeSortKeys& keys, std::vector<uint32_t>& order, const ImGuiTableSortSpecs* sortSpecs);
+bool IsCatalogLoadingAnimated();
+bool ShowCatalogFetchStatus(bool catalog_empty);
+std::string ShowMemeSubmissions();
+void ShowMemeBatch();
+void StopMemeBatch();
+void ShowHttpPoolStats();
+void ShowNetTelemetry();
+void EnableMipmapFiltering();
+void RecordDrawCalls(const ImDrawData* draw_data);
+void ShowTextureCacheStats();
+void SaveProfilerTrace();
+void ShowProfilerOverlay(bool* open);
 void CustomizeImGuiStyle();
 
 
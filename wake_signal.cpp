@@ -0,0 +1,19 @@
+#include "wake_signal.h"
+#include <mutex>
+
+static std::mutex wake_mutex;
+static std::function<void()> wake_handler;
+
+// Function to install the handler, pass nullptr to remove it before the loop's wait object goes away
+void SetWakeHandler(std::function<void()> handler) {
+    std::lock_guard<std::mutex> lock(wake_mutex);
+    wake_handler = std::move(handler);
+}
+
+// Function to wake the render loop
+void WakeRenderLoop() {
+    std::lock_guard<std::mutex> lock(wake_mutex);
+    if (wake_handler) {
+        wake_handler();
+    }
+}
@@ -0,0 +1,13 @@
+#ifndef WAKE_SIGNAL_H
+#define WAKE_SIGNAL_H
+
+#include <functional>
+
+// Hook the background stages use to tell an idle render loop that there is something new
+// to draw (an image decoded, a catalog published). The loop installs a handler that
+// signals whatever it sleeps on; without one, waking is a no-op.
+void SetWakeHandler(std::function<void()> handler);
+// Function to wake the render loop, callable from any thread
+void WakeRenderLoop();
+
+#endif // WAKE_SIGNAL_H